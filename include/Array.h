@@ -28,9 +28,16 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <fstream>
 #include <utility>
+#include <stdexcept>
+#include <string>
+
+#ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+#include "Array_accounting.h"
+#endif
 
 #ifdef __CUDACC__
 #include "tools_gpu.h"
@@ -98,7 +105,11 @@ class Array
         // Create an empty array, without dimensions.
         Array() :
             dims({}),
-            ncells(0)
+            ncells(0),
+            data_ptr(nullptr),
+            strides({}),
+            offsets({}),
+            is_view(false)
         {}
 
         // Create an array of zeros with given dimensions.
@@ -106,50 +117,166 @@ class Array
             dims(dims),
             ncells(product<N>(dims)),
             data(ncells),
+            data_ptr(data.data()),
             strides(calc_strides<N>(dims)),
-            offsets({})
-        {}
+            offsets({}),
+            is_view(false)
+        {
+            account_storage();
+        }
 
         // Create an array from copying the contents of an std::vector.
         Array(const std::vector<T>& data, const std::array<int, N>& dims) :
             dims(dims),
             ncells(product<N>(dims)),
             data(data.begin(), data.begin() + ncells), // Do not copy beyond the end.
+            data_ptr(this->data.data()),
             strides(calc_strides<N>(dims)),
-            offsets({})
-        {} // CvH Do we need to size check data?
+            offsets({}),
+            is_view(false)
+        {
+            account_storage();
+        } // CvH Do we need to size check data?
 
         // Create an array from moving the contents of an std::vector.
         Array(std::vector<T>&& data, const std::array<int, N>& dims) :
             dims(dims),
             ncells(product<N>(dims)),
             data(std::move(data)),
+            data_ptr(this->data.data()),
+            strides(calc_strides<N>(dims)),
+            offsets({}),
+            is_view(false)
+        {
+            account_storage();
+        } // CvH Do we need to size check data?
+
+        // Create an array that is a view on memory owned elsewhere.
+        Array(T* ptr, const std::array<int, N>& dims) :
+            dims(dims),
+            ncells(product<N>(dims)),
+            data_ptr(ptr),
             strides(calc_strides<N>(dims)),
-            offsets({})
-        {} // CvH Do we need to size check data?
+            offsets({}),
+            is_view(true)
+        {}
 
-        // Define the default copy constructor and assignment operator.
-        Array(const Array<T, N>&) = default;
-        Array<T,N>& operator=(const Array<T, N>&) = default; // CvH does this one need empty checking?
+        // Create a view with custom strides, for instance on interleaved data.
+        Array(T* ptr, const std::array<int, N>& dims, const std::array<int, N>& strides) :
+            dims(dims),
+            ncells(product<N>(dims)),
+            data_ptr(ptr),
+            strides(strides),
+            offsets({}),
+            is_view(true)
+        {}
+
+        // Copies own their data and are contiguous, also if the source is a view.
+        Array(const Array<T, N>& array) :
+            dims(array.dims),
+            ncells(array.ncells),
+            data(array.ncells),
+            data_ptr(data.data()),
+            strides(calc_strides<N>(array.dims)),
+            offsets(array.offsets),
+            is_view(false)
+        {
+            array.copy_to(data_ptr);
+            account_storage();
+        }
+
+        // Assigning to a view writes into the viewed memory, which therefore cannot be resized.
+        Array<T,N>& operator=(const Array<T, N>& array)
+        {
+            if (this == &array)
+                return *this;
+
+            // Nothing to copy if both arrays refer to the same memory.
+            if (data_ptr == array.data_ptr && dims == array.dims && strides == array.strides)
+                return *this;
+
+            if (is_view)
+            {
+                if (dims != array.dims)
+                    throw std::runtime_error("Array views can not be resized");
+
+                // Copy per run along the first dimension.
+                for (int i=0; i<ncells; i+=dims[0])
+                {
+                    T* out = data_ptr + storage_index(i);
+                    const T* in = array.data_ptr + array.storage_index(i);
+                    for (int n=0; n<dims[0]; ++n)
+                        out[n*strides[0]] = in[n*array.strides[0]];
+                }
+            }
+            else
+            {
+                // The source can be a view on this array, which the resize would invalidate.
+                const std::less<const T*> less;
+                if (!data.empty() && !less(array.data_ptr, data.data()) && less(array.data_ptr, data.data() + data.size()))
+                    return *this = Array<T, N>(array);
+
+                dims = array.dims;
+                ncells = array.ncells;
+                data.resize(ncells);
+                data_ptr = data.data();
+                strides = calc_strides<N>(dims);
+                offsets = array.offsets;
+                array.copy_to(data_ptr);
+                account_storage();
+            }
+
+            return *this;
+        } // CvH does this one need empty checking?
 
         // Implement the move constructor to set ncells back to 0.
         Array(Array<T, N>&& array) :
             dims(std::exchange(array.dims, {})),
             ncells(std::exchange(array.ncells, 0)),
             data(std::move(array.data)),
+            data_ptr(std::exchange(array.data_ptr, nullptr)),
             strides(std::exchange(array.strides, {})),
-            offsets(std::exchange(array.offsets, {}))
-        {}
+            offsets(std::exchange(array.offsets, {})),
+            is_view(std::exchange(array.is_view, false))
+        {
+            take_accounting(array);
+        }
+
+        Array<T,N>& operator=(Array<T, N>&& array)
+        {
+            if (is_view || array.is_view)
+                return (*this = static_cast<const Array<T, N>&>(array));
+
+            dims = std::exchange(array.dims, {});
+            ncells = std::exchange(array.ncells, 0);
+            data = std::move(array.data);
+            data_ptr = std::exchange(array.data_ptr, nullptr);
+            strides = std::exchange(array.strides, {});
+            offsets = std::exchange(array.offsets, {});
+
+            release_accounting();
+            take_accounting(array);
+
+            return *this;
+        }
+
+        ~Array()
+        {
+            release_accounting();
+        }
 
         #ifdef __CUDACC__
         Array(const Array_gpu<T, N>& array_gpu) :
             dims(array_gpu.dims),
             ncells(array_gpu.ncells),
             data(ncells),
+            data_ptr(data.data()),
             strides(array_gpu.strides),
-            offsets(array_gpu.offsets)
+            offsets(array_gpu.offsets),
+            is_view(false)
         {
             cuda_safe_call(cudaMemcpy(data.data(), array_gpu.ptr(), ncells*sizeof(T), cudaMemcpyDeviceToHost));
+            account_storage();
         }
         #endif
 
@@ -159,6 +286,7 @@ class Array
         }
 
         inline std::array<int, N> get_dims() const { return dims; }
+        inline std::array<int, N> get_strides() const { return strides; }
 
         inline void set_dims(const std::array<int, N>& dims)
         {
@@ -168,18 +296,55 @@ class Array
             this->dims = dims;
             ncells = product<N>(dims);
             data.resize(ncells);
+            data_ptr = data.data();
             strides = calc_strides<N>(dims);
             offsets = {};
+            account_storage();
         }
 
-        inline std::vector<T>& v() { return data; }
-        inline const std::vector<T>& v() const { return data; }
+        inline std::vector<T>& v()
+        {
+            if (is_view)
+                throw std::runtime_error("Array views do not own their data");
+            return data;
+        }
+
+        inline const std::vector<T>& v() const
+        {
+            if (is_view)
+                throw std::runtime_error("Array views do not own their data");
+            return data;
+        }
+
+        // Move the storage out, which leaves an empty array and ends its accounting.
+        inline std::vector<T> take_v()
+        {
+            if (is_view)
+                throw std::runtime_error("Array views do not own their data");
+
+            release_accounting();
+
+            std::vector<T> taken;
+            taken.swap(data);
+
+            dims = {};
+            ncells = 0;
+            data_ptr = nullptr;
+            strides = {};
+            offsets = {};
 
-        inline T* ptr() { return data.data(); }
-        inline const T* ptr() const { return data.data(); }
+            return taken;
+        }
+
+        // Only contiguous arrays can be passed as a pointer to the kernels.
+        inline T* ptr() { return data_ptr; }
+        inline const T* ptr() const { return data_ptr; }
 
         inline int size() const { return ncells; }
 
+        inline bool get_is_view() const { return is_view; }
+        inline bool is_contiguous() const { return !is_view || strides == calc_strides<N>(dims); }
+
         // inline std::array<int, N> find_indices(const T& value) const
         // {
         //     int pos = std::find(data.begin(), data.end(), value) - data.begin();
@@ -188,30 +353,47 @@ class Array
 
         inline T max() const
         {
-            return *std::max_element(data.begin(), data.end());
+            if (is_contiguous())
+                return *std::max_element(data_ptr, data_ptr + ncells);
+
+            T value = data_ptr[0];
+            for (int i=1; i<ncells; ++i)
+                value = std::max(value, data_ptr[storage_index(i)]);
+            return value;
         }
 
         inline T min() const
         {
-            return *std::min_element(data.begin(), data.end());
+            if (is_contiguous())
+                return *std::min_element(data_ptr, data_ptr + ncells);
+
+            T value = data_ptr[0];
+            for (int i=1; i<ncells; ++i)
+                value = std::min(value, data_ptr[storage_index(i)]);
+            return value;
         }
 
         inline void operator=(std::vector<T>&& data)
         {
+            if (is_view)
+                throw std::runtime_error("Array views do not own their data");
+
             // CvH check size.
             this->data = data;
+            data_ptr = this->data.data();
+            account_storage();
         }
 
         inline T& operator()(const std::array<int, N>& indices)
         {
             const int index = calc_index<N>(indices, strides, offsets);
-            return data[index];
+            return data_ptr[index];
         }
 
         inline T operator()(const std::array<int, N>& indices) const
         {
             const int index = calc_index<N>(indices, strides, offsets);
-            return data[index];
+            return data_ptr[index];
         }
 
         inline int dim(const int i) const { return dims[i-1]; }
@@ -249,18 +431,44 @@ class Array
             return a_sub;
         }
 
+        // View on a range of the array without copying, dimensions of size one are not spread as in subset.
+        inline Array<T, N> subset_view(const std::array<std::pair<int, int>, N> ranges)
+        {
+            std::array<int, N> subdims;
+            int index = 0;
+            for (int i=0; i<N; ++i)
+            {
+                subdims[i] = ranges[i].second - ranges[i].first + 1;
+                index += (ranges[i].first - offsets[i] - 1)*strides[i];
+            }
+
+            return Array<T, N>(data_ptr + index, subdims, strides);
+        }
+
+        inline Array<T, N> view() { return Array<T, N>(data_ptr, dims, strides); }
+
         inline void fill(const T value)
         {
-            std::fill(data.begin(), data.end(), value);
+            if (is_contiguous())
+                std::fill(data_ptr, data_ptr + ncells, value);
+            else
+                for (int i=0; i<ncells; ++i)
+                    data_ptr[storage_index(i)] = value;
         }
 
         inline void dump(const std::string& name) const
         {
+            if (!is_contiguous())
+            {
+                Array<T, N>(*this).dump(name);
+                return;
+            }
+
             std::string file_name = name + ".bin";
             std::ofstream binary_file(file_name, std::ios::out | std::ios::trunc | std::ios::binary);
 
             if (binary_file)
-                binary_file.write(reinterpret_cast<const char*>(data.data()), ncells*sizeof(T));
+                binary_file.write(reinterpret_cast<const char*>(data_ptr), ncells*sizeof(T));
             else
             {
                 std::string error = "Cannot write file \"" + file_name + "\"";
@@ -272,8 +480,73 @@ class Array
         std::array<int, N> dims;
         int ncells;
         std::vector<T> data;
+        T* data_ptr;
         std::array<int, N> strides;
         std::array<int, N> offsets;
+        bool is_view;
+
+        #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+        std::size_t accounted_bytes = 0;
+        int accounted_tag = -1;
+        #endif
+
+        // Report a change of the owned storage to Array_accounting, a no-op unless compiled in.
+        inline void account_storage()
+        {
+            #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+            const std::size_t bytes = is_view ? 0 : data.capacity()*sizeof(T);
+            if (bytes == accounted_bytes)
+                return;
+
+            release_accounting();
+            accounted_tag = Array_accounting::allocate(Array_accounting::Space::Host, bytes);
+            accounted_bytes = bytes;
+            #endif
+        }
+
+        inline void release_accounting()
+        {
+            #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+            Array_accounting::release(Array_accounting::Space::Host, accounted_bytes, accounted_tag);
+            accounted_bytes = 0;
+            accounted_tag = -1;
+            #endif
+        }
+
+        // Moves transfer the storage, and thus the accounting, without a new allocation.
+        inline void take_accounting([[maybe_unused]] Array<T, N>& array)
+        {
+            #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+            accounted_bytes = std::exchange(array.accounted_bytes, 0);
+            accounted_tag = std::exchange(array.accounted_tag, -1);
+            #endif
+        }
+
+        // Memory index of the i-th element in column-major order, for strided views.
+        inline int storage_index(int i) const
+        {
+            int index = 0;
+            for (int n=0; n<N; ++n)
+            {
+                index += (i % dims[n]) * strides[n];
+                i /= dims[n];
+            }
+            return index;
+        }
+
+        // Copy all elements in column-major order into contiguous memory.
+        inline void copy_to(T* out) const
+        {
+            if (is_contiguous())
+                std::copy(data_ptr, data_ptr + ncells, out);
+            else
+                for (int i=0; i<ncells; i+=dims[0])
+                {
+                    const T* in = data_ptr + storage_index(i);
+                    for (int n=0; n<dims[0]; ++n)
+                        out[i+n] = in[n*strides[0]];
+                }
+        }
 
         #ifdef __CUDACC__
         friend class Array_gpu<T, N>;
@@ -281,6 +554,18 @@ class Array
 };
 
 
+// Return the array if it is contiguous, otherwise a contiguous copy stored in buffer.
+template<typename T, int N>
+inline const Array<T, N>& contiguous(const Array<T, N>& array, Array<T, N>& buffer)
+{
+    if (array.is_contiguous())
+        return array;
+
+    buffer = array;
+    return buffer;
+}
+
+
 #ifdef __CUDACC__
 template<int N>
 struct Subset_data
@@ -354,7 +639,10 @@ class Array_gpu
             if (is_view)
                 data_ptr = nullptr;
             else
+            {
                 Tools_gpu::free_gpu(data_ptr);
+                release_accounting();
+            }
         }
         #endif
 
@@ -378,6 +666,7 @@ class Array_gpu
             {
                 is_view = false;
                 data_ptr = Tools_gpu::allocate_gpu<T>(ncells);
+                account_storage();
                 cuda_safe_call(cudaMemcpy(data_ptr, array.ptr(), ncells*sizeof(T), cudaMemcpyDeviceToDevice));
             }
             else
@@ -395,7 +684,10 @@ class Array_gpu
                 throw std::runtime_error("initialised arrays can not be resized");
 
             if (this->ncells > 0)
+            {
                 Tools_gpu::free_gpu(data_ptr);
+                release_accounting();
+            }
 
             dims = std::exchange(array.dims, {});
             ncells = std::exchange(array.ncells, 0);
@@ -403,6 +695,7 @@ class Array_gpu
             strides = std::exchange(array.strides, {});
             offsets = std::exchange(array.offsets, {});
             is_view = std::exchange(array.is_view, false);
+            take_accounting(array);
 
             return (*this);
         }
@@ -425,6 +718,7 @@ class Array_gpu
             else
             {
                 data_ptr = Tools_gpu::allocate_gpu<T>(ncells);
+                account_storage();
                 cuda_safe_call(cudaMemcpy(data_ptr, array.ptr(), ncells*sizeof(T), cudaMemcpyDeviceToDevice));
             }
         }
@@ -439,6 +733,7 @@ class Array_gpu
             offsets(std::exchange(array.offsets, {})),
             is_view(std::exchange(array.is_view, false))
         {
+            take_accounting(array);
         }
         #endif
 
@@ -453,6 +748,7 @@ class Array_gpu
             is_view(false)
         {
             data_ptr = Tools_gpu::allocate_gpu<T>(ncells);
+            account_storage();
         }
         #endif
 
@@ -470,16 +766,20 @@ class Array_gpu
         #endif
 
         #ifdef __CUDACC__
+        // Strided views are uploaded as a contiguous copy.
         Array_gpu(const Array<T, N>& array) :
             dims(array.dims),
             ncells(array.ncells),
             data_ptr(nullptr),
-            strides(array.strides),
+            strides(calc_strides<N>(array.dims)),
             offsets(array.offsets),
             is_view(false)
         {
             data_ptr = Tools_gpu::allocate_gpu<T>(ncells);
-            cuda_safe_call(cudaMemcpy(data_ptr, array.ptr(), ncells*sizeof(T), cudaMemcpyHostToDevice));
+            account_storage();
+
+            Array<T, N> buffer;
+            cuda_safe_call(cudaMemcpy(data_ptr, contiguous(array, buffer).ptr(), ncells*sizeof(T), cudaMemcpyHostToDevice));
         }
         #endif
 
@@ -507,7 +807,10 @@ class Array_gpu
         inline void set_data(const Array<T, N>& array)
         {
             data_ptr = Tools_gpu::allocate_gpu<T>(ncells);
-            cuda_safe_call(cudaMemcpy(data_ptr, array.ptr(), ncells*sizeof(T), cudaMemcpyHostToDevice));
+            account_storage();
+
+            Array<T, N> buffer;
+            cuda_safe_call(cudaMemcpy(data_ptr, contiguous(array, buffer).ptr(), ncells*sizeof(T), cudaMemcpyHostToDevice));
         }
         #endif
 
@@ -520,6 +823,7 @@ class Array_gpu
             this->dims = dims;
             ncells = product<N>(dims);
             data_ptr = Tools_gpu::allocate_gpu<T>(ncells);
+            account_storage();
             strides = calc_strides<N>(dims);
             offsets = {};
         }
@@ -630,6 +934,38 @@ class Array_gpu
         std::array<int, N> offsets;
         bool is_view;
 
+        #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+        std::size_t accounted_bytes = 0;
+        int accounted_tag = -1;
+        #endif
+
+        // Report a change of the owned device storage to Array_accounting, a no-op unless compiled in.
+        inline void account_storage()
+        {
+            #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+            release_accounting();
+            accounted_bytes = is_view ? 0 : ncells*sizeof(T);
+            accounted_tag = Array_accounting::allocate(Array_accounting::Space::Device, accounted_bytes);
+            #endif
+        }
+
+        inline void release_accounting()
+        {
+            #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+            Array_accounting::release(Array_accounting::Space::Device, accounted_bytes, accounted_tag);
+            accounted_bytes = 0;
+            accounted_tag = -1;
+            #endif
+        }
+
+        inline void take_accounting([[maybe_unused]] Array_gpu<T, N>& array)
+        {
+            #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+            accounted_bytes = std::exchange(array.accounted_bytes, 0);
+            accounted_tag = std::exchange(array.accounted_tag, -1);
+            #endif
+        }
+
         friend class Array<T, N>;
 };
 
@@ -0,0 +1,92 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+#ifndef ARRAY_ACCOUNTING_H
+#define ARRAY_ACCOUNTING_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Accounting of the storage owned by Array and Array_gpu. The arrays only report their allocations
+// if the code is compiled with RTE_RRTMGP_ARRAY_ACCOUNTING, otherwise all statistics stay zero.
+// Allocations are attributed to the innermost open Tag of the allocating thread, and releases
+// to the tag of the allocation, such that the live and peak bytes per tag are exact.
+namespace Array_accounting
+{
+    enum class Space { Host, Device };
+
+    struct Stats
+    {
+        long long n_alloc = 0;
+        long long n_free = 0;
+        long long allocated_bytes = 0;
+        long long live_bytes = 0;
+        long long peak_bytes = 0;
+    };
+
+    struct Tag_stats
+    {
+        std::string name;
+        Stats host;
+        Stats device;
+    };
+
+    constexpr bool is_compiled()
+    {
+        #ifdef RTE_RRTMGP_ARRAY_ACCOUNTING
+        return true;
+        #else
+        return false;
+        #endif
+    }
+
+    // Register an allocation and return the id of the tag it is attributed to, or -1 if bytes is 0.
+    int allocate(const Space space, const std::size_t bytes);
+    void release(const Space space, const std::size_t bytes, const int tag);
+
+    class Tag
+    {
+        public:
+            explicit Tag(const char* name);
+            ~Tag();
+
+            Tag(const Tag&) = delete;
+            Tag& operator=(const Tag&) = delete;
+    };
+
+    Stats get_stats(const Space space);
+
+    // Statistics per tag, in order of first use.
+    std::vector<Tag_stats> get_tag_stats();
+
+    // Set the peak bytes to the live bytes, to measure the peak of a part of the run.
+    void reset_peak();
+
+    void write_report(std::ostream& os);
+    void write_csv(const std::string& file_name);
+}
+#endif
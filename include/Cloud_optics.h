@@ -45,15 +45,33 @@ class Cloud_optics : public Optical_props
                 const Array<Float,2>& lut_extliq, const Array<Float,2>& lut_ssaliq, const Array<Float,2>& lut_asyliq,
                 const Array<Float,3>& lut_extice, const Array<Float,3>& lut_ssaice, const Array<Float,3>& lut_asyice);
 
+        // Ice roughness category (1 = smooth, 2 = medium, 3 = rough) for all columns.
         void cloud_optics(
                 const Array<Float,2>& clwp, const Array<Float,2>& ciwp,
                 const Array<Float,2>& reliq, const Array<Float,2>& reice,
-                Optical_props_1scl& optical_props);
+                Optical_props_1scl& optical_props,
+                const int ice_roughness=2);
 
         void cloud_optics(
                 const Array<Float,2>& clwp, const Array<Float,2>& ciwp,
                 const Array<Float,2>& reliq, const Array<Float,2>& reice,
-                Optical_props_2str& optical_props);
+                Optical_props_2str& optical_props,
+                const int ice_roughness=2);
+
+        // Ice roughness category per column.
+        void cloud_optics(
+                const Array<Float,2>& clwp, const Array<Float,2>& ciwp,
+                const Array<Float,2>& reliq, const Array<Float,2>& reice,
+                Optical_props_1scl& optical_props,
+                const Array<int,1>& ice_roughness);
+
+        void cloud_optics(
+                const Array<Float,2>& clwp, const Array<Float,2>& ciwp,
+                const Array<Float,2>& reliq, const Array<Float,2>& reice,
+                Optical_props_2str& optical_props,
+                const Array<int,1>& ice_roughness);
+
+        int get_n_ice_roughness() const { return lut_extice.dim(3); }
 
     private:
         int liq_nsteps;
@@ -67,13 +85,15 @@ class Cloud_optics : public Optical_props
         Float radice_lwr;
         Float radice_upr;
 
-        // Lookup table coefficients.
-        Array<Float,2> lut_extliq;
-        Array<Float,2> lut_ssaliq;
-        Array<Float,2> lut_asyliq;
-        Array<Float,2> lut_extice;
-        Array<Float,2> lut_ssaice;
-        Array<Float,2> lut_asyice;
+        // Lookup table coefficients (size, band, roughness), liquid has a single roughness slice.
+        Array<Float,3> lut_extliq;
+        Array<Float,3> lut_ssaliq;
+        Array<Float,3> lut_asyliq;
+        Array<Float,3> lut_extice;
+        Array<Float,3> lut_ssaice;
+        Array<Float,3> lut_asyice;
+
+        void check_ice_roughness(const Array<int,1>& ice_roughness, const int ncol) const;
 };
 
 
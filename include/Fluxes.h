@@ -27,6 +27,7 @@
 
 #include <memory>
 #include <stdexcept>
+#include <vector>
 
 #include "Array.h"
 #include "types.h"
@@ -83,6 +84,16 @@ class Fluxes_broadband : public Fluxes
         virtual Array<Float,3>& get_bnd_flux_dn_dir() { throw std::runtime_error("Band fluxes are not available"); }
         virtual Array<Float,3>& get_bnd_flux_net   () { throw std::runtime_error("Band fluxes are not available"); }
 
+        // Heating rates (K s-1) of the layers from the net fluxes and pressures at the levels. The
+        // arrays can be views on larger arrays, for instance a block of columns of the output.
+        static void heating_rate(
+                const Array<Float,2>& flux_net, const Array<Float,2>& p_lev,
+                Array<Float,2>& heating_rate);
+
+        static void heating_rate(
+                const Array<Float,3>& bnd_flux_net, const Array<Float,2>& p_lev,
+                Array<Float,3>& bnd_heating_rate);
+
     private:
         Array<Float,2> flux_up;
         Array<Float,2> flux_dn;
@@ -123,6 +134,52 @@ class Fluxes_byband : public Fluxes_broadband
 };
 
 
+// Fluxes in user-defined spectral bins, for instance PAR or an atmospheric window, that are
+// accumulated in the same pass over the g-point fluxes as the broadband fluxes.
+class Fluxes_custom_bins : public Fluxes_broadband
+{
+    public:
+        // The weights of the g-points in the bins have dims (ngpt, nbin), and are stored sparsely.
+        Fluxes_custom_bins(const int ncol, const int nlev, const Array<Float,2>& gpt_bin_weights);
+        virtual ~Fluxes_custom_bins() {};
+
+        virtual void reduce(
+                const Array<Float,3>& gpt_flux_up,
+                const Array<Float,3>& gpt_flux_dn,
+                const std::unique_ptr<Optical_props_arry>& optical_props,
+                const Bool top_at_1);
+
+        virtual void reduce(
+                const Array<Float,3>& gpt_flux_up,
+                const Array<Float,3>& gpt_flux_dn,
+                const Array<Float,3>& gpt_flux_dn_dir,
+                const std::unique_ptr<Optical_props_arry>& optical_props,
+                const Bool top_at_1);
+
+        Array<Float,3>& get_bin_flux_up    () { return bin_flux_up;     }
+        Array<Float,3>& get_bin_flux_dn    () { return bin_flux_dn;     }
+        Array<Float,3>& get_bin_flux_dn_dir() { return bin_flux_dn_dir; }
+        Array<Float,3>& get_bin_flux_net   () { return bin_flux_net;    }
+
+        // Weights of the g-points in the bins (ngpt, nbin) from the fraction of the band of each
+        // g-point that overlaps with the bin. The bin limits (2, nbin) are wavenumbers in cm-1.
+        static Array<Float,2> bin_weights(
+                const Array<Float,2>& band_lims_wvn, const Array<int,2>& band_lims_gpt,
+                const Array<Float,2>& bin_lims_wvn);
+
+    private:
+        // Weights in compressed rows: the nonzero bins of g-point igpt are in [gpt_offsets[igpt-1], gpt_offsets[igpt]).
+        std::vector<int> gpt_offsets;
+        std::vector<int> bin_index;
+        std::vector<Float> bin_weight;
+
+        Array<Float,3> bin_flux_up;
+        Array<Float,3> bin_flux_dn;
+        Array<Float,3> bin_flux_dn_dir;
+        Array<Float,3> bin_flux_net;
+};
+
+
 //#ifdef USECUDA
 class Fluxes_gpu
 {
@@ -27,6 +27,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "types.h"
 
@@ -42,17 +43,22 @@ class Gas_concs
     public:
         Gas_concs() = default;
         Gas_concs(const Gas_concs& gas_concs_ref, const int start, const int size);
+        Gas_concs(const Gas_concs& gas_concs_ref, const std::vector<int>& cols);
         ~Gas_concs();
 
         // Insert new gas into the map.
         void set_vmr(const std::string& name, const Float data);
         void set_vmr(const std::string& name, const Array<Float,1>& data);
         void set_vmr(const std::string& name, const Array<Float,2>& data);
+        void set_vmr(const std::string& name, Array<Float,2>&& data);
 
         // Retrieve gas from the map.
         // void get_vmr(const std::string& name, Array<Float,2>& data) const;
         const Array<Float,2>& get_vmr(const std::string& name) const;
 
+        // Remove a gas from the map and return its concentrations, such that their storage can be reused.
+        Array<Float,2> take_vmr(const std::string& name);
+
         // Check if gas exists in map.
         Bool exists(const std::string& name) const;
 
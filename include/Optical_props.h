@@ -100,6 +100,16 @@ class Optical_props_1scl : public Optical_props_arry
                 const int nlay,
                 const Optical_props& optical_props);
 
+        // View on existing arrays, for instance the full-domain output of a block solver.
+        Optical_props_1scl(
+                Array<Float,3>& tau,
+                const Optical_props& optical_props);
+
+        // View on the columns col_s to col_e of optical_props.
+        Optical_props_1scl(
+                Optical_props_1scl& optical_props,
+                const int col_s, const int col_e);
+
         void set_subset(
                 const std::unique_ptr<Optical_props_arry>& optical_props_sub,
                 const int col_s, const int col_e);
@@ -126,14 +136,36 @@ class Optical_props_1scl : public Optical_props_arry
 };
 
 
+// Memory layout of the two-stream optical properties. Separate stores tau, ssa and g
+// in three (ncol, nlay, ngpt) arrays, Interleaved stores one (ncol, 3, nlay, ngpt) block
+// in which the column rows of tau, ssa and g of a layer and g-point are adjacent.
+enum class Optical_props_layout { Separate, Interleaved };
+
+
 class Optical_props_2str : public Optical_props_arry
 {
     public:
         Optical_props_2str(
                 const int ncol,
                 const int nlay,
+                const Optical_props& optical_props,
+                const Optical_props_layout layout=Optical_props_layout::Separate);
+
+        // View on existing arrays, for instance the full-domain output of a block solver.
+        Optical_props_2str(
+                Array<Float,3>& tau, Array<Float,3>& ssa, Array<Float,3>& g,
                 const Optical_props& optical_props);
 
+        // View on the columns col_s to col_e of optical_props.
+        Optical_props_2str(
+                Optical_props_2str& optical_props,
+                const int col_s, const int col_e);
+
+        Optical_props_2str(const Optical_props_2str& optical_props);
+
+        // Assignment cannot rebind the views on the storage of the interleaved layout.
+        Optical_props_2str& operator=(const Optical_props_2str&) = delete;
+
         void set_subset(
                 const std::unique_ptr<Optical_props_arry>& optical_props_sub,
                 const int col_s, const int col_e);
@@ -155,16 +187,55 @@ class Optical_props_2str : public Optical_props_arry
 
         void delta_scale(const Array<Float,3>& forward_frac=Array<Float,3>());
 
+        Optical_props_layout get_layout() const { return layout; }
+
     private:
+        Optical_props_layout layout;
+        Array<Float,4> packed; // Only used in the interleaved layout.
+
         Array<Float,3> tau;
         Array<Float,3> ssa;
         Array<Float,3> g;
+
+        Array<Float,3> make_component(const int icomp, const int ncol, const int nlay);
+};
+
+
+// Gas optical properties per g-point and particle optical properties per band,
+// that are only combined per g-point on request, e.g. inside the solver loop.
+class Optical_props_2str_combined : public Optical_props
+{
+    public:
+        Optical_props_2str_combined(
+                const Optical_props_2str& gas_optical_props,
+                const Optical_props_2str& particle_optical_props);
+
+        int get_ncol() const { return gas_optical_props.get_ncol(); }
+        int get_nlay() const { return gas_optical_props.get_nlay(); }
+
+        const Optical_props_2str& get_gas_optical_props() const { return gas_optical_props; }
+        const Optical_props_2str& get_particle_optical_props() const { return particle_optical_props; }
+
+        // Write the combined properties of g-point igpt into (ncol, nlay) arrays.
+        void combine_gpt(
+                const int igpt,
+                Array<Float,2>& tau, Array<Float,2>& ssa, Array<Float,2>& g) const;
+
+    private:
+        const Optical_props_2str& gas_optical_props;
+        const Optical_props_2str& particle_optical_props;
 };
 
 
 void add_to(Optical_props_1scl& op_inout, const Optical_props_1scl& op_in);
 void add_to(Optical_props_2str& op_inout, const Optical_props_2str& op_in);
 
+// Delta-scale op_in on the fly and add it to op_inout in a single sweep, op_in is not modified.
+void add_to_delta_scaled(Optical_props_2str& op_inout, const Optical_props_2str& op_in);
+
+// Add the extinction optical depth of op_in to op_inout, for solvers that only need the total tau.
+void add_extinction_to(Optical_props_1scl& op_inout, const Optical_props_2str& op_in);
+
 
 // GPU version of optical props class
 #ifdef USECUDA
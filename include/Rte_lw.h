@@ -39,9 +39,17 @@ class Source_func_lw;
 class Source_func_lw_gpu;
 
 
+// Treatment of scattering in the longwave solver: none, the rescaling approximation
+// of Tang et al. (2018) on top of the no-scattering solver, or the two-stream solver.
+enum class Lw_scattering { None, Rescaling, Two_stream };
+
+
 class Rte_lw
 {
     public:
+        // The fluxes are per g-point, per band, or broadband depending on the third
+        // dimension (ngpt, nband or 1) of gpt_flux_up and gpt_flux_dn. Scattering requires
+        // two-stream optical properties, the two-stream solver ignores n_gauss_angles.
         static void rte_lw(
                 const std::unique_ptr<Optical_props_arry>& optical_props,
                 const Bool top_at_1,
@@ -50,7 +58,42 @@ class Rte_lw
                 const Array<Float,2>& inc_flux,
                 Array<Float,3>& gpt_flux_up,
                 Array<Float,3>& gpt_flux_dn,
-                const int n_gauss_angles);
+                const int n_gauss_angles,
+                const Lw_scattering scattering=Lw_scattering::None);
+
+        // As above, with the broadband surface temperature Jacobian d(flux_up)/d(T_sfc) in flux_up_jac (ncol, nlev),
+        // which is not computed if flux_up_jac is empty. Not available in the two-stream solver.
+        static void rte_lw(
+                const std::unique_ptr<Optical_props_arry>& optical_props,
+                const Bool top_at_1,
+                const Source_func_lw& sources,
+                const Array<Float,2>& sfc_emis,
+                const Array<Float,2>& inc_flux,
+                Array<Float,3>& gpt_flux_up,
+                Array<Float,3>& gpt_flux_dn,
+                Array<Float,2>& flux_up_jac,
+                const int n_gauss_angles,
+                const Lw_scattering scattering=Lw_scattering::None);
+
+        // Linear update of the broadband upward flux flux_up_ref of a full solve at surface temperature
+        // t_sfc_ref to surface temperature t_sfc, with the Jacobian flux_up_jac of that solve.
+        // Only the upward flux is written, a net flux of the reference solve is stale afterwards.
+        static void update_flux_up(
+                const Array<Float,2>& flux_up_ref,
+                const Array<Float,2>& flux_up_jac,
+                const Array<Float,1>& t_sfc_ref,
+                const Array<Float,1>& t_sfc,
+                Array<Float,2>& flux_up);
+
+        // As above, and recompute flux_net from flux_dn, which does not depend on the surface temperature.
+        static void update_flux_up(
+                const Array<Float,2>& flux_up_ref,
+                const Array<Float,2>& flux_up_jac,
+                const Array<Float,1>& t_sfc_ref,
+                const Array<Float,1>& t_sfc,
+                const Array<Float,2>& flux_dn,
+                Array<Float,2>& flux_up,
+                Array<Float,2>& flux_net);
 
         static void expand_and_transpose(
                 const std::unique_ptr<Optical_props_arry>& ops,
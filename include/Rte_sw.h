@@ -32,13 +32,18 @@
 // Forward declarations.
 template<typename, int> class Array;
 template<typename, int> class Array_gpu;
+class Optical_props;
 class Optical_props_arry;
 class Optical_props_arry_gpu;
+class Optical_props_2str_combined;
 
 
 class Rte_sw
 {
     public:
+        // Two-stream optical properties run the two-stream solver, Optical_props_1scl runs
+        // the direct-beam solver only, with gpt_flux_dn equal to gpt_flux_dir and no upward flux.
+        // The direct-beam solver throws if an incoming diffuse flux is given.
         static void rte_sw(
                 const std::unique_ptr<Optical_props_arry>& optical_props,
                 const Bool top_at_1,
@@ -51,6 +56,53 @@ class Rte_sw
                 Array<Float,3>& gpt_flux_dn,
                 Array<Float,3>& gpt_flux_dir);
 
+        // The cosine of the solar zenith angle is mu0 at the top of the domain and mu0_lay(ncol, nlay)
+        // in the layers, for spherical geometry. An empty mu0_lay is plane-parallel and constant with height.
+        static void rte_sw(
+                const std::unique_ptr<Optical_props_arry>& optical_props,
+                const Bool top_at_1,
+                const Array<Float,1>& mu0,
+                const Array<Float,2>& mu0_lay,
+                const Array<Float,2>& inc_flux_dir,
+                const Array<Float,2>& sfc_alb_dir,
+                const Array<Float,2>& sfc_alb_dif,
+                const Array<Float,2>& inc_flux_dif,
+                Array<Float,3>& gpt_flux_up,
+                Array<Float,3>& gpt_flux_dn,
+                Array<Float,3>& gpt_flux_dir);
+
+        // Solver that combines the gas and particle optical properties per g-point.
+        static void rte_sw(
+                const Optical_props_2str_combined& optical_props,
+                const Bool top_at_1,
+                const Array<Float,1>& mu0,
+                const Array<Float,2>& inc_flux_dir,
+                const Array<Float,2>& sfc_alb_dir,
+                const Array<Float,2>& sfc_alb_dif,
+                const Array<Float,2>& inc_flux_dif,
+                Array<Float,3>& gpt_flux_up,
+                Array<Float,3>& gpt_flux_dn,
+                Array<Float,3>& gpt_flux_dir);
+
+        // Batched solver for nscen scenarios of solar geometry and surface that share the two-stream optical
+        // properties, with the scenario as the fastest dimension: mu0(nscen, ncol), inc_flux_dir(nscen, ncol, ngpt),
+        // sfc_alb_dir and sfc_alb_dif(nscen, ncol, nband) and the broadband fluxes(nscen, ncol, nlev).
+        static void rte_sw_batched(
+                const std::unique_ptr<Optical_props_arry>& optical_props,
+                const Bool top_at_1,
+                const Array<Float,2>& mu0,
+                const Array<Float,3>& inc_flux_dir,
+                const Array<Float,3>& sfc_alb_dir,
+                const Array<Float,3>& sfc_alb_dif,
+                Array<Float,3>& flux_up,
+                Array<Float,3>& flux_dn,
+                Array<Float,3>& flux_dir);
+
+        static void expand_and_transpose(
+                const Optical_props& ops,
+                const Array<Float,2> arr_in,
+                Array<Float,2>& arr_out);
+
         static void expand_and_transpose(
                 const std::unique_ptr<Optical_props_arry>& ops,
                 const Array<Float,2> arr_in,
@@ -40,12 +40,20 @@ class Source_func_lw : public Optical_props
                 const int n_lay,
                 const Optical_props& optical_props);
 
+        // View on existing source arrays, the surface Jacobian is owned.
+        Source_func_lw(
+                Array<Float,2>& sfc_source,
+                Array<Float,3>& lay_source,
+                Array<Float,3>& lev_source_inc,
+                Array<Float,3>& lev_source_dec,
+                const Optical_props& optical_props);
+
         void set_subset(
                 const Source_func_lw& sources_sub,
                 const int col_s, const int col_e);
 
         void get_subset(
-                const Source_func_lw& sources_sub,
+                Source_func_lw& sources_sub,
                 const int col_s, const int col_e);
 
         Array<Float,2>& get_sfc_source()     { return sfc_source;     }
@@ -0,0 +1,73 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+#include <string>
+
+
+// Nested region timers and counters for profiling the radiation pipeline.
+// Each thread records into its own tree of regions without locking, the trees
+// are merged by path when a report is written. Timing is off until enabled,
+// a disabled region costs a single atomic load.
+namespace Timer
+{
+    void set_enabled(const bool enabled);
+    bool is_enabled();
+
+    // Also sample cycles, instructions and LLC misses per region with perf_event_open (Linux only),
+    // and a model-specific raw floating point event if fp_event is nonzero. Throws if the counters
+    // cannot be opened. Derived IPC, bandwidth and fp_ops per byte are added to the reports.
+    void set_hardware_counters(const bool enabled, const unsigned long long fp_event=0);
+
+    class Region
+    {
+        public:
+            explicit Region(const char* name);
+            ~Region();
+
+            // End the region before the end of its scope, it must be the innermost open region.
+            void stop();
+
+            Region(const Region&) = delete;
+            Region& operator=(const Region&) = delete;
+
+        private:
+            int node;
+            std::chrono::steady_clock::time_point time_start;
+    };
+
+    // Add value to the named counter of the calling thread.
+    void count(const char* name, const long long value);
+
+    // Write the merged regions and counters, no regions may be open while writing.
+    void write_json(const std::string& file_name);
+    void write_csv(const std::string& file_name);
+
+    // Zero all regions and counters. Open regions stay valid, but no other thread may be recording.
+    void reset();
+}
+#endif
@@ -24,6 +24,13 @@ using Float = double;
 const Float Float_epsilon = DBL_EPSILON;
 #endif
 
+// Lower bound of k squared in the two-stream solutions of the longwave and shortwave solvers.
+#ifdef RTE_USE_SP
+const Float Two_stream_k_min = Float(1.e-4);
+#else
+const Float Two_stream_k_min = Float(1.e-12);
+#endif
+
 using Int = unsigned long long;
 const Int Atomic_reduce_const = (Int)(-1LL);
 
@@ -24,15 +24,45 @@
 #include <map>
 #include <iostream>
 #include <numeric>
+#include <array>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <netcdf.h>
 
 #include "Status.h"
+#include "Timer.h"
 
 enum class Netcdf_mode { Create, Read, Write };
 
+// The NetCDF library is not thread safe, thus every call of the file and handle functions below holds
+// this mutex. Calls of other threads interleave between them. It is recursive, such that code can
+// hold it over a sequence of calls.
+inline std::recursive_mutex& netcdf_library_mutex()
+{
+    static std::recursive_mutex library_mutex;
+    return library_mutex;
+}
+
+using Netcdf_lock = std::lock_guard<std::recursive_mutex>;
+
+// Storage settings of a NetCDF-4 variable, empty chunk sizes give the default (contiguous) storage.
+struct Netcdf_storage
+{
+    std::vector<int> chunk_sizes;
+    int deflate_level = 0;
+    bool shuffle = false;
+};
+
 class Netcdf_handle;
 class Netcdf_group;
 
+template<typename, int> class Array;
+
 template<typename T>
 class Netcdf_variable
 {
@@ -73,6 +103,12 @@ class Netcdf_handle
                 const std::string&,
                 const std::vector<std::string>&);
 
+        template<typename T>
+        Netcdf_variable<T> add_variable(
+                const std::string&,
+                const std::vector<std::string>&,
+                const Netcdf_storage&);
+
         template<typename T>
         Netcdf_variable<T> add_variable(
                 const std::string&);
@@ -93,6 +129,13 @@ class Netcdf_handle
                 const std::vector<int>&,
                 const std::vector<int>&) const;
 
+        template<typename T, int N>
+        void get_variable(
+                Array<T,N>&,
+                const std::string&,
+                const std::vector<int>&,
+                const std::vector<int>&) const;
+
         template<typename T>
         void insert(
                 const std::vector<T>&,
@@ -144,6 +187,86 @@ class Netcdf_group : public Netcdf_handle
         Netcdf_group(const int, const int);
 };
 
+// Reader that prefetches many (hyperslab) reads of one file in order from a single background thread,
+// such that the caller can continue with other work. The library calls are serialized, thus more
+// threads would not read faster.
+class Netcdf_batch_reader
+{
+    public:
+        explicit Netcdf_batch_reader(const std::string&);
+        ~Netcdf_batch_reader();
+
+        Netcdf_batch_reader(const Netcdf_batch_reader&) = delete;
+        Netcdf_batch_reader& operator=(const Netcdf_batch_reader&) = delete;
+
+        template<typename T, int N>
+        std::future<Array<T,N>> get_variable(
+                const std::string&,
+                const std::array<int,N>&,
+                const std::vector<int>&,
+                const std::vector<int>&);
+
+        template<typename T, int N>
+        std::future<Array<T,N>> get_variable(
+                Array<T,N>&&,
+                const std::string&,
+                const std::array<int,N>&,
+                const std::vector<int>&,
+                const std::vector<int>&);
+
+    private:
+        void work();
+
+        const std::string file_name;
+        std::unique_ptr<Netcdf_file> nc_file;
+
+        std::deque<std::function<void()>> tasks;
+        std::mutex tasks_mutex;
+        std::condition_variable tasks_cv;
+        bool stop = false;
+
+        // The worker uses all members above, thus it is started last.
+        std::thread worker;
+};
+
+// Writer that inserts moved-in buffers from a background thread, such that the caller can continue while
+// the output is compressed and flushed. The variables, and thus their files, have to outlive the writer.
+class Netcdf_async_writer
+{
+    public:
+        Netcdf_async_writer();
+        ~Netcdf_async_writer();
+
+        Netcdf_async_writer(const Netcdf_async_writer&) = delete;
+        Netcdf_async_writer& operator=(const Netcdf_async_writer&) = delete;
+
+        template<typename T>
+        void insert(const Netcdf_variable<T>&, std::vector<T>&&, const std::vector<int>&);
+
+        template<typename T>
+        void insert(const Netcdf_variable<T>&, std::vector<T>&&, const std::vector<int>&, const std::vector<int>&);
+
+        template<typename T, int N>
+        void insert(const Netcdf_variable<T>&, Array<T,N>&&, const std::vector<int>&);
+
+        void finish();
+
+    private:
+        void work();
+
+        std::deque<std::function<void()>> tasks;
+        std::mutex tasks_mutex;
+        std::condition_variable tasks_cv;
+        std::condition_variable idle_cv;
+        bool busy = false;
+        bool stop = false;
+
+        std::exception_ptr error;
+
+        // The worker uses all members above, thus it is started last.
+        std::thread worker;
+};
+
 // Implementation.
 namespace
 {
@@ -205,6 +328,32 @@ namespace
         return nc_get_vara_schar(ncid, var_id, start.data(), count.data(), values.data());
     }
 
+    // Wrapper for the `nc_get_vara_TYPE` functions that read into raw storage.
+    template<typename TF>
+    int nc_get_vara_wrapper(
+            int, int, const std::vector<size_t>&, const std::vector<size_t>&, TF*);
+
+    template<>
+    int nc_get_vara_wrapper(
+            int ncid, int var_id, const std::vector<size_t>& start, const std::vector<size_t>& count, double* values)
+    {
+        return nc_get_vara_double(ncid, var_id, start.data(), count.data(), values);
+    }
+
+    template<>
+    int nc_get_vara_wrapper(
+            int ncid, int var_id, const std::vector<size_t>& start, const std::vector<size_t>& count, float* values)
+    {
+        return nc_get_vara_float(ncid, var_id, start.data(), count.data(), values);
+    }
+
+    template<>
+    int nc_get_vara_wrapper(
+            int ncid, int var_id, const std::vector<size_t>& start, const std::vector<size_t>& count, int* values)
+    {
+        return nc_get_vara_int(ncid, var_id, start.data(), count.data(), values);
+    }
+
     // Wrapper for the `nc_put_vara_TYPE` functions
     template<typename TF>
     int nc_put_vara_wrapper(
@@ -261,6 +410,8 @@ namespace
 inline Netcdf_file::Netcdf_file(const std::string& name, Netcdf_mode mode) :
         Netcdf_handle()
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     if (mode == Netcdf_mode::Create)
@@ -294,6 +445,8 @@ inline Netcdf_file::Netcdf_file(const std::string& name, Netcdf_mode mode) :
 
 inline Netcdf_file::~Netcdf_file()
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     nc_check_code = nc_close(ncid);
@@ -302,6 +455,8 @@ inline Netcdf_file::~Netcdf_file()
 
 inline void Netcdf_file::sync()
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     nc_check_code = nc_sync(ncid);
@@ -310,6 +465,8 @@ inline void Netcdf_file::sync()
 
 inline void Netcdf_handle::add_dimension(const std::string& dim_name, const int dim_size)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     nc_check_code = nc_redef(root_ncid);
@@ -337,6 +494,8 @@ template<typename T>
 inline Netcdf_variable<T> Netcdf_handle::add_variable(
         const std::string& var_name)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     int var_id = -1;
@@ -360,6 +519,19 @@ inline Netcdf_variable<T> Netcdf_handle::add_variable(
         const std::string& var_name,
         const std::vector<std::string>& dim_names)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
+    return add_variable<T>(var_name, dim_names, Netcdf_storage());
+}
+
+template<typename T>
+inline Netcdf_variable<T> Netcdf_handle::add_variable(
+        const std::string& var_name,
+        const std::vector<std::string>& dim_names,
+        const Netcdf_storage& storage)
+{
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     int var_id = -1;
@@ -377,6 +549,23 @@ inline Netcdf_variable<T> Netcdf_handle::add_variable(
     nc_check_code = nc_def_var(ncid, var_name.c_str(), netcdf_dtype<T>(), ndims, dim_ids.data(), &var_id);
     nc_check(nc_check_code);
 
+    if (!storage.chunk_sizes.empty())
+    {
+        if (static_cast<int>(storage.chunk_sizes.size()) != ndims)
+            throw std::runtime_error("Netcdf variable: " + var_name + " has chunks of the wrong rank");
+
+        const std::vector<size_t> chunk_sizes_size_t(storage.chunk_sizes.begin(), storage.chunk_sizes.end());
+        nc_check_code = nc_def_var_chunking(ncid, var_id, NC_CHUNKED, chunk_sizes_size_t.data());
+        nc_check(nc_check_code);
+    }
+
+    if (storage.deflate_level > 0 || storage.shuffle)
+    {
+        nc_check_code = nc_def_var_deflate(
+                ncid, var_id, storage.shuffle, storage.deflate_level > 0, storage.deflate_level);
+        nc_check(nc_check_code);
+    }
+
     nc_check_code = nc_enddef(root_ncid);
     nc_check(nc_check_code);
 
@@ -419,6 +608,8 @@ inline void Netcdf_handle::insert(
         const std::vector<int>& i_start,
         const std::vector<int>& i_count)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     const std::vector<size_t> i_start_size_t (i_start.begin(), i_start.end());
     const std::vector<size_t> i_count_size_t (i_count.begin(), i_count.end());
 
@@ -436,6 +627,8 @@ inline void Netcdf_handle::insert(
         const std::vector<int>& i_start,
         const std::vector<int>& i_count)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     const std::vector<size_t> i_start_size_t (i_start.begin(), i_start.end());
     const std::vector<size_t> i_count_size_t (i_count.begin(), i_count.end());
 
@@ -451,6 +644,8 @@ inline void Netcdf_handle::add_attribute(
         const std::string& value,
         const int var_id)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     nc_check_code = nc_redef(root_ncid);
@@ -469,6 +664,8 @@ inline void Netcdf_handle::add_attribute(
         const double value,
         const int var_id)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     nc_check_code = nc_redef(root_ncid);
@@ -487,6 +684,8 @@ inline void Netcdf_handle::add_attribute(
         const float value,
         const int var_id)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
 
     nc_check_code = nc_redef(root_ncid);
@@ -502,6 +701,8 @@ inline void Netcdf_handle::add_attribute(
 
 inline Netcdf_group Netcdf_handle::add_group(const std::string& name)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int group_ncid = -1;
     int nc_check_code = 0;
 
@@ -519,6 +720,8 @@ inline Netcdf_group Netcdf_handle::add_group(const std::string& name)
 
 inline Netcdf_group Netcdf_handle::get_group(const std::string& name) const
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int group_ncid = -1;
     int nc_check_code = 0;
 
@@ -530,6 +733,8 @@ inline Netcdf_group Netcdf_handle::get_group(const std::string& name) const
 
 inline int Netcdf_handle::get_dimension_size(const std::string& name)
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
     int dim_id;
 
@@ -555,6 +760,8 @@ inline Netcdf_group::Netcdf_group(const int ncid_in, const int root_ncid_in) :
 inline std::map<std::string, int> Netcdf_handle::get_variable_dimensions(
         const std::string& name) const
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
     int var_id;
 
@@ -587,6 +794,8 @@ inline std::map<std::string, int> Netcdf_handle::get_variable_dimensions(
 
 inline bool Netcdf_handle::variable_exists(const std::string& name) const
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     int nc_check_code = 0;
     int var_id;
 
@@ -607,6 +816,8 @@ template<typename TF>
 inline TF Netcdf_handle::get_variable(
         const std::string& name) const
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     // std::string message = "Retrieving from NetCDF (single value): " + name;
     // Status::print_message(message);
 
@@ -641,6 +852,8 @@ inline std::vector<TF> Netcdf_handle::get_variable(
         const std::string& name,
         const std::vector<int>& i_count) const
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     // std::string message = "Retrieving from NetCDF (full array): " + name;
     // Status::print_message(message);
 
@@ -679,6 +892,8 @@ inline void Netcdf_handle::get_variable(
         const std::vector<int>& i_start,
         const std::vector<int>& i_count) const
 {
+    Netcdf_lock lock(netcdf_library_mutex());
+
     // std::string message = "Retrieving from NetCDF: " + name;
     // Status::print_message(message);
 
@@ -715,6 +930,297 @@ inline void Netcdf_handle::get_variable(
     }
 }
 
+// Read a hyperslab directly into the storage of a contiguous array, without intermediate copies.
+// The hyperslab is in C order, thus its last dimension is the fastest varying dimension of the array.
+template<typename TF, int N>
+inline void Netcdf_handle::get_variable(
+        Array<TF,N>& array,
+        const std::string& name,
+        const std::vector<int>& i_start,
+        const std::vector<int>& i_count) const
+{
+    Netcdf_lock lock(netcdf_library_mutex());
+
+    const int total_count = std::accumulate(i_count.begin(), i_count.end(), 1, std::multiplies<>());
+
+    if (total_count != array.size())
+        throw std::runtime_error("Netcdf variable: " + name + " does not match the size of the array");
+
+    // Only arrays with the default strides can be filled with a single read.
+    const auto strides = array.get_strides();
+    int stride = 1;
+    for (int i=0; i<N; ++i)
+    {
+        if (strides[i] != stride)
+            throw std::runtime_error("Netcdf variable: " + name + " can only be read into a contiguous array");
+        stride *= array.dim(i+1);
+    }
+
+    const std::vector<size_t> i_start_size_t (i_start.begin(), i_start.end());
+    const std::vector<size_t> i_count_size_t (i_count.begin(), i_count.end());
+
+    int nc_check_code = 0;
+    int var_id;
+
+    bool zero_fill = false;
+    try
+    {
+        nc_check_code = nc_inq_varid(ncid, name.c_str(), &var_id);
+        nc_check(nc_check_code);
+    }
+    catch (std::runtime_error& e)
+    {
+        std::string warning = "Netcdf variable: " + name + " not found, filling with zeros";
+        Status::print_warning(warning);
+        zero_fill = true;
+    }
+
+    if (zero_fill)
+    {
+        std::fill(array.ptr(), array.ptr() + total_count, 0);
+    }
+    else
+    {
+        nc_check_code = nc_get_vara_wrapper(ncid, var_id, i_start_size_t, i_count_size_t, array.ptr());
+        nc_check(nc_check_code);
+    }
+}
+
+inline Netcdf_batch_reader::Netcdf_batch_reader(const std::string& file_name) :
+        file_name(file_name),
+        worker(&Netcdf_batch_reader::work, this)
+{}
+
+inline Netcdf_batch_reader::~Netcdf_batch_reader()
+{
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        stop = true;
+    }
+    tasks_cv.notify_all();
+    worker.join();
+}
+
+// Queue the read of a hyperslab into a new array of dimensions dims, the future holds the array or the error.
+template<typename TF, int N>
+inline std::future<Array<TF,N>> Netcdf_batch_reader::get_variable(
+        const std::string& name,
+        const std::array<int,N>& dims,
+        const std::vector<int>& i_start,
+        const std::vector<int>& i_count)
+{
+    return get_variable<TF,N>(Array<TF,N>(), name, dims, i_start, i_count);
+}
+
+// Queue the read of a hyperslab into the storage of a moved-in array, which is given back with dimensions dims
+// in the future. Storage of at least the size of the hyperslab is read into without being cleared first,
+// thus a recycled array gets each value written once.
+template<typename TF, int N>
+inline std::future<Array<TF,N>> Netcdf_batch_reader::get_variable(
+        Array<TF,N>&& storage,
+        const std::string& name,
+        const std::array<int,N>& dims,
+        const std::vector<int>& i_start,
+        const std::vector<int>& i_count)
+{
+    auto promise = std::make_shared<std::promise<Array<TF,N>>>();
+    std::future<Array<TF,N>> future = promise->get_future();
+
+    // The storage is handed to the task as a vector, such that a view cannot end up in the queue.
+    auto data = std::make_shared<std::vector<TF>>(storage.take_v());
+
+    auto task = [this, promise, data, name, dims, i_start, i_count]()
+    {
+        try
+        {
+            // Shrinking, or growing within the capacity, keeps the storage; only new elements are cleared.
+            data->resize(std::accumulate(dims.begin(), dims.end(), 1, std::multiplies<>()));
+            Array<TF,N> array(std::move(*data), dims);
+
+            if (!nc_file)
+                nc_file = std::make_unique<Netcdf_file>(file_name, Netcdf_mode::Read);
+
+            if (!nc_file->variable_exists(name))
+                throw std::runtime_error("Netcdf variable: " + name + " not found");
+
+            nc_file->get_variable(array, name, i_start, i_count);
+            promise->set_value(std::move(array));
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        tasks.push_back(std::move(task));
+    }
+    tasks_cv.notify_one();
+
+    return future;
+}
+
+inline void Netcdf_batch_reader::work()
+{
+    // The file is opened on the first read, such that an error ends up in its future.
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(tasks_mutex);
+            tasks_cv.wait(lock, [&]{ return stop || !tasks.empty(); });
+
+            if (tasks.empty())
+                break;
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        Timer::Region region("read_input");
+        task();
+    }
+
+    nc_file.reset();
+}
+
+inline Netcdf_async_writer::Netcdf_async_writer() :
+        worker(&Netcdf_async_writer::work, this)
+{}
+
+inline Netcdf_async_writer::~Netcdf_async_writer()
+{
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        stop = true;
+    }
+    tasks_cv.notify_all();
+    worker.join();
+
+    // A destructor cannot throw, thus an error that finish() did not rethrow is reported.
+    if (error)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch (const std::exception& e)
+        {
+            Status::print_warning("Asynchronous NetCDF write failed: " + std::string(e.what()));
+        }
+        catch (...)
+        {
+            Status::print_warning("Asynchronous NetCDF write failed");
+        }
+    }
+}
+
+// Queue the write of values, taking over their storage, at i_start with the full extent of the variable.
+template<typename T>
+inline void Netcdf_async_writer::insert(
+        const Netcdf_variable<T>& var, std::vector<T>&& values, const std::vector<int>& i_start)
+{
+    auto values_ptr = std::make_shared<std::vector<T>>(std::move(values));
+
+    auto task = [var = Netcdf_variable<T>(var), values_ptr, i_start]() mutable
+    {
+        var.insert(*values_ptr, i_start);
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        tasks.push_back(std::move(task));
+    }
+    tasks_cv.notify_one();
+}
+
+// Queue the write of values, taking over their storage, into the hyperslab at i_start of size i_count.
+template<typename T>
+inline void Netcdf_async_writer::insert(
+        const Netcdf_variable<T>& var, std::vector<T>&& values,
+        const std::vector<int>& i_start, const std::vector<int>& i_count)
+{
+    auto values_ptr = std::make_shared<std::vector<T>>(std::move(values));
+
+    auto task = [var = Netcdf_variable<T>(var), values_ptr, i_start, i_count]() mutable
+    {
+        var.insert(*values_ptr, i_start, i_count);
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        tasks.push_back(std::move(task));
+    }
+    tasks_cv.notify_one();
+}
+
+template<typename T, int N>
+inline void Netcdf_async_writer::insert(
+        const Netcdf_variable<T>& var, Array<T,N>&& array, const std::vector<int>& i_start)
+{
+    insert(var, array.take_v(), i_start);
+}
+
+// Wait until all queued writes are done, and rethrow the first error of the writes.
+inline void Netcdf_async_writer::finish()
+{
+    std::unique_lock<std::mutex> lock(tasks_mutex);
+    idle_cv.wait(lock, [&]{ return tasks.empty() && !busy; });
+
+    if (error)
+    {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+inline void Netcdf_async_writer::work()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        bool skip;
+        {
+            std::unique_lock<std::mutex> lock(tasks_mutex);
+            tasks_cv.wait(lock, [&]{ return stop || !tasks.empty(); });
+
+            if (tasks.empty())
+                break;
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            busy = true;
+
+            // After an error the remaining writes are skipped.
+            skip = bool(error);
+        }
+
+        std::exception_ptr task_error;
+        if (!skip)
+        {
+            try
+            {
+                Timer::Region region("write_output");
+                task();
+            }
+            catch (...)
+            {
+                task_error = std::current_exception();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(tasks_mutex);
+            if (task_error && !error)
+                error = task_error;
+            busy = false;
+        }
+        idle_cv.notify_all();
+    }
+}
+
 // Variable does not communicate with NetCDF library directly.
 template<typename T>
 inline Netcdf_variable<T>::Netcdf_variable(Netcdf_handle& nc_file, const int var_id, const std::vector<int>& dim_sizes) :
@@ -20,6 +20,10 @@
 #ifndef RADIATION_SOLVER_H
 #define RADIATION_SOLVER_H
 
+#include <map>
+#include <memory>
+#include <vector>
+
 #include "Array.h"
 #include "Gas_concs.h"
 #include "Gas_optics_rrtmgp.h"
@@ -28,11 +32,48 @@
 #include "Rte_lw.h"
 #include "Rte_sw.h"
 #include "Source_functions.h"
+#include "Fluxes.h"
 
 
 class Radiation_solver_longwave
 {
     public:
+        // Work arrays of the column blocks, which the caller can keep to reuse them over the calls of solve.
+        // A workspace can only be used by one call at a time.
+        struct Workspace
+        {
+            struct Block
+            {
+                std::unique_ptr<Optical_props_arry> optical_props;
+                std::unique_ptr<Optical_props_arry> cloud_optical_props;
+                std::unique_ptr<Source_func_lw> sources;
+                std::unique_ptr<Fluxes_broadband> fluxes;
+                Array<Float,3> gpt_flux_up;
+                Array<Float,3> gpt_flux_dn;
+                Array<Float,2> flux_up_jac;
+                Array<Float,2> col_dry;
+            };
+
+            // Settings of the solve that determine the work arrays, the bin limits are empty without bin fluxes.
+            struct Settings
+            {
+                int n_lay = 0;
+                Lw_scattering lw_scattering = Lw_scattering::None;
+                bool switch_fluxes = false;
+                bool switch_cloud_optics = false;
+                bool switch_output_bnd_fluxes = false;
+                bool switch_lw_jacobians = false;
+                bool switch_output_bin_fluxes = false;
+                Array<Float,2> bin_lims_wvn;
+
+                bool operator==(const Settings&) const;
+            };
+
+            // Blocks by number of columns, valid for the settings of the solve that made them.
+            std::map<int, Block> blocks;
+            Settings settings;
+        };
+
         Radiation_solver_longwave(
                 const Gas_concs& gas_concs,
                 const std::string& file_name_gas,
@@ -48,6 +89,11 @@ class Radiation_solver_longwave
                 const bool switch_cloud_optics,
                 const bool switch_output_optical,
                 const bool switch_output_bnd_fluxes,
+                const bool switch_lw_rescaling,
+                const bool switch_lw_two_stream,
+                const bool switch_lw_jacobians,
+                const bool switch_heating_rates,
+                const bool switch_output_bin_fluxes,
                 const Gas_concs& gas_concs,
                 const Array<Float,2>& p_lay, const Array<Float,2>& p_lev,
                 const Array<Float,2>& t_lay, const Array<Float,2>& t_lev,
@@ -55,10 +101,15 @@ class Radiation_solver_longwave
                 const Array<Float,1>& t_sfc, const Array<Float,2>& emis_sfc,
                 const Array<Float,2>& lwp, const Array<Float,2>& iwp,
                 const Array<Float,2>& rel, const Array<Float,2>& rei,
+                const Array<Float,2>& bin_lims_wvn,
                 Array<Float,3>& tau, Array<Float,3>& lay_source,
                 Array<Float,3>& lev_source_inc, Array<Float,3>& lev_source_dec, Array<Float,2>& sfc_source,
                 Array<Float,2>& lw_flux_up, Array<Float,2>& lw_flux_dn, Array<Float,2>& lw_flux_net,
-                Array<Float,3>& lw_bnd_flux_up, Array<Float,3>& lw_bnd_flux_dn, Array<Float,3>& lw_bnd_flux_net) const;
+                Array<Float,3>& lw_bnd_flux_up, Array<Float,3>& lw_bnd_flux_dn, Array<Float,3>& lw_bnd_flux_net,
+                Array<Float,2>& lw_flux_up_jac,
+                Array<Float,2>& lw_heating_rate, Array<Float,3>& lw_bnd_heating_rate,
+                Array<Float,3>& lw_bin_flux_up, Array<Float,3>& lw_bin_flux_dn, Array<Float,3>& lw_bin_flux_net,
+                Workspace* workspace=nullptr) const;
 
         int get_n_gpt() const { return this->kdist->get_ngpt(); };
         int get_n_bnd() const { return this->kdist->get_nband(); };
@@ -69,6 +120,10 @@ class Radiation_solver_longwave
         Array<Float,2> get_band_lims_wavenumber() const
         { return this->kdist->get_band_lims_wavenumber(); }
 
+        // Number of columns of which the optical properties are computed at once.
+        void set_n_col_block(const int n_col_block);
+        int get_n_col_block() const { return this->n_col_block; }
+
         #ifdef __CUDACC__
         void solve_gpu(
                 const bool switch_fluxes,
@@ -98,6 +153,8 @@ class Radiation_solver_longwave
         #endif
 
     private:
+        int n_col_block = 12;
+
         std::unique_ptr<Gas_optics_rrtmgp> kdist;
         std::unique_ptr<Cloud_optics> cloud_optics;
 
@@ -121,6 +178,47 @@ class Radiation_solver_longwave
 class Radiation_solver_shortwave
 {
     public:
+        // Work arrays of the column blocks, which the caller can keep to reuse them over the calls of solve.
+        // A workspace can only be used by one call at a time.
+        struct Workspace
+        {
+            struct Block
+            {
+                std::unique_ptr<Optical_props_arry> optical_props;
+                std::unique_ptr<Optical_props_2str> cloud_optical_props;
+                std::unique_ptr<Optical_props_2str> aerosol_optical_props;
+                std::unique_ptr<Fluxes_byband> bnd_fluxes;
+                std::unique_ptr<Fluxes_custom_bins> bin_fluxes;
+                Array<Float,3> gpt_flux_up;
+                Array<Float,3> gpt_flux_dn;
+                Array<Float,3> gpt_flux_dn_dir;
+                Array<Float,2> col_dry;
+                Array<Float,2> toa_src;
+                Array<Float,2> heating_rate;
+                Array<Float,3> bnd_heating_rate;
+            };
+
+            // Settings of the solve that determine the work arrays, the bin limits are empty without bin fluxes.
+            struct Settings
+            {
+                int n_lay = 0;
+                bool switch_fluxes = false;
+                bool switch_cloud_optics = false;
+                bool switch_aerosol_optics = false;
+                bool switch_output_bnd_fluxes = false;
+                bool switch_sw_direct_only = false;
+                bool switch_heating_rates = false;
+                bool switch_output_bin_fluxes = false;
+                Array<Float,2> bin_lims_wvn;
+
+                bool operator==(const Settings&) const;
+            };
+
+            // Blocks by number of columns, valid for the settings of the solve that made them.
+            std::map<int, Block> blocks;
+            Settings settings;
+        };
+
         Radiation_solver_shortwave(
                 const Gas_concs& gas_concs,
                 const bool switch_cloud_optics,
@@ -144,6 +242,10 @@ class Radiation_solver_shortwave
                 const bool switch_output_bnd_fluxes,
                 const bool switch_delta_cloud,
                 const bool switch_delta_aerosol,
+                const bool switch_combine_lazily,
+                const bool switch_sw_direct_only,
+                const bool switch_heating_rates,
+                const bool switch_output_bin_fluxes,
                 const Gas_concs& gas_concs,
                 const Array<Float,2>& p_lay, const Array<Float,2>& p_lev,
                 const Array<Float,2>& t_lay, const Array<Float,2>& t_lev,
@@ -154,12 +256,17 @@ class Radiation_solver_shortwave
                 const Array<Float,2>& rel, const Array<Float,2>& rei,
                 const Array<Float,2>& rh,
                 const Aerosol_concs& aerosol_concs,
+                const Array<Float,2>& bin_lims_wvn,
                 Array<Float,3>& tau, Array<Float,3>& ssa, Array<Float,3>& g,
                 Array<Float,2>& toa_src,
                 Array<Float,2>& sw_flux_up, Array<Float,2>& sw_flux_dn,
                 Array<Float,2>& sw_flux_dn_dir, Array<Float,2>& sw_flux_net,
                 Array<Float,3>& sw_bnd_flux_up, Array<Float,3>& sw_bnd_flux_dn,
-                Array<Float,3>& sw_bnd_flux_dn_dir, Array<Float,3>& sw_bnd_flux_net) const;
+                Array<Float,3>& sw_bnd_flux_dn_dir, Array<Float,3>& sw_bnd_flux_net,
+                Array<Float,2>& sw_heating_rate, Array<Float,3>& sw_bnd_heating_rate,
+                Array<Float,3>& sw_bin_flux_up, Array<Float,3>& sw_bin_flux_dn,
+                Array<Float,3>& sw_bin_flux_dn_dir, Array<Float,3>& sw_bin_flux_net,
+                Workspace* workspace=nullptr) const;
 
         int get_n_gpt() const { return this->kdist->get_ngpt(); };
         int get_n_bnd() const { return this->kdist->get_nband(); };
@@ -172,6 +279,10 @@ class Radiation_solver_shortwave
         Array<Float,2> get_band_lims_wavenumber() const
         { return this->kdist->get_band_lims_wavenumber(); }
 
+        // Number of columns of which the optical properties are computed at once.
+        void set_n_col_block(const int n_col_block);
+        int get_n_col_block() const { return this->n_col_block; }
+
         #ifdef __CUDACC__
         void solve_gpu(
                 const bool switch_fluxes,
@@ -211,6 +322,8 @@ class Radiation_solver_shortwave
         #endif
 
     private:
+        int n_col_block = 12;
+
         std::unique_ptr<Gas_optics> kdist;
         std::unique_ptr<Cloud_optics> cloud_optics;
         std::unique_ptr<Aerosol_optics> aerosol_optics;
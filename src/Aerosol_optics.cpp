@@ -3,6 +3,7 @@
 //
 #include <limits>
 #include "Aerosol_optics.h"
+#include "Timer.h"
 
 Aerosol_optics::Aerosol_optics(
         const Array<Float,2>& band_lims_wvn, const Array<Float,1>& rh_upper,
@@ -46,6 +47,8 @@ void compute_all_from_table(
         const Array<Float, 3>& mext_philic, const Array<Float, 3>& ssa_philic, const Array<Float, 3>& g_philic,
         Array<Float,3>& tau, Array<Float,3>& taussa, Array<Float,3>& taussag)
 {
+    Timer::Region region("compute_all_from_table");
+
     std::string list_aerosol_types[]{"SS1", "SS2", "SS3", "DU1", "DU2", "DU3", "OM1", "OM2", "BC1", "BC2", "SU"};
     for (int ibnd=1; ibnd<=nbnd; ++ibnd)
         for (int ilay=1; ilay<=nlay; ++ilay)
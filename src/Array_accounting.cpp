@@ -0,0 +1,267 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "Array_accounting.h"
+
+
+namespace
+{
+    using namespace Array_accounting;
+
+    // Tag 0 collects the allocations outside any tag.
+    struct Registry
+    {
+        std::mutex mutex;
+        std::map<std::string, int> ids;
+        std::vector<Tag_stats> tags;
+        Stats host;
+        Stats device;
+
+        Registry()
+        {
+            ids["other"] = 0;
+            tags.push_back(Tag_stats{"other", Stats(), Stats()});
+        }
+    };
+
+    // Never destroyed, as arrays with static storage duration may release after the end of main.
+    Registry& get_registry()
+    {
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+
+    std::vector<int>& get_tag_stack()
+    {
+        thread_local std::vector<int> tag_stack;
+        return tag_stack;
+    }
+
+    void add(Stats& stats, const long long bytes)
+    {
+        ++stats.n_alloc;
+        stats.allocated_bytes += bytes;
+        stats.live_bytes += bytes;
+        stats.peak_bytes = std::max(stats.peak_bytes, stats.live_bytes);
+    }
+
+    void remove(Stats& stats, const long long bytes)
+    {
+        ++stats.n_free;
+        stats.live_bytes -= bytes;
+    }
+
+    std::string format_bytes(const long long bytes)
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(2) << bytes / (1024.*1024.) << " MB";
+        return ss.str();
+    }
+}
+
+
+namespace Array_accounting
+{
+    int allocate(const Space space, const std::size_t bytes)
+    {
+        if (bytes == 0)
+            return -1;
+
+        const std::vector<int>& tag_stack = get_tag_stack();
+        const int tag = tag_stack.empty() ? 0 : tag_stack.back();
+
+        Registry& registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        Tag_stats& tag_stats = registry.tags[tag];
+        if (space == Space::Host)
+        {
+            add(registry.host, bytes);
+            add(tag_stats.host, bytes);
+        }
+        else
+        {
+            add(registry.device, bytes);
+            add(tag_stats.device, bytes);
+        }
+
+        return tag;
+    }
+
+    void release(const Space space, const std::size_t bytes, const int tag)
+    {
+        if (bytes == 0 || tag < 0)
+            return;
+
+        Registry& registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        Tag_stats& tag_stats = registry.tags[tag];
+        if (space == Space::Host)
+        {
+            remove(registry.host, bytes);
+            remove(tag_stats.host, bytes);
+        }
+        else
+        {
+            remove(registry.device, bytes);
+            remove(tag_stats.device, bytes);
+        }
+    }
+
+    Tag::Tag(const char* name)
+    {
+        Registry& registry = get_registry();
+        int tag;
+        {
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            auto it = registry.ids.find(name);
+            if (it == registry.ids.end())
+            {
+                tag = registry.tags.size();
+                registry.ids.emplace(name, tag);
+                registry.tags.push_back(Tag_stats{name, Stats(), Stats()});
+            }
+            else
+                tag = it->second;
+        }
+
+        get_tag_stack().push_back(tag);
+    }
+
+    Tag::~Tag()
+    {
+        get_tag_stack().pop_back();
+    }
+
+    Stats get_stats(const Space space)
+    {
+        Registry& registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        return (space == Space::Host) ? registry.host : registry.device;
+    }
+
+    std::vector<Tag_stats> get_tag_stats()
+    {
+        Registry& registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        return registry.tags;
+    }
+
+    void reset_peak()
+    {
+        Registry& registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.host.peak_bytes = registry.host.live_bytes;
+        registry.device.peak_bytes = registry.device.live_bytes;
+
+        for (Tag_stats& tag_stats : registry.tags)
+        {
+            tag_stats.host.peak_bytes = tag_stats.host.live_bytes;
+            tag_stats.device.peak_bytes = tag_stats.device.live_bytes;
+        }
+    }
+
+    void write_report(std::ostream& os)
+    {
+        if (!is_compiled())
+        {
+            os << "Array accounting is not compiled in, build with RTE_RRTMGP_ARRAY_ACCOUNTING" << std::endl;
+            return;
+        }
+
+        const Stats host = get_stats(Space::Host);
+        const Stats device = get_stats(Space::Device);
+        std::vector<Tag_stats> tags = get_tag_stats();
+
+        // Largest peaks first, unused tags are left out.
+        std::sort(tags.begin(), tags.end(), [](const Tag_stats& a, const Tag_stats& b)
+                { return a.host.peak_bytes + a.device.peak_bytes > b.host.peak_bytes + b.device.peak_bytes; });
+
+        os << "Array storage, host: peak " << format_bytes(host.peak_bytes)
+           << ", live " << format_bytes(host.live_bytes)
+           << ", " << host.n_alloc << " allocations" << std::endl;
+
+        if (device.n_alloc > 0)
+            os << "Array storage, device: peak " << format_bytes(device.peak_bytes)
+               << ", live " << format_bytes(device.live_bytes)
+               << ", " << device.n_alloc << " allocations" << std::endl;
+
+        os << std::left << std::setw(24) << "tag" << std::right
+           << std::setw(8) << "space"
+           << std::setw(12) << "allocs"
+           << std::setw(16) << "allocated"
+           << std::setw(16) << "peak"
+           << std::setw(16) << "live" << std::endl;
+
+        for (const Tag_stats& tag_stats : tags)
+            for (const Space space : {Space::Host, Space::Device})
+            {
+                const Stats& stats = (space == Space::Host) ? tag_stats.host : tag_stats.device;
+                if (stats.n_alloc == 0)
+                    continue;
+
+                os << std::left << std::setw(24) << tag_stats.name << std::right
+                   << std::setw(8) << (space == Space::Host ? "host" : "device")
+                   << std::setw(12) << stats.n_alloc
+                   << std::setw(16) << format_bytes(stats.allocated_bytes)
+                   << std::setw(16) << format_bytes(stats.peak_bytes)
+                   << std::setw(16) << format_bytes(stats.live_bytes) << std::endl;
+            }
+    }
+
+    void write_csv(const std::string& file_name)
+    {
+        std::ofstream csv(file_name);
+        if (!csv)
+            throw std::runtime_error("Cannot open " + file_name + " for writing");
+
+        csv << "tag,space,n_alloc,n_free,allocated_bytes,live_bytes,peak_bytes\n";
+
+        auto write_row = [&](const std::string& name, const char* space, const Stats& stats)
+        {
+            csv << name << "," << space << "," << stats.n_alloc << "," << stats.n_free << ","
+                << stats.allocated_bytes << "," << stats.live_bytes << "," << stats.peak_bytes << "\n";
+        };
+
+        write_row("total", "host", get_stats(Space::Host));
+        write_row("total", "device", get_stats(Space::Device));
+
+        for (const Tag_stats& tag_stats : get_tag_stats())
+        {
+            write_row(tag_stats.name, "host", tag_stats.host);
+            write_row(tag_stats.name, "device", tag_stats.device);
+        }
+    }
+}
@@ -23,7 +23,9 @@
  */
 
 #include <limits>
+#include <string>
 #include "Cloud_optics.h"
+#include "Timer.h"
 
 
 Cloud_optics::Cloud_optics(
@@ -48,34 +50,38 @@ Cloud_optics::Cloud_optics(
     this->radice_lwr = radice_lwr;
     this->radice_upr = radice_upr;
 
-    // Load LUT coefficients.
-    this->lut_extliq = lut_extliq;
-    this->lut_ssaliq = lut_ssaliq;
-    this->lut_asyliq = lut_asyliq;
-
-    // Choose the intermediately rough ice particle category (icergh = 2).
-    this->lut_extice.set_dims({lut_extice.dim(1), lut_extice.dim(2)});
-    this->lut_ssaice.set_dims({lut_ssaice.dim(1), lut_ssaice.dim(2)});
-    this->lut_asyice.set_dims({lut_asyice.dim(1), lut_asyice.dim(2)});
-
-    constexpr int icergh = 2;
-    for (int ibnd=1; ibnd<=lut_extice.dim(2); ++ibnd)
-        for (int isize=1; isize<=lut_extice.dim(1); ++isize)
-        {
-            this->lut_extice({isize, ibnd}) = lut_extice({isize, ibnd, icergh});
-            this->lut_ssaice({isize, ibnd}) = lut_ssaice({isize, ibnd, icergh});
-            this->lut_asyice({isize, ibnd}) = lut_asyice({isize, ibnd, icergh});
-        }
+    // Load LUT coefficients, liquid gets a single roughness slice to share the lookup with ice.
+    this->lut_extliq = Array<Float,3>(lut_extliq.v(), {lut_extliq.dim(1), lut_extliq.dim(2), 1});
+    this->lut_ssaliq = Array<Float,3>(lut_ssaliq.v(), {lut_ssaliq.dim(1), lut_ssaliq.dim(2), 1});
+    this->lut_asyliq = Array<Float,3>(lut_asyliq.v(), {lut_asyliq.dim(1), lut_asyliq.dim(2), 1});
+
+    // Keep all ice roughness categories, the slice is selected at run time.
+    this->lut_extice = lut_extice;
+    this->lut_ssaice = lut_ssaice;
+    this->lut_asyice = lut_asyice;
+}
+
+
+void Cloud_optics::check_ice_roughness(const Array<int,1>& ice_roughness, const int ncol) const
+{
+    if (ice_roughness.dim(1) != ncol)
+        throw std::runtime_error("Ice roughness field does not match the number of columns");
+
+    const int n_rgh = this->get_n_ice_roughness();
+    if (ice_roughness.min() < 1 || ice_roughness.max() > n_rgh)
+        throw std::runtime_error("Ice roughness category out of range 1 - " + std::to_string(n_rgh));
 }
 
 
 void compute_all_from_table(
         const int ncol, const int nlay, const int nbnd, const Array<Bool,2>& mask,
-        const Array<Float,2>& cwp, const Array<Float,2>& re,
+        const Array<Float,2>& cwp, const Array<Float,2>& re, const Array<int,1>& irgh,
         const int nsteps, const Float step_size, const Float offset,
-        const Array<Float,2>& tau_table, const Array<Float,2>& ssa_table, const Array<Float,2>& asy_table,
+        const Array<Float,3>& tau_table, const Array<Float,3>& ssa_table, const Array<Float,3>& asy_table,
         Array<Float,3>& tau, Array<Float,3>& taussa, Array<Float,3>& taussag)
 {
+    Timer::Region region("compute_all_from_table");
+
     for (int ibnd=1; ibnd<=nbnd; ++ibnd)
         for (int ilay=1; ilay<=nlay; ++ilay)
             for (int icol=1; icol<=ncol; ++icol)
@@ -85,13 +91,14 @@ void compute_all_from_table(
                     const int index = std::min(
                             static_cast<int>((re({icol, ilay}) - offset) / step_size)+1, nsteps-1);
                     const Float fint = (re({icol, ilay}) - offset) / step_size - (index-1);
+                    const int ir = irgh({icol});
 
                     const Float tau_local = cwp({icol, ilay}) *
-                        (tau_table({index, ibnd}) + fint * (tau_table({index+1, ibnd}) - tau_table({index, ibnd})));
+                        (tau_table({index, ibnd, ir}) + fint * (tau_table({index+1, ibnd, ir}) - tau_table({index, ibnd, ir})));
                     const Float taussa_local = tau_local *
-                        (ssa_table({index, ibnd}) + fint * (ssa_table({index+1, ibnd}) - ssa_table({index, ibnd})));
+                        (ssa_table({index, ibnd, ir}) + fint * (ssa_table({index+1, ibnd, ir}) - ssa_table({index, ibnd, ir})));
                     const Float taussag_local = taussa_local *
-                        (asy_table({index, ibnd}) + fint * (asy_table({index+1, ibnd}) - asy_table({index, ibnd})));
+                        (asy_table({index, ibnd, ir}) + fint * (asy_table({index+1, ibnd, ir}) - asy_table({index, ibnd, ir})));
 
                     tau    ({icol, ilay, ibnd}) = tau_local;
                     taussa ({icol, ilay, ibnd}) = taussa_local;
@@ -111,12 +118,32 @@ void compute_all_from_table(
 void Cloud_optics::cloud_optics(
         const Array<Float,2>& clwp, const Array<Float,2>& ciwp,
         const Array<Float,2>& reliq, const Array<Float,2>& reice,
-        Optical_props_2str& optical_props)
+        Optical_props_2str& optical_props,
+        const int ice_roughness)
+{
+    Array<int,1> ice_roughness_col({clwp.dim(1)});
+    ice_roughness_col.fill(ice_roughness);
+
+    cloud_optics(clwp, ciwp, reliq, reice, optical_props, ice_roughness_col);
+}
+
+
+void Cloud_optics::cloud_optics(
+        const Array<Float,2>& clwp, const Array<Float,2>& ciwp,
+        const Array<Float,2>& reliq, const Array<Float,2>& reice,
+        Optical_props_2str& optical_props,
+        const Array<int,1>& ice_roughness)
 {
     const int ncol = clwp.dim(1);
     const int nlay = clwp.dim(2);
     const int nbnd = this->get_nband();
 
+    check_ice_roughness(ice_roughness, ncol);
+
+    // Liquid has a single roughness slice.
+    Array<int,1> liq_roughness({ncol});
+    liq_roughness.fill(1);
+
     Optical_props_2str clouds_liq(ncol, nlay, optical_props);
     Optical_props_2str clouds_ice(ncol, nlay, optical_props);
 
@@ -141,14 +168,14 @@ void Cloud_optics::cloud_optics(
 
     // Liquid water.
     compute_all_from_table(
-            ncol, nlay, nbnd, liqmsk, clwp, reliq,
+            ncol, nlay, nbnd, liqmsk, clwp, reliq, liq_roughness,
             this->liq_nsteps, this->liq_step_size, this->radliq_lwr,
             this->lut_extliq, this->lut_ssaliq, this->lut_asyliq,
             ltau, ltaussa, ltaussag);
 
     // Ice.
     compute_all_from_table(
-            ncol, nlay, nbnd, icemsk, ciwp, reice,
+            ncol, nlay, nbnd, icemsk, ciwp, reice, ice_roughness,
             this->ice_nsteps, this->ice_step_size, this->radice_lwr,
             this->lut_extice, this->lut_ssaice, this->lut_asyice,
             itau, itaussa, itaussag);
@@ -176,12 +203,32 @@ void Cloud_optics::cloud_optics(
 void Cloud_optics::cloud_optics(
         const Array<Float,2>& clwp, const Array<Float,2>& ciwp,
         const Array<Float,2>& reliq, const Array<Float,2>& reice,
-        Optical_props_1scl& optical_props)
+        Optical_props_1scl& optical_props,
+        const int ice_roughness)
+{
+    Array<int,1> ice_roughness_col({clwp.dim(1)});
+    ice_roughness_col.fill(ice_roughness);
+
+    cloud_optics(clwp, ciwp, reliq, reice, optical_props, ice_roughness_col);
+}
+
+
+void Cloud_optics::cloud_optics(
+        const Array<Float,2>& clwp, const Array<Float,2>& ciwp,
+        const Array<Float,2>& reliq, const Array<Float,2>& reice,
+        Optical_props_1scl& optical_props,
+        const Array<int,1>& ice_roughness)
 {
     const int ncol = clwp.dim(1);
     const int nlay = clwp.dim(2);
     const int nbnd = this->get_nband();
 
+    check_ice_roughness(ice_roughness, ncol);
+
+    // Liquid has a single roughness slice.
+    Array<int,1> liq_roughness({ncol});
+    liq_roughness.fill(1);
+
     Optical_props_1scl clouds_liq(ncol, nlay, optical_props);
     Optical_props_1scl clouds_ice(ncol, nlay, optical_props);
 
@@ -206,14 +253,14 @@ void Cloud_optics::cloud_optics(
 
     // Liquid water.
     compute_all_from_table(
-            ncol, nlay, nbnd, liqmsk, clwp, reliq,
+            ncol, nlay, nbnd, liqmsk, clwp, reliq, liq_roughness,
             this->liq_nsteps, this->liq_step_size, this->radliq_lwr,
             this->lut_extliq, this->lut_ssaliq, this->lut_asyliq,
             ltau, ltaussa, ltaussag);
 
     // Ice.
     compute_all_from_table(
-            ncol, nlay, nbnd, icemsk, ciwp, reice,
+            ncol, nlay, nbnd, icemsk, ciwp, reice, ice_roughness,
             this->ice_nsteps, this->ice_step_size, this->radice_lwr,
             this->lut_extice, this->lut_ssaice, this->lut_asyice,
             itau, itaussa, itaussag);
@@ -22,6 +22,8 @@
  *
  */
 
+#include <algorithm>
+
 #include "Fluxes.h"
 #include "Array.h"
 #include "Optical_props.h"
@@ -54,32 +56,218 @@ namespace rrtmgp_kernel_launcher
                 const_cast<Float*>(broadband_flux_up.ptr()),
                 broadband_flux_net.ptr());
     }
+}
 
-    template<typename Float>
-    void sum_byband(
-            int ncol, int nlev, int ngpt, int nbnd,
+
+namespace
+{
+    // Band and broadband sums of the g-point fluxes and the net fluxes in a single pass, in which
+    // each g-point flux is read once. The band sums are blocked over the columns and levels, such
+    // that the sums of a block stay in cache while the g-points of the band are streamed.
+    template<bool do_dir>
+    void reduce_byband_fused(
             const Array<int,2>& band_lims,
-            const Array<Float,3>& spectral_flux,
-            Array<Float,3>& byband_flux)
+            const Array<Float,3>& gpt_flux_up, const Array<Float,3>& gpt_flux_dn, const Array<Float,3>& gpt_flux_dn_dir,
+            Array<Float,3>& bnd_flux_up, Array<Float,3>& bnd_flux_dn, Array<Float,3>& bnd_flux_dn_dir, Array<Float,3>& bnd_flux_net,
+            Array<Float,2>& flux_up, Array<Float,2>& flux_dn, Array<Float,2>& flux_dn_dir, Array<Float,2>& flux_net)
     {
-        rrtmgp_kernels::sum_byband(
-                &ncol, &nlev, &ngpt, &nbnd,
-                const_cast<int*>(band_lims.ptr()),
-                const_cast<Float*>(spectral_flux.ptr()),
-                byband_flux.ptr());
+        const int n = gpt_flux_up.dim(1) * gpt_flux_up.dim(2);
+        const int nbnd = band_lims.dim(2);
+        constexpr int block_size = 512;
+
+        for (int ibnd=1; ibnd<=nbnd; ++ibnd)
+        {
+            Float* __restrict__ bnd_up  = bnd_flux_up.ptr() + (ibnd-1)*n;
+            Float* __restrict__ bnd_dn  = bnd_flux_dn.ptr() + (ibnd-1)*n;
+            Float* __restrict__ bnd_dir = do_dir ? bnd_flux_dn_dir.ptr() + (ibnd-1)*n : nullptr;
+            Float* __restrict__ bnd_net = bnd_flux_net.ptr() + (ibnd-1)*n;
+
+            for (int i_s=0; i_s<n; i_s+=block_size)
+            {
+                const int i_e = std::min(i_s+block_size, n);
+
+                for (int i=i_s; i<i_e; ++i)
+                {
+                    bnd_up[i] = Float(0.);
+                    bnd_dn[i] = Float(0.);
+                    if (do_dir)
+                        bnd_dir[i] = Float(0.);
+                }
+
+                for (int igpt=band_lims({1, ibnd}); igpt<=band_lims({2, ibnd}); ++igpt)
+                {
+                    const Float* __restrict__ gpt_up  = gpt_flux_up.ptr() + (igpt-1)*n;
+                    const Float* __restrict__ gpt_dn  = gpt_flux_dn.ptr() + (igpt-1)*n;
+                    const Float* __restrict__ gpt_dir = do_dir ? gpt_flux_dn_dir.ptr() + (igpt-1)*n : nullptr;
+
+                    // Separate loops keep the number of concurrent memory streams low.
+                    for (int i=i_s; i<i_e; ++i)
+                        bnd_up[i] += gpt_up[i];
+                    for (int i=i_s; i<i_e; ++i)
+                        bnd_dn[i] += gpt_dn[i];
+                    if (do_dir)
+                        for (int i=i_s; i<i_e; ++i)
+                            bnd_dir[i] += gpt_dir[i];
+                }
+
+                for (int i=i_s; i<i_e; ++i)
+                    bnd_net[i] = bnd_dn[i] - bnd_up[i];
+            }
+        }
+
+        // The broadband fluxes are the sums over the bands, which are much smaller than the g-point fluxes.
+        Float* __restrict__ up  = flux_up.ptr();
+        Float* __restrict__ dn  = flux_dn.ptr();
+        Float* __restrict__ dir = flux_dn_dir.ptr();
+        Float* __restrict__ net = flux_net.ptr();
+
+        for (int i=0; i<n; ++i)
+        {
+            up[i] = Float(0.);
+            dn[i] = Float(0.);
+            if (do_dir)
+                dir[i] = Float(0.);
+        }
+
+        for (int ibnd=1; ibnd<=nbnd; ++ibnd)
+        {
+            const Float* __restrict__ bnd_up  = bnd_flux_up.ptr() + (ibnd-1)*n;
+            const Float* __restrict__ bnd_dn  = bnd_flux_dn.ptr() + (ibnd-1)*n;
+            const Float* __restrict__ bnd_dir = do_dir ? bnd_flux_dn_dir.ptr() + (ibnd-1)*n : nullptr;
+
+            for (int i=0; i<n; ++i)
+            {
+                up[i] += bnd_up[i];
+                dn[i] += bnd_dn[i];
+                if (do_dir)
+                    dir[i] += bnd_dir[i];
+            }
+        }
+
+        for (int i=0; i<n; ++i)
+            net[i] = dn[i] - up[i];
     }
 
-    template<typename Float>
-    void net_byband(
-            int ncol, int nlev, int nband,
-            const Array<Float,3>& byband_flux_dn, const Array<Float,3>& byband_flux_up,
-            Array<Float,3>& byband_flux_net)
+
+    // Broadband fluxes and fluxes in spectral bins in a single pass over the g-point fluxes, blocked
+    // over the columns and levels. The weights of a g-point are stored in compressed rows.
+    template<bool do_dir>
+    void reduce_bins_fused(
+            const std::vector<int>& gpt_offsets, const std::vector<int>& bin_index, const std::vector<Float>& bin_weight,
+            const Array<Float,3>& gpt_flux_up, const Array<Float,3>& gpt_flux_dn, const Array<Float,3>& gpt_flux_dn_dir,
+            Array<Float,3>& bin_flux_up, Array<Float,3>& bin_flux_dn, Array<Float,3>& bin_flux_dn_dir, Array<Float,3>& bin_flux_net,
+            Array<Float,2>& flux_up, Array<Float,2>& flux_dn, Array<Float,2>& flux_dn_dir, Array<Float,2>& flux_net)
     {
-        rrtmgp_kernels::net_byband_precalc(
-                &ncol, &nlev, &nband,
-                const_cast<Float*>(byband_flux_dn.ptr()),
-                const_cast<Float*>(byband_flux_up.ptr()),
-                byband_flux_net.ptr());
+        const int n = gpt_flux_up.dim(1) * gpt_flux_up.dim(2);
+        const int ngpt = gpt_flux_up.dim(3);
+        const int nbin = bin_flux_up.dim(3);
+        constexpr int block_size = 512;
+
+        if (ngpt != int(gpt_offsets.size())-1)
+            throw std::runtime_error("Number of g-points does not match the bin weights");
+
+        // Accumulate a weighted g-point flux into the block of a flux.
+        auto add = [](Float* __restrict__ sum, const Float* __restrict__ gpt, const Float w, const int i_s, const int i_e)
+        {
+            for (int i=i_s; i<i_e; ++i)
+                sum[i] += w*gpt[i];
+        };
+
+        Float* __restrict__ up  = flux_up.ptr();
+        Float* __restrict__ dn  = flux_dn.ptr();
+        Float* __restrict__ dir = flux_dn_dir.ptr();
+        Float* __restrict__ net = flux_net.ptr();
+
+        for (int i_s=0; i_s<n; i_s+=block_size)
+        {
+            const int i_e = std::min(i_s+block_size, n);
+
+            for (int i=i_s; i<i_e; ++i)
+            {
+                up[i] = Float(0.);
+                dn[i] = Float(0.);
+                if (do_dir)
+                    dir[i] = Float(0.);
+            }
+
+            for (int ibin=0; ibin<nbin; ++ibin)
+                for (int i=i_s; i<i_e; ++i)
+                {
+                    bin_flux_up.ptr()[ibin*n + i] = Float(0.);
+                    bin_flux_dn.ptr()[ibin*n + i] = Float(0.);
+                    if (do_dir)
+                        bin_flux_dn_dir.ptr()[ibin*n + i] = Float(0.);
+                }
+
+            for (int igpt=0; igpt<ngpt; ++igpt)
+            {
+                const Float* gpt_up  = gpt_flux_up.ptr() + igpt*n;
+                const Float* gpt_dn  = gpt_flux_dn.ptr() + igpt*n;
+                const Float* gpt_dir = do_dir ? gpt_flux_dn_dir.ptr() + igpt*n : nullptr;
+
+                // The block of the g-point flux is read from memory once, and from cache for the bins.
+                add(up, gpt_up, Float(1.), i_s, i_e);
+                for (int ie=gpt_offsets[igpt]; ie<gpt_offsets[igpt+1]; ++ie)
+                    add(bin_flux_up.ptr() + bin_index[ie]*n, gpt_up, bin_weight[ie], i_s, i_e);
+
+                add(dn, gpt_dn, Float(1.), i_s, i_e);
+                for (int ie=gpt_offsets[igpt]; ie<gpt_offsets[igpt+1]; ++ie)
+                    add(bin_flux_dn.ptr() + bin_index[ie]*n, gpt_dn, bin_weight[ie], i_s, i_e);
+
+                if (do_dir)
+                {
+                    add(dir, gpt_dir, Float(1.), i_s, i_e);
+                    for (int ie=gpt_offsets[igpt]; ie<gpt_offsets[igpt+1]; ++ie)
+                        add(bin_flux_dn_dir.ptr() + bin_index[ie]*n, gpt_dir, bin_weight[ie], i_s, i_e);
+                }
+            }
+
+            for (int i=i_s; i<i_e; ++i)
+                net[i] = dn[i] - up[i];
+
+            for (int ibin=0; ibin<nbin; ++ibin)
+                for (int i=i_s; i<i_e; ++i)
+                    bin_flux_net.ptr()[ibin*n + i] = bin_flux_dn.ptr()[ibin*n + i] - bin_flux_up.ptr()[ibin*n + i];
+        }
+    }
+
+    // Constants for the heating rates.
+    constexpr Float grav = Float(9.80665);
+    constexpr Float cp_d = Float(1004.64);
+
+    // The heating rate follows from the convergence of the net downward flux over the
+    // pressure thickness of the layer, which is independent of the vertical orientation.
+    void heating_rate_kernel(
+            const int ncol, const int nlay,
+            const Float* __restrict__ flux_net, const int net_stride,
+            const Float* __restrict__ p_lev, const int p_stride,
+            Float* __restrict__ heating_rate, const int hr_stride)
+    {
+        constexpr Float fac = -grav / cp_d;
+
+        for (int ilay=0; ilay<nlay; ++ilay)
+        {
+            const Float* __restrict__ net_1 = flux_net + ilay*net_stride;
+            const Float* __restrict__ net_2 = net_1 + net_stride;
+            const Float* __restrict__ p_1 = p_lev + ilay*p_stride;
+            const Float* __restrict__ p_2 = p_1 + p_stride;
+            Float* __restrict__ hr = heating_rate + ilay*hr_stride;
+
+            for (int icol=0; icol<ncol; ++icol)
+                hr[icol] = fac * (net_2[icol] - net_1[icol]) / (p_2[icol] - p_1[icol]);
+        }
+    }
+
+    template<int N>
+    void check_heating_rate_dims(
+            const Array<Float,N>& flux_net, const Array<Float,2>& p_lev, const Array<Float,N>& heating_rate)
+    {
+        if (p_lev.dim(1) != flux_net.dim(1) || p_lev.dim(2) != flux_net.dim(2)
+                || heating_rate.dim(1) != flux_net.dim(1) || heating_rate.dim(2) != flux_net.dim(2)-1)
+            throw std::runtime_error("Heating rate dimensions do not match the fluxes");
+
+        if (flux_net.get_strides()[0] != 1 || p_lev.get_strides()[0] != 1 || heating_rate.get_strides()[0] != 1)
+            throw std::runtime_error("Heating rates require contiguous columns");
     }
 }
 
@@ -145,53 +333,154 @@ void Fluxes_byband::reduce(
     const std::unique_ptr<Optical_props_arry>& spectral_disc,
     const Bool top_at_1)
 {
-    const int ncol = gpt_flux_up.dim(1);
-    const int nlev = gpt_flux_up.dim(2);
-    const int ngpt = spectral_disc->get_ngpt();
-    const int nbnd = spectral_disc->get_nband();
+    reduce_byband_fused<false>(
+            spectral_disc->get_band_lims_gpoint(),
+            gpt_flux_up, gpt_flux_dn, gpt_flux_dn,
+            this->bnd_flux_up, this->bnd_flux_dn, this->bnd_flux_dn_dir, this->bnd_flux_net,
+            get_flux_up(), get_flux_dn(), get_flux_dn_dir(), get_flux_net());
+}
 
-    const Array<int,2>& band_lims = spectral_disc->get_band_lims_gpoint();
 
-    Fluxes_broadband::reduce(
-            gpt_flux_up, gpt_flux_dn,
-            spectral_disc, top_at_1);
+void Fluxes_byband::reduce(
+    const Array<Float,3>& gpt_flux_up,
+    const Array<Float,3>& gpt_flux_dn,
+    const Array<Float,3>& gpt_flux_dn_dir,
+    const std::unique_ptr<Optical_props_arry>& spectral_disc,
+    const Bool top_at_1)
+{
+    reduce_byband_fused<true>(
+            spectral_disc->get_band_lims_gpoint(),
+            gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir,
+            this->bnd_flux_up, this->bnd_flux_dn, this->bnd_flux_dn_dir, this->bnd_flux_net,
+            get_flux_up(), get_flux_dn(), get_flux_dn_dir(), get_flux_net());
+}
 
-    rrtmgp_kernel_launcher::sum_byband(
-            ncol, nlev, ngpt, nbnd, band_lims,
-            gpt_flux_up, this->bnd_flux_up);
 
-    rrtmgp_kernel_launcher::sum_byband(
-            ncol, nlev, ngpt, nbnd, band_lims,
-            gpt_flux_dn, this->bnd_flux_dn);
+void Fluxes_broadband::heating_rate(
+    const Array<Float,2>& flux_net, const Array<Float,2>& p_lev,
+    Array<Float,2>& heating_rate)
+{
+    check_heating_rate_dims(flux_net, p_lev, heating_rate);
 
-    rrtmgp_kernel_launcher::net_byband(
-            ncol, nlev, nbnd,
-            this->bnd_flux_dn, this->bnd_flux_up, this->bnd_flux_net);
+    heating_rate_kernel(
+            flux_net.dim(1), heating_rate.dim(2),
+            flux_net.ptr(), flux_net.get_strides()[1],
+            p_lev.ptr(), p_lev.get_strides()[1],
+            heating_rate.ptr(), heating_rate.get_strides()[1]);
 }
 
 
-// CvH: a lot of code duplication.
-void Fluxes_byband::reduce(
+void Fluxes_broadband::heating_rate(
+    const Array<Float,3>& bnd_flux_net, const Array<Float,2>& p_lev,
+    Array<Float,3>& bnd_heating_rate)
+{
+    check_heating_rate_dims(bnd_flux_net, p_lev, bnd_heating_rate);
+
+    if (bnd_heating_rate.dim(3) != bnd_flux_net.dim(3))
+        throw std::runtime_error("Heating rate dimensions do not match the fluxes");
+
+    for (int ibnd=0; ibnd<bnd_flux_net.dim(3); ++ibnd)
+        heating_rate_kernel(
+                bnd_flux_net.dim(1), bnd_heating_rate.dim(2),
+                bnd_flux_net.ptr() + ibnd*bnd_flux_net.get_strides()[2], bnd_flux_net.get_strides()[1],
+                p_lev.ptr(), p_lev.get_strides()[1],
+                bnd_heating_rate.ptr() + ibnd*bnd_heating_rate.get_strides()[2], bnd_heating_rate.get_strides()[1]);
+}
+
+
+Fluxes_custom_bins::Fluxes_custom_bins(const int ncol, const int nlev, const Array<Float,2>& gpt_bin_weights) :
+    Fluxes_broadband(ncol, nlev),
+    bin_flux_up    ({ncol, nlev, gpt_bin_weights.dim(2)}),
+    bin_flux_dn    ({ncol, nlev, gpt_bin_weights.dim(2)}),
+    bin_flux_dn_dir({ncol, nlev, gpt_bin_weights.dim(2)}),
+    bin_flux_net   ({ncol, nlev, gpt_bin_weights.dim(2)})
+{
+    const int ngpt = gpt_bin_weights.dim(1);
+    const int nbin = gpt_bin_weights.dim(2);
+
+    gpt_offsets.push_back(0);
+    for (int igpt=1; igpt<=ngpt; ++igpt)
+    {
+        for (int ibin=1; ibin<=nbin; ++ibin)
+        {
+            const Float w = gpt_bin_weights({igpt, ibin});
+            if (w != Float(0.))
+            {
+                bin_index.push_back(ibin-1);
+                bin_weight.push_back(w);
+            }
+        }
+        gpt_offsets.push_back(bin_index.size());
+    }
+}
+
+
+void Fluxes_custom_bins::reduce(
     const Array<Float,3>& gpt_flux_up,
     const Array<Float,3>& gpt_flux_dn,
-    const Array<Float,3>& gpt_flux_dn_dir,
     const std::unique_ptr<Optical_props_arry>& spectral_disc,
     const Bool top_at_1)
 {
-    const int ncol = gpt_flux_up.dim(1);
-    const int nlev = gpt_flux_up.dim(2);
-    const int ngpt = spectral_disc->get_ngpt();
-    const int nbnd = spectral_disc->get_nband();
+    reduce_bins_fused<false>(
+            gpt_offsets, bin_index, bin_weight,
+            gpt_flux_up, gpt_flux_dn, gpt_flux_dn,
+            this->bin_flux_up, this->bin_flux_dn, this->bin_flux_dn_dir, this->bin_flux_net,
+            get_flux_up(), get_flux_dn(), get_flux_dn_dir(), get_flux_net());
+}
 
-    const Array<int,2>& band_lims = spectral_disc->get_band_lims_gpoint();
 
-    Fluxes_broadband::reduce(
+void Fluxes_custom_bins::reduce(
+    const Array<Float,3>& gpt_flux_up,
+    const Array<Float,3>& gpt_flux_dn,
+    const Array<Float,3>& gpt_flux_dn_dir,
+    const std::unique_ptr<Optical_props_arry>& spectral_disc,
+    const Bool top_at_1)
+{
+    reduce_bins_fused<true>(
+            gpt_offsets, bin_index, bin_weight,
             gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir,
-            spectral_disc, top_at_1);
+            this->bin_flux_up, this->bin_flux_dn, this->bin_flux_dn_dir, this->bin_flux_net,
+            get_flux_up(), get_flux_dn(), get_flux_dn_dir(), get_flux_net());
+}
 
-    reduce(gpt_flux_up, gpt_flux_dn, spectral_disc, top_at_1);
 
-    rrtmgp_kernel_launcher::sum_byband(
-            ncol, nlev, ngpt, nbnd, band_lims,
-            gpt_flux_dn_dir, this->bnd_flux_dn_dir);
+Array<Float,2> Fluxes_custom_bins::bin_weights(
+    const Array<Float,2>& band_lims_wvn, const Array<int,2>& band_lims_gpt,
+    const Array<Float,2>& bin_lims_wvn)
+{
+    const int nbnd = band_lims_gpt.dim(2);
+    const int ngpt = band_lims_gpt({2, nbnd});
+    const int nbin = bin_lims_wvn.dim(2);
+
+    if (bin_lims_wvn.dim(1) != 2)
+        throw std::runtime_error("Bin limits should have dimensions (2, nbin)");
+
+    Array<Float,2> weights({ngpt, nbin});
+    weights.fill(Float(0.));
+
+    for (int ibin=1; ibin<=nbin; ++ibin)
+    {
+        const Float bin_lo = bin_lims_wvn({1, ibin});
+        const Float bin_hi = bin_lims_wvn({2, ibin});
+
+        if (!(bin_hi > bin_lo))
+            throw std::runtime_error("Upper bin limit should exceed the lower limit");
+
+        for (int ibnd=1; ibnd<=nbnd; ++ibnd)
+        {
+            const Float bnd_lo = band_lims_wvn({1, ibnd});
+            const Float bnd_hi = band_lims_wvn({2, ibnd});
+
+            const Float overlap = std::min(bin_hi, bnd_hi) - std::max(bin_lo, bnd_lo);
+            if (overlap <= Float(0.))
+                continue;
+
+            // The g-points span the full band, so each gets the overlapping fraction of the band.
+            const Float frac = overlap / (bnd_hi - bnd_lo);
+            for (int igpt=band_lims_gpt({1, ibnd}); igpt<=band_lims_gpt({2, ibnd}); ++igpt)
+                weights({igpt, ibin}) = frac;
+        }
+    }
+
+    return weights;
 }
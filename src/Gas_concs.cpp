@@ -42,6 +42,27 @@ Gas_concs::Gas_concs(const Gas_concs& gas_concs_ref, const int start, const int
 }
 
 
+// Gather the columns in cols (1-based) into a dense set.
+Gas_concs::Gas_concs(const Gas_concs& gas_concs_ref, const std::vector<int>& cols)
+{
+    const int n_col = cols.size();
+    for (auto& g : gas_concs_ref.gas_concs_map)
+    {
+        if (g.second.dim(1) == 1)
+            this->gas_concs_map.emplace(g.first, g.second);
+        else
+        {
+            const int n_lay = g.second.dim(2);
+            Array<Float,2> gas_conc_subset({n_col, n_lay});
+            for (int ilay=1; ilay<=n_lay; ++ilay)
+                for (int icol=1; icol<=n_col; ++icol)
+                    gas_conc_subset({icol, ilay}) = g.second({cols[icol-1], ilay});
+            this->gas_concs_map.emplace(g.first, std::move(gas_conc_subset));
+        }
+    }
+}
+
+
 Gas_concs::~Gas_concs()
 {
 }
@@ -103,6 +124,23 @@ void Gas_concs::set_vmr(const std::string& name, const Array<Float,2>& data_2d)
 }
 
 
+// Insert new gas into the map or update the value, taking over the storage of the data.
+void Gas_concs::set_vmr(const std::string& name, Array<Float,2>&& data_2d)
+{
+    // Check the data.
+    if (any_vals_outside(data_2d, Float(0.), Float(1.)))
+    {
+        std::string error("Gas concentration " + name + " is out of range");
+        throw std::range_error(error);
+    }
+
+    if (this->exists(name))
+        gas_concs_map.at(name) = std::move(data_2d);
+    else
+        gas_concs_map.emplace(name, std::move(data_2d));
+}
+
+
 // Get gas from map.
 const Array<Float,2>& Gas_concs::get_vmr(const std::string& name) const
 {
@@ -110,6 +148,15 @@ const Array<Float,2>& Gas_concs::get_vmr(const std::string& name) const
 }
 
 
+// Remove gas from map and return it.
+Array<Float,2> Gas_concs::take_vmr(const std::string& name)
+{
+    Array<Float,2> data_2d(std::move(gas_concs_map.at(name)));
+    gas_concs_map.erase(name);
+    return data_2d;
+}
+
+
 // Check if gas exists in map.
 Bool Gas_concs::exists(const std::string& name) const
 {
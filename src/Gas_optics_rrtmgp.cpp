@@ -33,6 +33,7 @@
 #include "Array.h"
 #include "Optical_props.h"
 #include "Source_functions.h"
+#include "Timer.h"
 
 #include "rrtmgp_kernels.h"
 
@@ -934,6 +935,8 @@ namespace rrtmgp_kernel_launcher
             Array<int,4>& jeta,
             Array<int,2>& jpress)
     {
+        Timer::Region region("interpolation");
+
         rrtmgp_kernels::rrtmgp_interpolation(
                 &ncol, &nlay,
                 &ngas, &nflav, &neta, &npres, &ntemp,
@@ -987,6 +990,8 @@ namespace rrtmgp_kernel_launcher
             const Array<int,4>& jeta, const Array<int,2>& jtemp,
             const Array<int,2>& jpress, Array<Float,3>& tau)
     {
+        Timer::Region region("absorption");
+
         rrtmgp_kernels::rrtmgp_compute_tau_absorption(
             &ncol, &nlay, &nband, &ngpt,
             &ngas, &nflav, &neta, &npres, &ntemp,
@@ -1029,6 +1034,8 @@ namespace rrtmgp_kernel_launcher
             const Array<Bool,2>& tropo, const Array<int,2>& jtemp,
             Array<Float,3>& tau_rayleigh)
     {
+        Timer::Region region("rayleigh");
+
         rrtmgp_kernels::rrtmgp_compute_tau_rayleigh(
                 &ncol, &nlay, &nband, &ngpt,
                 &ngas, &nflav, &neta, &npres, &ntemp,
@@ -1067,6 +1074,8 @@ namespace rrtmgp_kernel_launcher
             Array<Float,2>& sfc_src, Array<Float,3>& lay_src, Array<Float,3>& lev_src_inc, Array<Float,3>& lev_src_dec,
             Array<Float,2>& sfc_src_jac)
     {
+        Timer::Region region("planck");
+
         rrtmgp_kernels::rrtmgp_compute_Planck_source(
                 &ncol, &nlay, &nbnd, &ngpt,
                 &nflav, &neta, &npres, &ntemp, &nPlanckTemp,
@@ -1241,7 +1250,16 @@ void Gas_optics_rrtmgp::compute_gas_taus(
     }
     else
     {
-        rrtmgp_kernel_launcher::zero_array(ncol, nlay, ngpt, optical_props->get_tau());
+        // The kernels write contiguous data, strided layouts receive a copy afterwards.
+        const bool tau_is_contiguous = optical_props->get_tau().is_contiguous();
+
+        Array<Float,3> tau_buffer;
+        if (!tau_is_contiguous)
+            tau_buffer.set_dims({ncol, nlay, ngpt});
+
+        Array<Float,3>& tau = tau_is_contiguous ? optical_props->get_tau() : tau_buffer;
+
+        rrtmgp_kernel_launcher::zero_array(ncol, nlay, ngpt, tau);
 
         rrtmgp_kernel_launcher::compute_tau_absorption(
                 ncol, nlay, nband, ngpt,
@@ -1270,7 +1288,39 @@ void Gas_optics_rrtmgp::compute_gas_taus(
                 col_mix, fmajor, fminor,
                 play, tlay, col_gas,
                 jeta, jtemp, jpress,
-                optical_props->get_tau());
+                tau);
+
+        // Without Rayleigh scattering the gases only absorb, also for two-stream optical properties.
+        Optical_props_2str* optical_props_2str = dynamic_cast<Optical_props_2str*>(optical_props.get());
+
+        if (tau_is_contiguous)
+        {
+            if (optical_props_2str)
+            {
+                optical_props_2str->get_ssa().fill(Float(0.));
+                optical_props_2str->get_g  ().fill(Float(0.));
+            }
+        }
+        else
+        {
+            // Strided layouts get the absorption and the zero ssa and g in a single pass over the column rows.
+            Array<Float,3>& tau_out = optical_props->get_tau();
+
+            for (int igpt=1; igpt<=ngpt; ++igpt)
+                for (int ilay=1; ilay<=nlay; ++ilay)
+                {
+                    const Float* tau_in = &tau_buffer({1, ilay, igpt});
+                    std::copy(tau_in, tau_in + ncol, &tau_out({1, ilay, igpt}));
+
+                    if (optical_props_2str)
+                    {
+                        Float* ssa_out = &optical_props_2str->get_ssa()({1, ilay, igpt});
+                        Float* g_out   = &optical_props_2str->get_g  ()({1, ilay, igpt});
+                        std::fill(ssa_out, ssa_out + ncol, Float(0.));
+                        std::fill(g_out  , g_out   + ncol, Float(0.));
+                    }
+                }
+        }
     }
 }
 
@@ -1280,10 +1330,23 @@ void Gas_optics_rrtmgp::combine_abs_and_rayleigh(
         const Array<Float,3>& tau_rayleigh,
         std::unique_ptr<Optical_props_arry>& optical_props) const
 {
+    Timer::Region region("combine_rayleigh");
+
     int ncol = tau.dim(1);
     int nlay = tau.dim(2);
     int ngpt = tau.dim(3);
 
+    // Absorption-only optical properties, as used for the direct beam, get the extinction only.
+    if (dynamic_cast<Optical_props_1scl*>(optical_props.get()))
+    {
+        Array<Float,3>& tau_out = optical_props->get_tau();
+        for (int igpt=1; igpt<=ngpt; ++igpt)
+            for (int ilay=1; ilay<=nlay; ++ilay)
+                for (int icol=1; icol<=ncol; ++icol)
+                    tau_out({icol, ilay, igpt}) = tau({icol, ilay, igpt}) + tau_rayleigh({icol, ilay, igpt});
+        return;
+    }
+
     /*
     for (int igpt=1; igpt<=ngpt; ++igpt)
         for (int ilay=1; ilay<=nlay; ++ilay)
@@ -1300,12 +1363,41 @@ void Gas_optics_rrtmgp::combine_abs_and_rayleigh(
             }
             */
 
-    combine_abs_and_rayleigh_kernel(
-            ncol, nlay, ngpt,
-            tau.ptr(), tau_rayleigh.ptr(),
-            optical_props->get_tau().ptr(), optical_props->get_ssa().ptr());
+    if (optical_props->get_tau().is_contiguous() && optical_props->get_ssa().is_contiguous())
+    {
+        combine_abs_and_rayleigh_kernel(
+                ncol, nlay, ngpt,
+                tau.ptr(), tau_rayleigh.ptr(),
+                optical_props->get_tau().ptr(), optical_props->get_ssa().ptr());
+    }
+    else
+    {
+        // Strided layouts, such as interleaved optical properties, are written per column row.
+        Array<Float,3>& tau_out = optical_props->get_tau();
+        Array<Float,3>& ssa_out = optical_props->get_ssa();
+
+        for (int igpt=1; igpt<=ngpt; ++igpt)
+            for (int ilay=1; ilay<=nlay; ++ilay)
+            {
+                const int offset = (ilay-1)*ncol + (igpt-1)*ncol*nlay;
+                const Float* tau_abs = tau.ptr() + offset;
+                const Float* tau_ray = tau_rayleigh.ptr() + offset;
+                Float* tau_row = &tau_out({1, ilay, igpt});
+                Float* ssa_row = &ssa_out({1, ilay, igpt});
 
-    rrtmgp_kernel_launcher::zero_array(ncol, nlay, ngpt, optical_props->get_g());
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const Float t = tau_abs[icol] + tau_ray[icol];
+                    ssa_row[icol] = (t > Float(2.) * std::numeric_limits<Float>::epsilon()) ? tau_ray[icol] / t : Float(0.);
+                    tau_row[icol] = t;
+                }
+            }
+    }
+
+    if (optical_props->get_g().is_contiguous())
+        rrtmgp_kernel_launcher::zero_array(ncol, nlay, ngpt, optical_props->get_g());
+    else
+        optical_props->get_g().fill(Float(0.));
 }
 
 
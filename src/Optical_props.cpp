@@ -22,11 +22,121 @@
  *
  */
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 #include "Optical_props.h"
 #include "Array.h"
 #include "rrtmgp_kernels.h"
 
 
+namespace
+{
+    // Pointer to the column row of a layer and g-point. Columns are contiguous in all layouts.
+    inline const Float* row(const Array<Float,3>& array, const int ilay, const int igpt)
+    {
+        const std::array<int,3> strides = array.get_strides();
+        return array.ptr() + (ilay-1)*strides[1] + (igpt-1)*strides[2];
+    }
+
+    inline Float* row(Array<Float,3>& array, const int ilay, const int igpt)
+    {
+        const std::array<int,3> strides = array.get_strides();
+        return array.ptr() + (ilay-1)*strides[1] + (igpt-1)*strides[2];
+    }
+
+
+    bool is_contiguous(const Optical_props_2str& op)
+    {
+        return op.get_tau().is_contiguous() && op.get_ssa().is_contiguous() && op.get_g().is_contiguous();
+    }
+
+
+    // Adds the (optionally delta-scaled) layer of op_in once to all g-points of its band in op_inout.
+    template<bool do_delta_scale>
+    void inc_2stream_by_2stream_rows(
+            Optical_props_2str& op_inout, const Optical_props_2str& op_in,
+            const Array<int,2>& band_lims_gpt)
+    {
+        constexpr Float eps = Float(3.)*std::numeric_limits<Float>::min();
+
+        const int ncol = op_inout.get_ncol();
+        const int nlay = op_inout.get_nlay();
+        const int nbnd = band_lims_gpt.dim(2);
+
+        std::vector<Float> tau_s(ncol);
+        std::vector<Float> taussa_s(ncol);
+        std::vector<Float> taussag_s(ncol);
+
+        for (int ibnd=1; ibnd<=nbnd; ++ibnd)
+            for (int ilay=1; ilay<=nlay; ++ilay)
+            {
+                const Float* __restrict__ tau_in = row(op_in.get_tau(), ilay, ibnd);
+                const Float* __restrict__ ssa_in = row(op_in.get_ssa(), ilay, ibnd);
+                const Float* __restrict__ g_in   = row(op_in.get_g  (), ilay, ibnd);
+
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    Float tau = tau_in[icol];
+                    Float ssa = ssa_in[icol];
+                    Float g   = g_in  [icol];
+
+                    if (do_delta_scale)
+                    {
+                        const Float f  = g*g;
+                        const Float wf = ssa*f;
+                        tau = (Float(1.) - wf)*tau;
+                        ssa = (ssa - wf) / std::max(eps, Float(1.) - wf);
+                        g   = (g - f) / std::max(eps, Float(1.) - f);
+                    }
+
+                    tau_s[icol] = tau;
+                    taussa_s[icol] = tau*ssa;
+                    taussag_s[icol] = tau*ssa*g;
+                }
+
+                const Float* __restrict__ tau_s_ptr = tau_s.data();
+                const Float* __restrict__ taussa_s_ptr = taussa_s.data();
+                const Float* __restrict__ taussag_s_ptr = taussag_s.data();
+
+                for (int igpt=band_lims_gpt({1, ibnd}); igpt<=band_lims_gpt({2, ibnd}); ++igpt)
+                {
+                    Float* __restrict__ tau_io = row(op_inout.get_tau(), ilay, igpt);
+                    Float* __restrict__ ssa_io = row(op_inout.get_ssa(), ilay, igpt);
+                    Float* __restrict__ g_io   = row(op_inout.get_g  (), ilay, igpt);
+
+                    for (int icol=0; icol<ncol; ++icol)
+                    {
+                        const Float tau1 = tau_io[icol];
+                        const Float taussa1 = tau1*ssa_io[icol];
+
+                        const Float tau12 = tau1 + tau_s_ptr[icol];
+                        const Float tauscat12 = taussa1 + taussa_s_ptr[icol];
+
+                        g_io  [icol] = (taussa1*g_io[icol] + taussag_s_ptr[icol]) / std::max(eps, tauscat12);
+                        ssa_io[icol] = tauscat12 / std::max(eps, tau12);
+                        tau_io[icol] = tau12;
+                    }
+                }
+            }
+    }
+
+
+    // Band limits for increments with equal numbers of g-points: every g-point acts as its own band.
+    Array<int,2> band_lims_per_gpt(const int ngpt)
+    {
+        Array<int,2> band_lims_gpt({2, ngpt});
+        for (int igpt=1; igpt<=ngpt; ++igpt)
+        {
+            band_lims_gpt({1, igpt}) = igpt;
+            band_lims_gpt({2, igpt}) = igpt;
+        }
+        return band_lims_gpt;
+    }
+}
+
+
 // Optical properties per gpoint.
 Optical_props::Optical_props(
         const Array<Float,2>& band_lims_wvn,
@@ -81,14 +191,28 @@ Optical_props_1scl::Optical_props_1scl(
 {}
 
 
+Optical_props_1scl::Optical_props_1scl(
+        Array<Float,3>& tau,
+        const Optical_props& optical_props) :
+    Optical_props_arry(optical_props),
+    tau(tau.view())
+{}
+
+
+Optical_props_1scl::Optical_props_1scl(
+        Optical_props_1scl& optical_props,
+        const int col_s, const int col_e) :
+    Optical_props_arry(optical_props),
+    tau(optical_props.tau.subset_view({{ {col_s, col_e}, {1, optical_props.get_nlay()}, {1, optical_props.get_ngpt()} }}))
+{}
+
+
+// Copies run along contiguous columns, and are skipped if the subset is a view on the same columns.
 void Optical_props_1scl::set_subset(
         const std::unique_ptr<Optical_props_arry>& optical_props_sub,
         const int col_s, const int col_e)
 {
-    for (int igpt=1; igpt<=tau.dim(3); ++igpt)
-        for (int ilay=1; ilay<=tau.dim(2); ++ilay)
-            for (int icol=col_s; icol<=col_e; ++icol)
-                tau({icol, ilay, igpt}) = optical_props_sub->get_tau()({icol-col_s+1, ilay, igpt});
+    tau.subset_view({{ {col_s, col_e}, {1, tau.dim(2)}, {1, tau.dim(3)} }}) = optical_props_sub->get_tau();
 }
 
 
@@ -96,36 +220,79 @@ void Optical_props_1scl::get_subset(
         const std::unique_ptr<Optical_props_arry>& optical_props_sub,
         const int col_s, const int col_e)
 {
-    for (int igpt=1; igpt<=tau.dim(3); ++igpt)
-        for (int ilay=1; ilay<=tau.dim(2); ++ilay)
-            for (int icol=col_s; icol<=col_e; ++icol)
-                tau({icol-col_s+1, ilay, igpt}) = optical_props_sub->get_tau()({icol, ilay, igpt});
+    tau = optical_props_sub->get_tau().subset_view({{ {col_s, col_e}, {1, tau.dim(2)}, {1, tau.dim(3)} }});
 }
 
 
 Optical_props_2str::Optical_props_2str(
         const int ncol,
         const int nlay,
+        const Optical_props& optical_props,
+        const Optical_props_layout layout) :
+    Optical_props_arry(optical_props),
+    layout(layout),
+    packed(layout == Optical_props_layout::Interleaved
+            ? Array<Float,4>({ncol, 3, nlay, this->get_ngpt()}) : Array<Float,4>()),
+    tau(make_component(0, ncol, nlay)),
+    ssa(make_component(1, ncol, nlay)),
+    g  (make_component(2, ncol, nlay))
+{}
+
+
+Optical_props_2str::Optical_props_2str(
+        Array<Float,3>& tau, Array<Float,3>& ssa, Array<Float,3>& g,
         const Optical_props& optical_props) :
     Optical_props_arry(optical_props),
-    tau({ncol, nlay, this->get_ngpt()}),
-    ssa({ncol, nlay, this->get_ngpt()}),
-    g  ({ncol, nlay, this->get_ngpt()})
+    layout(Optical_props_layout::Separate),
+    tau(tau.view()),
+    ssa(ssa.view()),
+    g  (g.view())
+{}
+
+
+Optical_props_2str::Optical_props_2str(
+        Optical_props_2str& optical_props,
+        const int col_s, const int col_e) :
+    Optical_props_arry(optical_props),
+    layout(optical_props.layout),
+    tau(optical_props.tau.subset_view({{ {col_s, col_e}, {1, optical_props.get_nlay()}, {1, optical_props.get_ngpt()} }})),
+    ssa(optical_props.ssa.subset_view({{ {col_s, col_e}, {1, optical_props.get_nlay()}, {1, optical_props.get_ngpt()} }})),
+    g  (optical_props.g  .subset_view({{ {col_s, col_e}, {1, optical_props.get_nlay()}, {1, optical_props.get_ngpt()} }}))
 {}
 
 
+Optical_props_2str::Optical_props_2str(const Optical_props_2str& optical_props) :
+    Optical_props_2str(optical_props.get_ncol(), optical_props.get_nlay(), optical_props, optical_props.layout)
+{
+    tau = optical_props.tau;
+    ssa = optical_props.ssa;
+    g   = optical_props.g;
+}
+
+
+Array<Float,3> Optical_props_2str::make_component(const int icomp, const int ncol, const int nlay)
+{
+    const int ngpt = this->get_ngpt();
+
+    if (layout == Optical_props_layout::Separate)
+        return Array<Float,3>({ncol, nlay, ngpt});
+
+    return Array<Float,3>(
+            packed.ptr() + icomp*ncol,
+            {ncol, nlay, ngpt},
+            {1, 3*ncol, 3*ncol*nlay});
+}
+
+
 void Optical_props_2str::set_subset(
         const std::unique_ptr<Optical_props_arry>& optical_props_sub,
         const int col_s, const int col_e)
 {
-    for (int igpt=1; igpt<=tau.dim(3); ++igpt)
-        for (int ilay=1; ilay<=tau.dim(2); ++ilay)
-            for (int icol=col_s; icol<=col_e; ++icol)
-            {
-                tau({icol, ilay, igpt}) = optical_props_sub->get_tau()({icol-col_s+1, ilay, igpt});
-                ssa({icol, ilay, igpt}) = optical_props_sub->get_ssa()({icol-col_s+1, ilay, igpt});
-                g  ({icol, ilay, igpt}) = optical_props_sub->get_g  ()({icol-col_s+1, ilay, igpt});
-            }
+    const std::array<std::pair<int, int>, 3> cols = {{ {col_s, col_e}, {1, tau.dim(2)}, {1, tau.dim(3)} }};
+
+    tau.subset_view(cols) = optical_props_sub->get_tau();
+    ssa.subset_view(cols) = optical_props_sub->get_ssa();
+    g  .subset_view(cols) = optical_props_sub->get_g  ();
 }
 
 
@@ -133,14 +300,11 @@ void Optical_props_2str::get_subset(
         const std::unique_ptr<Optical_props_arry>& optical_props_sub,
         const int col_s, const int col_e)
 {
-    for (int igpt=1; igpt<=tau.dim(3); ++igpt)
-        for (int ilay=1; ilay<=tau.dim(2); ++ilay)
-            for (int icol=col_s; icol<=col_e; ++icol)
-            {
-                tau({icol-col_s+1, ilay, igpt}) = optical_props_sub->get_tau()({icol, ilay, igpt});
-                ssa({icol-col_s+1, ilay, igpt}) = optical_props_sub->get_ssa()({icol, ilay, igpt});
-                g  ({icol-col_s+1, ilay, igpt}) = optical_props_sub->get_g  ()({icol, ilay, igpt});
-            }
+    const std::array<std::pair<int, int>, 3> cols = {{ {col_s, col_e}, {1, tau.dim(2)}, {1, tau.dim(3)} }};
+
+    tau = optical_props_sub->get_tau().subset_view(cols);
+    ssa = optical_props_sub->get_ssa().subset_view(cols);
+    g   = optical_props_sub->get_g  ().subset_view(cols);
 }
 
 
@@ -210,34 +374,75 @@ void Optical_props_2str::delta_scale(const Array<Float,3>& forward_frac)
     const int nlay = this->get_nlay();
     const int ngpt = this->get_ngpt();
 
-    rrtmgp_kernel_launcher::delta_scale_2str_k(
-            ncol, nlay, ngpt,
-            this->get_tau(), this->get_ssa(), this->get_g());
+    if (is_contiguous(*this))
+    {
+        rrtmgp_kernel_launcher::delta_scale_2str_k(
+                ncol, nlay, ngpt,
+                this->get_tau(), this->get_ssa(), this->get_g());
+        return;
+    }
+
+    constexpr Float eps = Float(3.)*std::numeric_limits<Float>::min();
+
+    for (int igpt=1; igpt<=ngpt; ++igpt)
+        for (int ilay=1; ilay<=nlay; ++ilay)
+        {
+            Float* __restrict__ tau_io = row(tau, ilay, igpt);
+            Float* __restrict__ ssa_io = row(ssa, ilay, igpt);
+            Float* __restrict__ g_io   = row(g  , ilay, igpt);
+
+            for (int icol=0; icol<ncol; ++icol)
+            {
+                const Float f  = g_io[icol]*g_io[icol];
+                const Float wf = ssa_io[icol]*f;
+                tau_io[icol] = (Float(1.) - wf)*tau_io[icol];
+                ssa_io[icol] = (ssa_io[icol] - wf) / std::max(eps, Float(1.) - wf);
+                g_io  [icol] = (g_io[icol] - f) / std::max(eps, Float(1.) - f);
+            }
+        }
 }
 
 
-void add_to(Optical_props_1scl& op_inout, const Optical_props_1scl& op_in)
+namespace
 {
-    const int ncol = op_inout.get_ncol();
-    const int nlay = op_inout.get_nlay();
-    const int ngpt = op_inout.get_ngpt();
-
-    if (ngpt == op_in.get_ngpt())
+    // Add the extinction optical depth tau_in, with the spectral discretization of op_in, to op_inout.
+    void add_tau_to(Optical_props_1scl& op_inout, const Array<Float,3>& tau_in, const Optical_props& op_in)
     {
-        rrtmgp_kernel_launcher::increment_1scalar_by_1scalar(
-                ncol, nlay, ngpt,
-                op_inout.get_tau(), op_in.get_tau());
+        const int ncol = op_inout.get_ncol();
+        const int nlay = op_inout.get_nlay();
+        const int ngpt = op_inout.get_ngpt();
+
+        if (ngpt == op_in.get_ngpt())
+        {
+            rrtmgp_kernel_launcher::increment_1scalar_by_1scalar(
+                    ncol, nlay, ngpt,
+                    op_inout.get_tau(), tau_in);
+        }
+        else
+        {
+            if (op_in.get_ngpt() != op_inout.get_nband())
+                throw std::runtime_error("Cannot add optical properties with incompatible band - gpoint combination");
+
+            rrtmgp_kernel_launcher::inc_1scalar_by_1scalar_bybnd(
+                    ncol, nlay, ngpt,
+                    op_inout.get_tau(), tau_in,
+                    op_inout.get_nband(), op_inout.get_band_lims_gpoint());
+        }
     }
-    else
-    {
-        if (op_in.get_ngpt() != op_inout.get_nband())
-            throw std::runtime_error("Cannot add optical properties with incompatible band - gpoint combination");
+}
 
-        rrtmgp_kernel_launcher::inc_1scalar_by_1scalar_bybnd(
-                ncol, nlay, ngpt,
-                op_inout.get_tau(), op_in.get_tau(),
-                op_inout.get_nband(), op_inout.get_band_lims_gpoint());
-    }
+
+void add_to(Optical_props_1scl& op_inout, const Optical_props_1scl& op_in)
+{
+    add_tau_to(op_inout, op_in.get_tau(), op_in);
+}
+
+
+void add_extinction_to(Optical_props_1scl& op_inout, const Optical_props_2str& op_in)
+{
+    // Only the tau of op_in is added, interleaved layouts are copied for the Fortran kernels.
+    Array<Float,3> tau_buffer;
+    add_tau_to(op_inout, contiguous(op_in.get_tau(), tau_buffer), op_in);
 }
 
 
@@ -247,7 +452,17 @@ void add_to(Optical_props_2str& op_inout, const Optical_props_2str& op_in)
     const int nlay = op_inout.get_nlay();
     const int ngpt = op_inout.get_ngpt();
 
-    if (ngpt == op_in.get_ngpt())
+    // The Fortran kernels need contiguous arrays, interleaved layouts use the native kernel.
+    if (!is_contiguous(op_inout) || !is_contiguous(op_in))
+    {
+        if (ngpt == op_in.get_ngpt())
+            inc_2stream_by_2stream_rows<false>(op_inout, op_in, band_lims_per_gpt(ngpt));
+        else if (op_in.get_ngpt() == op_inout.get_nband())
+            inc_2stream_by_2stream_rows<false>(op_inout, op_in, op_inout.get_band_lims_gpoint());
+        else
+            throw std::runtime_error("Cannot add optical properties with incompatible band - gpoint combination");
+    }
+    else if (ngpt == op_in.get_ngpt())
     {
         rrtmgp_kernel_launcher::increment_2stream_by_2stream(
                 ncol, nlay, ngpt,
@@ -266,3 +481,74 @@ void add_to(Optical_props_2str& op_inout, const Optical_props_2str& op_in)
                 op_inout.get_nband(), op_inout.get_band_lims_gpoint());
     }
 }
+
+
+void add_to_delta_scaled(Optical_props_2str& op_inout, const Optical_props_2str& op_in)
+{
+    const int ngpt = op_inout.get_ngpt();
+
+    if (ngpt == op_in.get_ngpt())
+        inc_2stream_by_2stream_rows<true>(op_inout, op_in, band_lims_per_gpt(ngpt));
+    else
+    {
+        if (op_in.get_ngpt() != op_inout.get_nband())
+            throw std::runtime_error("Cannot add optical properties with incompatible band - gpoint combination");
+
+        inc_2stream_by_2stream_rows<true>(op_inout, op_in, op_inout.get_band_lims_gpoint());
+    }
+}
+
+
+Optical_props_2str_combined::Optical_props_2str_combined(
+        const Optical_props_2str& gas_optical_props,
+        const Optical_props_2str& particle_optical_props) :
+    Optical_props(gas_optical_props),
+    gas_optical_props(gas_optical_props),
+    particle_optical_props(particle_optical_props)
+{
+    if (particle_optical_props.get_ngpt() != gas_optical_props.get_nband())
+        throw std::runtime_error("Cannot add optical properties with incompatible band - gpoint combination");
+
+    if ( (particle_optical_props.get_ncol() != gas_optical_props.get_ncol())
+      || (particle_optical_props.get_nlay() != gas_optical_props.get_nlay()) )
+        throw std::runtime_error("Cannot combine optical properties with different column or layer dimensions");
+}
+
+
+// Same arithmetic as rte_inc_2stream_by_2stream_bybnd, restricted to a single g-point.
+void Optical_props_2str_combined::combine_gpt(
+        const int igpt,
+        Array<Float,2>& tau, Array<Float,2>& ssa, Array<Float,2>& g) const
+{
+    constexpr Float eps = Float(3.)*std::numeric_limits<Float>::min();
+
+    const int ncol = this->get_ncol();
+    const int nlay = this->get_nlay();
+    const int ibnd = this->get_gpoint_bands()({igpt});
+
+    for (int ilay=1; ilay<=nlay; ++ilay)
+    {
+        const Float* __restrict__ tau_gas = row(gas_optical_props.get_tau(), ilay, igpt);
+        const Float* __restrict__ ssa_gas = row(gas_optical_props.get_ssa(), ilay, igpt);
+        const Float* __restrict__ g_gas   = row(gas_optical_props.get_g  (), ilay, igpt);
+
+        const Float* __restrict__ tau_par = row(particle_optical_props.get_tau(), ilay, ibnd);
+        const Float* __restrict__ ssa_par = row(particle_optical_props.get_ssa(), ilay, ibnd);
+        const Float* __restrict__ g_par   = row(particle_optical_props.get_g  (), ilay, ibnd);
+
+        Float* __restrict__ tau_out = tau.ptr() + (ilay-1)*ncol;
+        Float* __restrict__ ssa_out = ssa.ptr() + (ilay-1)*ncol;
+        Float* __restrict__ g_out   = g  .ptr() + (ilay-1)*ncol;
+
+        for (int icol=0; icol<ncol; ++icol)
+        {
+            const Float tau12 = tau_gas[icol] + tau_par[icol];
+            const Float tauscat12 = tau_gas[icol]*ssa_gas[icol] + tau_par[icol]*ssa_par[icol];
+
+            g_out[icol] = (tau_gas[icol]*ssa_gas[icol]*g_gas[icol] + tau_par[icol]*ssa_par[icol]*g_par[icol])
+                        / std::max(eps, tauscat12);
+            ssa_out[icol] = tauscat12 / std::max(eps, tau12);
+            tau_out[icol] = tau12;
+        }
+    }
+}
@@ -22,67 +22,455 @@
  *
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
 #include "Rte_lw.h"
 #include "Array.h"
 #include "Optical_props.h"
 #include "Source_functions.h"
-#include "rrtmgp_kernels.h"
 
 
-namespace rrtmgp_kernel_launcher
+namespace
 {
-    template<typename Float>
-    void apply_BC(
-            int ncol, int nlay, int ngpt,
-            Bool top_at_1, Array<Float,3>& gpt_flux_dn)
+    // Pointer to the column row of a layer (or level) and g-point, columns are contiguous in all layouts.
+    inline const Float* row(const Array<Float,3>& array, const int ilay, const int igpt)
     {
-        rrtmgp_kernels::apply_BC_0(
-                &ncol, &nlay, &ngpt,
-                &top_at_1, gpt_flux_dn.ptr());
+        const std::array<int,3> strides = array.get_strides();
+        return array.ptr() + (ilay-1)*strides[1] + (igpt-1)*strides[2];
     }
 
-    template<typename Float>
-    void apply_BC(
-            int ncol, int nlay, int ngpt,
-            Bool top_at_1, const Array<Float,2>& inc_flux,
-            Array<Float,3>& gpt_flux_dn)
+    inline Float* row(Array<Float,3>& array, const int ilev, const int iflx)
     {
-        rrtmgp_kernels::apply_BC_gpt(
-                &ncol, &nlay, &ngpt,
-                &top_at_1, const_cast<Float*>(inc_flux.ptr()), gpt_flux_dn.ptr());
+        const std::array<int,3> strides = array.get_strides();
+        return array.ptr() + (ilev-1)*strides[1] + (iflx-1)*strides[2];
     }
 
-    template<typename Float>
-    void lw_solver_noscat_GaussQuad(
-            int ncol, int nlay, int ngpt, Bool top_at_1, int n_quad_angs,
-            const Array<Float,3>& secants,
-            const Array<Float,2>& gauss_wts_subset,
-            const Array<Float,3>& tau,
-            const Array<Float,3>& lay_source,
-            const Array<Float,3>& lev_source_inc, const Array<Float,3>& lev_source_dec,
-            const Array<Float,2>& sfc_emis_gpt, const Array<Float,2>& sfc_source,
-            const Array<Float,2>& inc_flux_diffuse,
-            Array<Float,3>& gpt_flux_up, Array<Float,3>& gpt_flux_dn,
-            Bool do_broadband, Array<Float,3>& flux_up_loc, Array<Float,3>& flux_dn_loc,
-            Bool do_jacobians, const Array<Float,2>& sfc_source_jac, Array<Float,3>& gpt_flux_up_jac,
-            Bool do_rescaling, const Array<Float,3>& ssa, const Array<Float,3>& g)
+    inline const Float* row(const Array<Float,2>& array, const int igpt)
     {
-        rrtmgp_kernels::rte_lw_solver_noscat(
-                &ncol, &nlay, &ngpt, &top_at_1, &n_quad_angs,
-                const_cast<Float*>(secants.ptr()),
-                const_cast<Float*>(gauss_wts_subset.ptr()),
-                const_cast<Float*>(tau.ptr()),
-                const_cast<Float*>(lay_source.ptr()),
-                const_cast<Float*>(lev_source_inc.ptr()),
-                const_cast<Float*>(lev_source_dec.ptr()),
-                const_cast<Float*>(sfc_emis_gpt.ptr()),
-                const_cast<Float*>(sfc_source.ptr()),
-                const_cast<Float*>(inc_flux_diffuse.ptr()),
-                gpt_flux_up.ptr(),
-                gpt_flux_dn.ptr(),
-                &do_broadband, flux_up_loc.ptr(), flux_dn_loc.ptr(),
-                &do_jacobians, const_cast<Float*>(sfc_source_jac.ptr()), gpt_flux_up_jac.ptr(),
-                &do_rescaling, const_cast<Float*>(ssa.ptr()), const_cast<Float*>(g.ptr()));
+        return array.ptr() + (igpt-1)*array.get_strides()[1];
+    }
+
+
+    // Longwave transport without scattering, see lw_solver_noscat in mo_rte_solver_kernels.F90, optionally
+    // with the scattering approximation of lw_transport_1rescl (Tang et al., 2018, doi:10.1175/JAS-D-18-0014.1).
+    // Vectorized over the columns, the fluxes of each g-point and angle are added to
+    // the slice flux_index[igpt-1] of flux_up and flux_dn while sweeping through the column.
+    // With do_jacobians, the broadband surface temperature Jacobian of flux_up is added to flux_up_jac.
+    template<bool do_rescaling, bool do_jacobians>
+    void lw_solver_noscat(
+            const Bool top_at_1,
+            const Float* secants, const Float* weights, const int n_quad_angs,
+            const Array<Float,3>& tau, const Array<Float,3>& ssa, const Array<Float,3>& g,
+            const Source_func_lw& sources,
+            const Array<Float,2>& sfc_emis,
+            const Array<Float,2>& inc_flux,
+            const Array<int,2>& band_lims_gpt,
+            const std::vector<int>& flux_index,
+            Array<Float,3>& flux_up, Array<Float,3>& flux_dn,
+            Array<Float,2>& flux_up_jac)
+    {
+        const Float pi = std::acos(Float(-1.));
+        const Float tau_thresh = std::sqrt(std::numeric_limits<Float>::epsilon());
+
+        const int ncol = tau.dim(1);
+        const int nlay = tau.dim(2);
+        const int nbnd = band_lims_gpt.dim(2);
+
+        const int top_level = top_at_1 ? 1 : nlay+1;
+        const int sfc_level = top_at_1 ? nlay+1 : 1;
+
+        // The downward sweep stores the transmissivity and upward source per layer for the upward sweep,
+        // the rescaling also needs the downward source, its coefficients, and the radiances at the levels.
+        std::vector<Float> trans_lay(ncol*nlay);
+        std::vector<Float> source_up_lay(ncol*nlay);
+        std::vector<Float> source_dn_lay(do_rescaling ? ncol*nlay : 0);
+        std::vector<Float> an_lay(do_rescaling ? ncol*nlay : 0);
+        std::vector<Float> cn_lay(do_rescaling ? ncol*nlay : 0);
+        std::vector<Float> radn_dn_lev(do_rescaling ? ncol*(nlay+1) : 0);
+        std::vector<Float> radn_up_lev(do_rescaling ? ncol*(nlay+1) : 0);
+        std::vector<Float> sfc_emis_bnd(ncol);
+        std::vector<Float> radn(ncol);
+        std::vector<Float> radn_jac(do_jacobians ? ncol : 0);
+
+        flux_up.fill(Float(0.));
+        flux_dn.fill(Float(0.));
+
+        if (do_jacobians)
+            flux_up_jac.fill(Float(0.));
+
+        for (int ibnd=1; ibnd<=nbnd; ++ibnd)
+        {
+            for (int icol=1; icol<=ncol; ++icol)
+                sfc_emis_bnd[icol-1] = sfc_emis({ibnd, icol});
+
+            for (int igpt=band_lims_gpt({1, ibnd}); igpt<=band_lims_gpt({2, ibnd}); ++igpt)
+            {
+                const int iflx = flux_index[igpt-1];
+
+                const Float* __restrict__ sfc_src = row(sources.get_sfc_source(), igpt);
+                const Float* __restrict__ sfc_src_jac = do_jacobians ? row(sources.get_sfc_source_jac(), igpt) : nullptr;
+                const Float* __restrict__ inc = (inc_flux.size() > 0) ? row(inc_flux, igpt) : nullptr;
+                const Float* __restrict__ emis = sfc_emis_bnd.data();
+                Float* __restrict__ rad = radn.data();
+                Float* __restrict__ rad_jac = radn_jac.data();
+
+                for (int imu=0; imu<n_quad_angs; ++imu)
+                {
+                    const Float secant = secants[imu];
+                    const Float flux_fac = Float(2.)*pi*weights[imu];
+
+                    // Transport is for intensity, convert the incident flux assuming azimuthal isotropy.
+                    Float* __restrict__ dn_top = row(flux_dn, top_level, iflx);
+                    for (int icol=0; icol<ncol; ++icol)
+                    {
+                        rad[icol] = inc ? inc[icol] / flux_fac : Float(0.);
+                        dn_top[icol] += flux_fac*rad[icol];
+                    }
+
+                    if (do_rescaling)
+                        std::copy(rad, rad+ncol, radn_dn_lev.data() + (top_level-1)*ncol);
+
+                    // Optical path, transmissivity and linear-in-tau sources, combined with the downward transport.
+                    for (int k=0; k<nlay; ++k)
+                    {
+                        const int ilay = top_at_1 ? k+1 : nlay-k;
+                        const int ilev = top_at_1 ? k+2 : nlay-k;
+
+                        const Float* __restrict__ tau_lay = row(tau, ilay, igpt);
+                        const Float* __restrict__ ssa_lay = do_rescaling ? row(ssa, ilay, igpt) : nullptr;
+                        const Float* __restrict__ g_lay   = do_rescaling ? row(g  , ilay, igpt) : nullptr;
+                        const Float* __restrict__ lay_src = row(sources.get_lay_source(), ilay, igpt);
+                        const Float* __restrict__ lev_src_dn = top_at_1
+                                ? row(sources.get_lev_source_inc(), ilay, igpt)
+                                : row(sources.get_lev_source_dec(), ilay, igpt);
+                        const Float* __restrict__ lev_src_up = top_at_1
+                                ? row(sources.get_lev_source_dec(), ilay, igpt)
+                                : row(sources.get_lev_source_inc(), ilay, igpt);
+
+                        Float* __restrict__ trans = trans_lay.data() + (ilay-1)*ncol;
+                        Float* __restrict__ source_up = source_up_lay.data() + (ilay-1)*ncol;
+                        Float* __restrict__ source_dn = do_rescaling ? source_dn_lay.data() + (ilay-1)*ncol : nullptr;
+                        Float* __restrict__ an = do_rescaling ? an_lay.data() + (ilay-1)*ncol : nullptr;
+                        Float* __restrict__ cn = do_rescaling ? cn_lay.data() + (ilay-1)*ncol : nullptr;
+                        Float* __restrict__ rad_dn = do_rescaling ? radn_dn_lev.data() + (ilev-1)*ncol : nullptr;
+                        Float* __restrict__ dn = row(flux_dn, ilev, iflx);
+
+                        for (int icol=0; icol<ncol; ++icol)
+                        {
+                            Float tau_loc = tau_lay[icol]*secant;
+
+                            if (do_rescaling)
+                            {
+                                // Scaling of the optical path to a non-scattering form, Eqs. 14 and 21-22 of Tang et al.
+                                const Float wb = ssa_lay[icol]*(Float(1.) - g_lay[icol])*Float(0.5);
+                                const Float scale_tau = Float(1.) - ssa_lay[icol] + wb;
+                                cn[icol] = Float(0.4)*wb/scale_tau;
+                                tau_loc *= scale_tau;
+                            }
+
+                            const Float t = std::exp(-tau_loc);
+
+                            // Second order series expansion for small optical paths.
+                            const Float fact = (tau_loc > tau_thresh)
+                                    ? (Float(1.) - t)/tau_loc - t
+                                    : tau_loc*(Float(0.5) - Float(1.)/Float(3.)*tau_loc);
+
+                            const Float src_dn = (Float(1.) - t)*lev_src_dn[icol]
+                                    + Float(2.)*fact*(lay_src[icol] - lev_src_dn[icol]);
+                            source_up[icol] = (Float(1.) - t)*lev_src_up[icol]
+                                    + Float(2.)*fact*(lay_src[icol] - lev_src_up[icol]);
+                            trans[icol] = t;
+
+                            rad[icol] = t*rad[icol] + src_dn;
+
+                            if (do_rescaling)
+                            {
+                                source_dn[icol] = src_dn;
+                                an[icol] = Float(1.) - t*t;
+                                rad_dn[icol] = rad[icol];
+                            }
+                            else
+                                dn[icol] += flux_fac*rad[icol];
+                        }
+                    }
+
+                    // Surface reflection and emission.
+                    Float* __restrict__ up_sfc = row(flux_up, sfc_level, iflx);
+                    for (int icol=0; icol<ncol; ++icol)
+                    {
+                        rad[icol] = rad[icol]*(Float(1.) - emis[icol]) + emis[icol]*sfc_src[icol];
+                        up_sfc[icol] += flux_fac*rad[icol];
+                    }
+
+                    if (do_jacobians)
+                    {
+                        Float* __restrict__ jac_sfc = flux_up_jac.ptr() + (sfc_level-1)*ncol;
+                        for (int icol=0; icol<ncol; ++icol)
+                        {
+                            rad_jac[icol] = emis[icol]*sfc_src_jac[icol];
+                            jac_sfc[icol] += flux_fac*rad_jac[icol];
+                        }
+                    }
+
+                    if (do_rescaling)
+                        std::copy(rad, rad+ncol, radn_up_lev.data() + (sfc_level-1)*ncol);
+
+                    // Upward transport, with the adjustment for the scattered downward radiance at the layer top.
+                    // The Jacobian is only transmitted, as in lw_transport_noscat_up and lw_transport_1rescl.
+                    for (int k=nlay-1; k>=0; --k)
+                    {
+                        const int ilay = top_at_1 ? k+1 : nlay-k;
+                        const int ilev = top_at_1 ? k+1 : nlay+1-k;
+
+                        const Float* __restrict__ trans = trans_lay.data() + (ilay-1)*ncol;
+                        const Float* __restrict__ source_up = source_up_lay.data() + (ilay-1)*ncol;
+                        const Float* __restrict__ source_dn = do_rescaling ? source_dn_lay.data() + (ilay-1)*ncol : nullptr;
+                        const Float* __restrict__ an = do_rescaling ? an_lay.data() + (ilay-1)*ncol : nullptr;
+                        const Float* __restrict__ cn = do_rescaling ? cn_lay.data() + (ilay-1)*ncol : nullptr;
+                        const Float* __restrict__ rad_dn = do_rescaling ? radn_dn_lev.data() + (ilev-1)*ncol : nullptr;
+                        Float* __restrict__ rad_up = do_rescaling ? radn_up_lev.data() + (ilev-1)*ncol : nullptr;
+                        Float* __restrict__ up = row(flux_up, ilev, iflx);
+                        Float* __restrict__ jac = do_jacobians ? flux_up_jac.ptr() + (ilev-1)*ncol : nullptr;
+
+                        for (int icol=0; icol<ncol; ++icol)
+                        {
+                            rad[icol] = trans[icol]*rad[icol] + source_up[icol];
+
+                            if (do_jacobians)
+                            {
+                                rad_jac[icol] *= trans[icol];
+                                jac[icol] += flux_fac*rad_jac[icol];
+                            }
+
+                            if (do_rescaling)
+                            {
+                                rad[icol] += cn[icol]*(an[icol]*rad_dn[icol] - trans[icol]*source_dn[icol] - source_up[icol]);
+                                rad_up[icol] = rad[icol];
+                            }
+
+                            up[icol] += flux_fac*rad[icol];
+                        }
+                    }
+
+                    if (!do_rescaling)
+                        continue;
+
+                    // Downward transport again, with the adjustment for the scattered upward radiance.
+                    // As in lw_transport_1rescl, that radiance is taken at the layer top if top_at_1
+                    // and at the layer bottom otherwise.
+                    std::copy(radn_dn_lev.data() + (top_level-1)*ncol, radn_dn_lev.data() + top_level*ncol, rad);
+
+                    for (int k=0; k<nlay; ++k)
+                    {
+                        const int ilay = top_at_1 ? k+1 : nlay-k;
+                        const int ilev = top_at_1 ? k+2 : nlay-k;
+                        const int ilev_up = top_at_1 ? k+1 : nlay-k;
+
+                        const Float* __restrict__ trans = trans_lay.data() + (ilay-1)*ncol;
+                        const Float* __restrict__ source_up = source_up_lay.data() + (ilay-1)*ncol;
+                        const Float* __restrict__ source_dn = source_dn_lay.data() + (ilay-1)*ncol;
+                        const Float* __restrict__ an = an_lay.data() + (ilay-1)*ncol;
+                        const Float* __restrict__ cn = cn_lay.data() + (ilay-1)*ncol;
+                        const Float* __restrict__ rad_up = radn_up_lev.data() + (ilev_up-1)*ncol;
+                        Float* __restrict__ dn = row(flux_dn, ilev, iflx);
+
+                        for (int icol=0; icol<ncol; ++icol)
+                        {
+                            rad[icol] = trans[icol]*rad[icol] + source_dn[icol]
+                                    + cn[icol]*(an[icol]*rad_up[icol] - trans[icol]*source_up[icol] - source_dn[icol]);
+                            dn[icol] += flux_fac*rad[icol];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Longwave two-stream solver, see lw_solver_2stream in mo_rte_solver_kernels.F90, with the
+    // coefficients of Fu et al. (1997) and the adding method of Shonk and Hogan (2008).
+    // Vectorized over the columns, the fluxes of each g-point are added to the slice flux_index[igpt-1].
+    void lw_solver_2stream(
+            const Bool top_at_1,
+            const Array<Float,3>& tau, const Array<Float,3>& ssa, const Array<Float,3>& g,
+            const Source_func_lw& sources,
+            const Array<Float,2>& sfc_emis,
+            const Array<Float,2>& inc_flux,
+            const Array<int,2>& band_lims_gpt,
+            const std::vector<int>& flux_index,
+            Array<Float,3>& flux_up, Array<Float,3>& flux_dn)
+    {
+        const Float pi = std::acos(Float(-1.));
+        const Float lw_diff_sec = Float(1.66);
+
+        const int ncol = tau.dim(1);
+        const int nlay = tau.dim(2);
+        const int nbnd = band_lims_gpt.dim(2);
+
+        // Layers and levels are numbered from the top of the domain (k = 0) in the buffers.
+        std::vector<Float> rdif_lay(ncol*nlay);
+        std::vector<Float> tdif_lay(ncol*nlay);
+        std::vector<Float> source_up_lay(ncol*nlay);
+        std::vector<Float> source_dn_lay(ncol*nlay);
+        std::vector<Float> denom_lay(ncol*nlay);
+        std::vector<Float> albedo_lev(ncol*(nlay+1));
+        std::vector<Float> src_lev(ncol*(nlay+1));
+        std::vector<Float> lev_source(ncol*(nlay+1));
+        std::vector<Float> sfc_emis_bnd(ncol);
+        std::vector<Float> flux(ncol);
+
+        flux_up.fill(Float(0.));
+        flux_dn.fill(Float(0.));
+
+        for (int ibnd=1; ibnd<=nbnd; ++ibnd)
+        {
+            for (int icol=1; icol<=ncol; ++icol)
+                sfc_emis_bnd[icol-1] = sfc_emis({ibnd, icol});
+
+            for (int igpt=band_lims_gpt({1, ibnd}); igpt<=band_lims_gpt({2, ibnd}); ++igpt)
+            {
+                const int iflx = flux_index[igpt-1];
+
+                const Float* __restrict__ sfc_src = row(sources.get_sfc_source(), igpt);
+                const Float* __restrict__ inc = (inc_flux.size() > 0) ? row(inc_flux, igpt) : nullptr;
+                const Float* __restrict__ emis = sfc_emis_bnd.data();
+                Float* __restrict__ flx = flux.data();
+
+                // Level sources combining the spectral mappings of the adjacent layers, as in lw_combine_sources.
+                for (int ilev=1; ilev<=nlay+1; ++ilev)
+                {
+                    Float* __restrict__ lev_src = lev_source.data() + (ilev-1)*ncol;
+
+                    if (ilev == 1)
+                        std::copy_n(row(sources.get_lev_source_dec(), 1, igpt), ncol, lev_src);
+                    else if (ilev == nlay+1)
+                        std::copy_n(row(sources.get_lev_source_inc(), nlay, igpt), ncol, lev_src);
+                    else
+                    {
+                        const Float* __restrict__ lev_src_dec = row(sources.get_lev_source_dec(), ilev, igpt);
+                        const Float* __restrict__ lev_src_inc = row(sources.get_lev_source_inc(), ilev-1, igpt);
+                        for (int icol=0; icol<ncol; ++icol)
+                            lev_src[icol] = std::sqrt(lev_src_dec[icol]*lev_src_inc[icol]);
+                    }
+                }
+
+                // Reflectance, transmittance and sources of the layers, Meador and Weaver (1980) and Toon et al. (1989).
+                for (int k=0; k<nlay; ++k)
+                {
+                    const int ilay = top_at_1 ? k+1 : nlay-k;
+                    const int ilev_top = top_at_1 ? k+1 : nlay+1-k;
+                    const int ilev_bot = top_at_1 ? k+2 : nlay-k;
+
+                    const Float* __restrict__ tau_lay = row(tau, ilay, igpt);
+                    const Float* __restrict__ ssa_lay = row(ssa, ilay, igpt);
+                    const Float* __restrict__ g_lay   = row(g  , ilay, igpt);
+
+                    Float* __restrict__ rdif = rdif_lay.data() + k*ncol;
+                    Float* __restrict__ tdif = tdif_lay.data() + k*ncol;
+                    Float* __restrict__ source_up = source_up_lay.data() + k*ncol;
+                    Float* __restrict__ source_dn = source_dn_lay.data() + k*ncol;
+                    const Float* __restrict__ lev_src_top = lev_source.data() + (ilev_top-1)*ncol;
+                    const Float* __restrict__ lev_src_bot = lev_source.data() + (ilev_bot-1)*ncol;
+
+                    for (int icol=0; icol<ncol; ++icol)
+                    {
+                        const Float gamma1 = lw_diff_sec*(Float(1.) - Float(0.5)*ssa_lay[icol]*(Float(1.) + g_lay[icol]));
+                        const Float gamma2 = lw_diff_sec*Float(0.5)*ssa_lay[icol]*(Float(1.) - g_lay[icol]);
+                        const Float k_ms = std::sqrt(std::max((gamma1 - gamma2)*(gamma1 + gamma2), Two_stream_k_min));
+
+                        const Float exp_minusktau = std::exp(-tau_lay[icol]*k_ms);
+                        const Float exp_minus2ktau = exp_minusktau*exp_minusktau;
+
+                        const Float rt_term = Float(1.) / (k_ms*(Float(1.) + exp_minus2ktau) + gamma1*(Float(1.) - exp_minus2ktau));
+
+                        rdif[icol] = rt_term*gamma2*(Float(1.) - exp_minus2ktau);
+                        tdif[icol] = rt_term*Float(2.)*k_ms*exp_minusktau;
+
+                        if (tau_lay[icol] > Float(1.e-8))
+                        {
+                            const Float z = (lev_src_bot[icol] - lev_src_top[icol]) / (tau_lay[icol]*(gamma1 + gamma2));
+                            const Float zup_top    =  z + lev_src_top[icol];
+                            const Float zup_bottom =  z + lev_src_bot[icol];
+                            const Float zdn_top    = -z + lev_src_top[icol];
+                            const Float zdn_bottom = -z + lev_src_bot[icol];
+                            source_up[icol] = pi*(zup_top    - rdif[icol]*zdn_top    - tdif[icol]*zup_bottom);
+                            source_dn[icol] = pi*(zdn_bottom - rdif[icol]*zup_bottom - tdif[icol]*zdn_top);
+                        }
+                        else
+                        {
+                            source_up[icol] = Float(0.);
+                            source_dn[icol] = Float(0.);
+                        }
+                    }
+                }
+
+                // Albedo and upward source below each level, from the surface up.
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    albedo_lev[nlay*ncol + icol] = Float(1.) - emis[icol];
+                    src_lev[nlay*ncol + icol] = pi*emis[icol]*sfc_src[icol];
+                }
+
+                for (int k=nlay-1; k>=0; --k)
+                {
+                    const Float* __restrict__ rdif = rdif_lay.data() + k*ncol;
+                    const Float* __restrict__ tdif = tdif_lay.data() + k*ncol;
+                    const Float* __restrict__ source_up = source_up_lay.data() + k*ncol;
+                    const Float* __restrict__ source_dn = source_dn_lay.data() + k*ncol;
+                    const Float* __restrict__ albedo_below = albedo_lev.data() + (k+1)*ncol;
+                    const Float* __restrict__ src_below = src_lev.data() + (k+1)*ncol;
+
+                    Float* __restrict__ denom = denom_lay.data() + k*ncol;
+                    Float* __restrict__ albedo = albedo_lev.data() + k*ncol;
+                    Float* __restrict__ src = src_lev.data() + k*ncol;
+
+                    for (int icol=0; icol<ncol; ++icol)
+                    {
+                        denom[icol] = Float(1.) / (Float(1.) - rdif[icol]*albedo_below[icol]);
+                        albedo[icol] = rdif[icol] + tdif[icol]*tdif[icol]*albedo_below[icol]*denom[icol];
+                        src[icol] = source_up[icol] + tdif[icol]*denom[icol]*(src_below[icol] + albedo_below[icol]*source_dn[icol]);
+                    }
+                }
+
+                // Fluxes from the top of the domain down.
+                const int top_level = top_at_1 ? 1 : nlay+1;
+                Float* __restrict__ dn_top = row(flux_dn, top_level, iflx);
+                Float* __restrict__ up_top = row(flux_up, top_level, iflx);
+
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    flx[icol] = inc ? inc[icol] : Float(0.);
+                    dn_top[icol] += flx[icol];
+                    up_top[icol] += flx[icol]*albedo_lev[icol] + src_lev[icol];
+                }
+
+                for (int k=0; k<nlay; ++k)
+                {
+                    const int ilev = top_at_1 ? k+2 : nlay-k;
+
+                    const Float* __restrict__ rdif = rdif_lay.data() + k*ncol;
+                    const Float* __restrict__ tdif = tdif_lay.data() + k*ncol;
+                    const Float* __restrict__ source_dn = source_dn_lay.data() + k*ncol;
+                    const Float* __restrict__ denom = denom_lay.data() + k*ncol;
+                    const Float* __restrict__ albedo = albedo_lev.data() + (k+1)*ncol;
+                    const Float* __restrict__ src = src_lev.data() + (k+1)*ncol;
+
+                    Float* __restrict__ dn = row(flux_dn, ilev, iflx);
+                    Float* __restrict__ up = row(flux_up, ilev, iflx);
+
+                    for (int icol=0; icol<ncol; ++icol)
+                    {
+                        flx[icol] = (tdif[icol]*flx[icol] + rdif[icol]*src[icol] + source_dn[icol])*denom[icol];
+                        dn[icol] += flx[icol];
+                        up[icol] += flx[icol]*albedo[icol] + src[icol];
+                    }
+                }
+            }
+        }
     }
 }
 
@@ -95,7 +483,26 @@ void Rte_lw::rte_lw(
         const Array<Float,2>& inc_flux,
         Array<Float,3>& gpt_flux_up,
         Array<Float,3>& gpt_flux_dn,
-        const int n_gauss_angles)
+        const int n_gauss_angles,
+        const Lw_scattering scattering)
+{
+    Array<Float,2> flux_up_jac;
+    rte_lw(optical_props, top_at_1, sources, sfc_emis, inc_flux,
+           gpt_flux_up, gpt_flux_dn, flux_up_jac, n_gauss_angles, scattering);
+}
+
+
+void Rte_lw::rte_lw(
+        const std::unique_ptr<Optical_props_arry>& optical_props,
+        const Bool top_at_1,
+        const Source_func_lw& sources,
+        const Array<Float,2>& sfc_emis,
+        const Array<Float,2>& inc_flux,
+        Array<Float,3>& gpt_flux_up,
+        Array<Float,3>& gpt_flux_dn,
+        Array<Float,2>& flux_up_jac,
+        const int n_gauss_angles,
+        const Lw_scattering scattering)
 {
     const int max_gauss_pts = 4;
     const Array<Float,2> gauss_Ds(
@@ -112,56 +519,145 @@ void Rte_lw::rte_lw(
              0.1355069134, 0.2034645680, 0.1298475476, 0.0311809710},
             { max_gauss_pts, max_gauss_pts });
 
-    const int ncol = optical_props->get_ncol();
-    const int nlay = optical_props->get_nlay();
     const int ngpt = optical_props->get_ngpt();
+    const int nbnd = optical_props->get_nband();
+    const int nflx = gpt_flux_up.dim(3);
+
+    const Array<int,2>& band_lims_gpt = optical_props->get_band_lims_gpoint();
 
-    Array<Float,2> sfc_emis_gpt({ncol, ngpt});
+    if (n_gauss_angles < 1 || n_gauss_angles > max_gauss_pts)
+        throw std::runtime_error("The number of Gauss angles must be between 1 and 4");
 
-    expand_and_transpose(optical_props, sfc_emis, sfc_emis_gpt);
+    // The fluxes are accumulated per g-point, per band, or broadband.
+    std::vector<int> flux_index(ngpt);
+    for (int ibnd=1; ibnd<=nbnd; ++ibnd)
+        for (int igpt=band_lims_gpt({1, ibnd}); igpt<=band_lims_gpt({2, ibnd}); ++igpt)
+        {
+            if (nflx == ngpt)
+                flux_index[igpt-1] = igpt;
+            else if (nflx == nbnd)
+                flux_index[igpt-1] = ibnd;
+            else if (nflx == 1)
+                flux_index[igpt-1] = 1;
+            else
+                throw std::runtime_error("Flux arrays need 1, nband or ngpt entries in the third dimension");
+        }
 
-    // Run the radiative transfer solver
+    const Array<Float,3>& tau = optical_props->get_tau();
+
+    // Run the radiative transfer solver, the secants are the same for all columns and g-points.
     const int n_quad_angs = n_gauss_angles;
+    const Float* secants = gauss_Ds.ptr() + (n_quad_angs-1)*max_gauss_pts;
+    const Float* weights = gauss_wts.ptr() + (n_quad_angs-1)*max_gauss_pts;
 
-    // Array<Float,2> gauss_Ds_subset = gauss_Ds.subset(
-    //        {{ {1, n_quad_angs}, {n_quad_angs, n_quad_angs} }});
-    Array<Float,2> gauss_wts_subset = gauss_wts.subset(
-            {{ {1, n_quad_angs}, {n_quad_angs, n_quad_angs} }});
+    const bool do_jacobians = (flux_up_jac.size() > 0);
 
-    Array<Float,3> secants({ncol, ngpt, n_quad_angs});
-    for (int imu=1; imu<=n_quad_angs; ++imu)
-        for (int igpt=1; igpt<=ngpt; ++igpt)
-            for (int icol=1; icol<=ncol; ++icol)
-                secants({icol, igpt, imu}) = gauss_Ds({imu, n_quad_angs});
-
-    const Bool do_broadband = (gpt_flux_up.dim(3) == 1) ? true : false;
-
-    // CvH: For now, just pass the arrays around. Could we reduce the array size?
-    const Bool do_jacobians = false;
-    Array<Float,2> sfc_src_jac(sources.get_sfc_source().get_dims());
-    Array<Float,3> gpt_flux_up_jac(gpt_flux_up.get_dims());
-
-    // Do not rescale and pass tau in twice in the last line to not trigger an exception.
-    const Bool do_rescaling = false;
-
-    rrtmgp_kernel_launcher::lw_solver_noscat_GaussQuad(
-            ncol, nlay, ngpt, top_at_1, n_quad_angs,
-            secants, gauss_wts_subset,
-            optical_props->get_tau(),
-            sources.get_lay_source(),
-            sources.get_lev_source_inc(), sources.get_lev_source_dec(),
-            sfc_emis_gpt, sources.get_sfc_source(),
-            inc_flux,
-            gpt_flux_up, gpt_flux_dn,
-            do_broadband, gpt_flux_up, gpt_flux_dn,
-            do_jacobians, sfc_src_jac, gpt_flux_up_jac,
-            do_rescaling, optical_props->get_tau(), optical_props->get_tau());
+    if (do_jacobians && scattering == Lw_scattering::Two_stream)
+        throw std::runtime_error("Surface temperature Jacobians are not available in the longwave two-stream solver");
+
+    // The Jacobian is written per level through a pointer, thus it has to be a contiguous (ncol, nlay+1) array.
+    if (do_jacobians)
+    {
+        const int ncol = optical_props->get_ncol();
+        const int nlay = optical_props->get_nlay();
+
+        if (flux_up_jac.get_dims() != std::array<int,2>{ncol, nlay+1})
+            throw std::runtime_error("Dimensions of the Jacobian do not match the optical properties");
+
+        if (!flux_up_jac.is_contiguous())
+            throw std::runtime_error("Surface temperature Jacobian requires a contiguous array");
+    }
+
+    // The scattering solvers need ssa and g, which throws for optical properties without them.
+    if (scattering == Lw_scattering::None && !do_jacobians)
+        lw_solver_noscat<false, false>(
+                top_at_1, secants, weights, n_quad_angs,
+                tau, tau, tau,
+                sources, sfc_emis, inc_flux, band_lims_gpt, flux_index,
+                gpt_flux_up, gpt_flux_dn, flux_up_jac);
+    else if (scattering == Lw_scattering::None)
+        lw_solver_noscat<false, true>(
+                top_at_1, secants, weights, n_quad_angs,
+                tau, tau, tau,
+                sources, sfc_emis, inc_flux, band_lims_gpt, flux_index,
+                gpt_flux_up, gpt_flux_dn, flux_up_jac);
+    else if (scattering == Lw_scattering::Rescaling && !do_jacobians)
+        lw_solver_noscat<true, false>(
+                top_at_1, secants, weights, n_quad_angs,
+                tau, optical_props->get_ssa(), optical_props->get_g(),
+                sources, sfc_emis, inc_flux, band_lims_gpt, flux_index,
+                gpt_flux_up, gpt_flux_dn, flux_up_jac);
+    else if (scattering == Lw_scattering::Rescaling)
+        lw_solver_noscat<true, true>(
+                top_at_1, secants, weights, n_quad_angs,
+                tau, optical_props->get_ssa(), optical_props->get_g(),
+                sources, sfc_emis, inc_flux, band_lims_gpt, flux_index,
+                gpt_flux_up, gpt_flux_dn, flux_up_jac);
+    else
+        lw_solver_2stream(
+                top_at_1,
+                tau, optical_props->get_ssa(), optical_props->get_g(),
+                sources, sfc_emis, inc_flux, band_lims_gpt, flux_index,
+                gpt_flux_up, gpt_flux_dn);
 
     // CvH: In the fortran code this call is here, I removed it for performance and flexibility.
     // fluxes->reduce(gpt_flux_up, gpt_flux_dn, optical_props, top_at_1);
 }
 
 
+void Rte_lw::update_flux_up(
+        const Array<Float,2>& flux_up_ref,
+        const Array<Float,2>& flux_up_jac,
+        const Array<Float,1>& t_sfc_ref,
+        const Array<Float,1>& t_sfc,
+        Array<Float,2>& flux_up)
+{
+    const int ncol = flux_up_ref.dim(1);
+    const int nlev = flux_up_ref.dim(2);
+
+    if (flux_up_jac.get_dims() != flux_up_ref.get_dims() || flux_up.get_dims() != flux_up_ref.get_dims()
+            || t_sfc_ref.dim(1) != ncol || t_sfc.dim(1) != ncol)
+        throw std::runtime_error("Dimensions of the fluxes, Jacobian and surface temperatures do not match");
+
+    if (!flux_up_ref.is_contiguous() || !flux_up_jac.is_contiguous() || !flux_up.is_contiguous())
+        throw std::runtime_error("Flux update requires contiguous arrays");
+
+    std::vector<Float> dt_sfc(ncol);
+    for (int icol=1; icol<=ncol; ++icol)
+        dt_sfc[icol-1] = t_sfc({icol}) - t_sfc_ref({icol});
+
+    for (int ilev=1; ilev<=nlev; ++ilev)
+    {
+        const Float* __restrict__ up_ref = flux_up_ref.ptr() + (ilev-1)*ncol;
+        const Float* __restrict__ jac = flux_up_jac.ptr() + (ilev-1)*ncol;
+        Float* __restrict__ up = flux_up.ptr() + (ilev-1)*ncol;
+
+        for (int icol=0; icol<ncol; ++icol)
+            up[icol] = up_ref[icol] + jac[icol]*dt_sfc[icol];
+    }
+}
+
+
+void Rte_lw::update_flux_up(
+        const Array<Float,2>& flux_up_ref,
+        const Array<Float,2>& flux_up_jac,
+        const Array<Float,1>& t_sfc_ref,
+        const Array<Float,1>& t_sfc,
+        const Array<Float,2>& flux_dn,
+        Array<Float,2>& flux_up,
+        Array<Float,2>& flux_net)
+{
+    if (flux_dn.get_dims() != flux_up_ref.get_dims() || flux_net.get_dims() != flux_up_ref.get_dims())
+        throw std::runtime_error("Dimensions of the fluxes, Jacobian and surface temperatures do not match");
+
+    update_flux_up(flux_up_ref, flux_up_jac, t_sfc_ref, t_sfc, flux_up);
+
+    for (int ilev=1; ilev<=flux_net.dim(2); ++ilev)
+        for (int icol=1; icol<=flux_net.dim(1); ++icol)
+            flux_net({icol, ilev}) = flux_dn({icol, ilev}) - flux_up({icol, ilev});
+}
+
+
 void Rte_lw::expand_and_transpose(
         const std::unique_ptr<Optical_props_arry>& ops,
         const Array<Float,2> arr_in,
@@ -22,75 +22,500 @@
  *
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 #include "Rte_sw.h"
 #include "Array.h"
 #include "Optical_props.h"
-#include "rrtmgp_kernels.h"
 
 
-namespace rrtmgp_kernel_launcher
+namespace
 {
-    template<typename Float>
-    void apply_BC(
-            int ncol, int nlay, int ngpt,
-            Bool top_at_1, Array<Float,3>& gpt_flux_dn)
+    // Pointer to the column row of a layer and g-point, columns are contiguous in all layouts.
+    inline const Float* row(const Array<Float,3>& array, const int ilay, const int igpt)
     {
-        rrtmgp_kernels::apply_BC_0(
-                &ncol, &nlay, &ngpt,
-                &top_at_1, gpt_flux_dn.ptr());
+        const std::array<int,3> strides = array.get_strides();
+        return array.ptr() + (ilay-1)*strides[1] + (igpt-1)*strides[2];
     }
 
-    template<typename Float>
-    void apply_BC(
-            int ncol, int nlay, int ngpt, Bool top_at_1,
-            const Array<Float,2>& inc_flux, Array<Float,3>& gpt_flux_dn)
+    // Cosine of the solar zenith angle in layer ilay, which is constant with height in plane-parallel geometry.
+    template<bool mu0_per_layer>
+    inline const Float* mu0_row(const Float* mu0, const Array<Float,2>& mu0_lay, const int ilay)
     {
-        rrtmgp_kernels::apply_BC_gpt(
-                &ncol, &nlay, &ngpt, &top_at_1,
-                const_cast<Float*>(inc_flux.ptr()), gpt_flux_dn.ptr());
+        return mu0_per_layer ? mu0_lay.ptr() + (ilay-1)*mu0_lay.dim(1) : mu0;
     }
 
-    template<typename Float>
-    void apply_BC(
-            int ncol, int nlay, int ngpt, Bool top_at_1,
-            const Array<Float,2>& inc_flux,
-            const Array<Float,1>& factor,
-            Array<Float,3>& gpt_flux)
+    // Direct beam without scattering, see sw_solver_noscat in mo_rte_solver_kernels.F90. Vectorized over
+    // the columns, with the g-points accumulated into a single slice if do_broadband.
+    template<bool mu0_per_layer>
+    void sw_solver_noscat(
+            const Bool top_at_1,
+            const Array<Float,3>& tau,
+            const Array<Float,1>& mu0,
+            const Array<Float,2>& mu0_lay,
+            const Array<Float,2>& inc_flux_dir,
+            const bool do_broadband,
+            Array<Float,3>& flux_dir)
     {
-        rrtmgp_kernels::apply_BC_factor(
-                &ncol, &nlay, &ngpt,
-                &top_at_1,
-                const_cast<Float*>(inc_flux.ptr()),
-                const_cast<Float*>(factor.ptr()),
-                gpt_flux.ptr());
+        const int ncol = tau.dim(1);
+        const int nlay = tau.dim(2);
+        const int ngpt = tau.dim(3);
+        const int nlev = nlay+1;
+
+        std::vector<Float> flux(ncol);
+
+        if (do_broadband)
+            flux_dir.fill(Float(0.));
+
+        for (int igpt=1; igpt<=ngpt; ++igpt)
+        {
+            Float* __restrict__ flux_dir_gpt = flux_dir.ptr() + (do_broadband ? 0 : (igpt-1)*ncol*nlev);
+            Float* __restrict__ flx = flux.data();
+            const Float* __restrict__ inc = inc_flux_dir.ptr() + (igpt-1)*ncol;
+
+            const int top_level = top_at_1 ? 1 : nlev;
+            Float* __restrict__ dir_top = flux_dir_gpt + (top_level-1)*ncol;
+
+            for (int icol=0; icol<ncol; ++icol)
+            {
+                flx[icol] = inc[icol]*mu0.ptr()[icol];
+                dir_top[icol] = do_broadband ? dir_top[icol] + flx[icol] : flx[icol];
+            }
+
+            for (int k=0; k<nlay; ++k)
+            {
+                const int ilay = top_at_1 ? k+1 : nlay-k;
+                const int ilev = top_at_1 ? k+2 : nlay-k;
+
+                const Float* __restrict__ tau_lay = row(tau, ilay, igpt);
+                const Float* __restrict__ mu0_s = mu0_row<mu0_per_layer>(mu0.ptr(), mu0_lay, ilay);
+                Float* __restrict__ dir = flux_dir_gpt + (ilev-1)*ncol;
+
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    flx[icol] *= std::exp(-tau_lay[icol]/mu0_s[icol]);
+                    dir[icol] = do_broadband ? dir[icol] + flx[icol] : flx[icol];
+                }
+            }
+        }
     }
 
-    template<typename Float>
+    // Diffuse reflectance and transmittance of a layer, Meador and Weaver (1980) with the PIFM coefficients
+    // of Zdunkowski et al. (1980), and the terms that are shared with the direct beam.
+    inline void sw_diffuse_rt(
+            const Float tau, const Float w0_s, const Float g_s,
+            Float& gamma1, Float& gamma2, Float& k_ms, Float& exp_minusktau, Float& rt_term,
+            Float& rdif, Float& tdif)
+    {
+        gamma1 = (Float(8.) - w0_s*(Float(5.) + Float(3.)*g_s)) * Float(.25);
+        gamma2 = Float(3.)*(w0_s*(Float(1.) - g_s)) * Float(.25);
+
+        k_ms = std::sqrt(std::max((gamma1 - gamma2)*(gamma1 + gamma2), Two_stream_k_min));
+
+        exp_minusktau = std::exp(-tau*k_ms);
+        const Float exp_minus2ktau = exp_minusktau*exp_minusktau;
+
+        rt_term = Float(1.) / (k_ms*(Float(1.) + exp_minus2ktau) + gamma1*(Float(1.) - exp_minus2ktau));
+
+        rdif = rt_term*gamma2*(Float(1.) - exp_minus2ktau);
+        tdif = rt_term*Float(2.)*k_ms*exp_minusktau;
+    }
+
+    // Reflectance and transmittance of the direct beam of a layer, and its transmittance without scattering.
+    inline void sw_direct_rt(
+            const Float tau, const Float w0_s, const Float g_s, const Float mu0_s,
+            const Float gamma1, const Float gamma2, const Float k_ms, const Float exp_minusktau, const Float rt_term_dif,
+            Float& r_dir, Float& t_dir, Float& t_noscat)
+    {
+        const Float eps = std::numeric_limits<Float>::epsilon();
+
+        const Float gamma3 = (Float(2.) - Float(3.)*mu0_s*g_s) * Float(.25);
+        const Float gamma4 = Float(1.) - gamma3;
+        const Float alpha1 = gamma1*gamma4 + gamma2*gamma3;
+        const Float alpha2 = gamma1*gamma3 + gamma2*gamma4;
+
+        const Float k_mu = k_ms*mu0_s;
+        const Float k_gamma3 = k_ms*gamma3;
+        const Float k_gamma4 = k_ms*gamma4;
+        const Float exp_minus2ktau = exp_minusktau*exp_minusktau;
+
+        const Float k_mu_term = Float(1.) - k_mu*k_mu;
+        const Float rt_term = w0_s*rt_term_dif / (std::abs(k_mu_term) >= eps ? k_mu_term : eps);
+
+        t_noscat = std::exp(-tau/mu0_s);
+        r_dir = rt_term*
+            ( (Float(1.) - k_mu)*(alpha2 + k_gamma3)
+            - (Float(1.) + k_mu)*(alpha2 - k_gamma3)*exp_minus2ktau
+            - Float(2.)*(k_gamma3 - alpha2*k_mu)*exp_minusktau*t_noscat );
+        t_dir = -rt_term*
+            ( (Float(1.) + k_mu)*(alpha1 + k_gamma4)*t_noscat
+            - (Float(1.) - k_mu)*(alpha1 - k_gamma4)*exp_minus2ktau*t_noscat
+            - Float(2.)*(k_gamma4 + alpha1*k_mu)*exp_minusktau );
+    }
+
+    // Work arrays of the two-stream solver, with the layers numbered from the top of the domain (k = 0).
+    struct Sw_2stream_buffers
+    {
+        Sw_2stream_buffers(const int ncol, const int nlay) :
+            rdif(ncol*nlay), tdif(ncol*nlay), source_up(ncol*nlay), source_dn(ncol*nlay), denom(ncol*nlay),
+            albedo(ncol*(nlay+1)), src(ncol*(nlay+1)), flux(ncol)
+        {}
+
+        std::vector<Float> rdif, tdif, source_up, source_dn, denom;
+        std::vector<Float> albedo, src;
+        std::vector<Float> flux;
+    };
+
+    // Two-stream solve of a single g-point, see sw_solver_2stream in mo_rte_solver_kernels.F90.
+    // The optical properties have a stride of lay_stride between the layers, the (ncol, nlev) fluxes
+    // are contiguous and flux_dn is the total downward flux. Vectorized over the columns.
+    template<bool mu0_per_layer>
+    void sw_solver_2stream_gpt(
+            const int ncol, const int nlay, const Bool top_at_1,
+            const Float* tau, const Float* ssa, const Float* g, const int lay_stride,
+            const Array<Float,1>& mu0, const Array<Float,2>& mu0_lay,
+            const Float* __restrict__ sfc_alb_dir, const Float* __restrict__ sfc_alb_dif,
+            const Float* __restrict__ inc_flux_dir, const Float* __restrict__ inc_flux_dif,
+            Float* flux_up, Float* flux_dn, Float* flux_dir,
+            Sw_2stream_buffers& buffers)
+    {
+        const int nlev = nlay+1;
+
+        // Boundary condition of the direct beam.
+        const int top_level = top_at_1 ? 1 : nlev;
+        Float* __restrict__ dir_top = flux_dir + (top_level-1)*ncol;
+
+        for (int icol=0; icol<ncol; ++icol)
+            dir_top[icol] = inc_flux_dir[icol]*mu0.ptr()[icol];
+
+        // Reflectance and transmittance of the layers and the source of diffuse radiation by the direct beam.
+        for (int k=0; k<nlay; ++k)
+        {
+            const int ilay = top_at_1 ? k+1 : nlay-k;
+            const int ilev_top = top_at_1 ? k+1 : nlay+1-k;
+            const int ilev_bot = top_at_1 ? k+2 : nlay-k;
+
+            const Float* __restrict__ tau_lay = tau + (ilay-1)*lay_stride;
+            const Float* __restrict__ ssa_lay = ssa + (ilay-1)*lay_stride;
+            const Float* __restrict__ g_lay   = g   + (ilay-1)*lay_stride;
+            const Float* __restrict__ mu0_lay_s = mu0_row<mu0_per_layer>(mu0.ptr(), mu0_lay, ilay);
+
+            Float* __restrict__ rdif = buffers.rdif.data() + k*ncol;
+            Float* __restrict__ tdif = buffers.tdif.data() + k*ncol;
+            Float* __restrict__ source_up = buffers.source_up.data() + k*ncol;
+            Float* __restrict__ source_dn = buffers.source_dn.data() + k*ncol;
+            const Float* __restrict__ dir_inc = flux_dir + (ilev_top-1)*ncol;
+            Float* __restrict__ dir_trans = flux_dir + (ilev_bot-1)*ncol;
+
+            for (int icol=0; icol<ncol; ++icol)
+            {
+                Float gamma1, gamma2, k_ms, exp_minusktau, rt_term;
+                sw_diffuse_rt(
+                        tau_lay[icol], ssa_lay[icol], g_lay[icol],
+                        gamma1, gamma2, k_ms, exp_minusktau, rt_term, rdif[icol], tdif[icol]);
+
+                Float r_dir, t_dir, t_noscat;
+                sw_direct_rt(
+                        tau_lay[icol], ssa_lay[icol], g_lay[icol], mu0_lay_s[icol],
+                        gamma1, gamma2, k_ms, exp_minusktau, rt_term, r_dir, t_dir, t_noscat);
+
+                source_up[icol] = r_dir*dir_inc[icol];
+                source_dn[icol] = t_dir*dir_inc[icol];
+                dir_trans[icol] = t_noscat*dir_inc[icol];
+            }
+        }
+
+        // Albedo and upward source below each level, from the surface up (Shonk and Hogan, 2008).
+        const int sfc_level = top_at_1 ? nlev : 1;
+        const Float* __restrict__ dir_sfc = flux_dir + (sfc_level-1)*ncol;
+
+        for (int icol=0; icol<ncol; ++icol)
+        {
+            buffers.albedo[nlay*ncol + icol] = sfc_alb_dif[icol];
+            buffers.src[nlay*ncol + icol] = dir_sfc[icol]*sfc_alb_dir[icol];
+        }
+
+        for (int k=nlay-1; k>=0; --k)
+        {
+            const Float* __restrict__ rdif = buffers.rdif.data() + k*ncol;
+            const Float* __restrict__ tdif = buffers.tdif.data() + k*ncol;
+            const Float* __restrict__ source_up = buffers.source_up.data() + k*ncol;
+            const Float* __restrict__ source_dn = buffers.source_dn.data() + k*ncol;
+            const Float* __restrict__ albedo_below = buffers.albedo.data() + (k+1)*ncol;
+            const Float* __restrict__ src_below = buffers.src.data() + (k+1)*ncol;
+
+            Float* __restrict__ denom = buffers.denom.data() + k*ncol;
+            Float* __restrict__ albedo = buffers.albedo.data() + k*ncol;
+            Float* __restrict__ src = buffers.src.data() + k*ncol;
+
+            for (int icol=0; icol<ncol; ++icol)
+            {
+                denom[icol] = Float(1.) / (Float(1.) - rdif[icol]*albedo_below[icol]);
+                albedo[icol] = rdif[icol] + tdif[icol]*tdif[icol]*albedo_below[icol]*denom[icol];
+                src[icol] = source_up[icol] + tdif[icol]*denom[icol]*(src_below[icol] + albedo_below[icol]*source_dn[icol]);
+            }
+        }
+
+        // Diffuse fluxes from the top of the domain down, the total downward flux includes the direct beam.
+        Float* __restrict__ flx = buffers.flux.data();
+        Float* __restrict__ dn_top = flux_dn + (top_level-1)*ncol;
+        Float* __restrict__ up_top = flux_up + (top_level-1)*ncol;
+
+        for (int icol=0; icol<ncol; ++icol)
+        {
+            flx[icol] = inc_flux_dif ? inc_flux_dif[icol] : Float(0.);
+            up_top[icol] = flx[icol]*buffers.albedo[icol] + buffers.src[icol];
+            dn_top[icol] = flx[icol] + dir_top[icol];
+        }
+
+        for (int k=0; k<nlay; ++k)
+        {
+            const int ilev = top_at_1 ? k+2 : nlay-k;
+
+            const Float* __restrict__ rdif = buffers.rdif.data() + k*ncol;
+            const Float* __restrict__ tdif = buffers.tdif.data() + k*ncol;
+            const Float* __restrict__ source_dn = buffers.source_dn.data() + k*ncol;
+            const Float* __restrict__ denom = buffers.denom.data() + k*ncol;
+            const Float* __restrict__ albedo = buffers.albedo.data() + (k+1)*ncol;
+            const Float* __restrict__ src = buffers.src.data() + (k+1)*ncol;
+            const Float* __restrict__ dir = flux_dir + (ilev-1)*ncol;
+
+            Float* __restrict__ dn = flux_dn + (ilev-1)*ncol;
+            Float* __restrict__ up = flux_up + (ilev-1)*ncol;
+
+            for (int icol=0; icol<ncol; ++icol)
+            {
+                flx[icol] = (tdif[icol]*flx[icol] + rdif[icol]*src[icol] + source_dn[icol])*denom[icol];
+                up[icol] = flx[icol]*albedo[icol] + src[icol];
+                dn[icol] = flx[icol] + dir[icol];
+            }
+        }
+    }
+
+    // Two-stream solve of all g-points, with the fluxes accumulated into a single slice if do_broadband.
+    template<bool mu0_per_layer, class Gpt_optical_props>
     void sw_solver_2stream(
-            int ncol, int nlay, int ngpt, Bool top_at_1,
-            const Array<Float,3>& tau,
-            const Array<Float,3>& ssa,
-            const Array<Float,3>& g,
-            const Array<Float,2>& mu0,
+            const int ncol, const int nlay, const int ngpt, const Bool top_at_1,
+            Gpt_optical_props&& gpt_optical_props,
+            const Array<Float,1>& mu0, const Array<Float,2>& mu0_lay,
             const Array<Float,2>& sfc_alb_dir_gpt, const Array<Float,2>& sfc_alb_dif_gpt,
-            const Array<Float,2>& inc_flux,
-            Array<Float,3>& gpt_flux_up, Array<Float,3>& gpt_flux_dn, Array<Float,3>& gpt_flux_dir,
-            Bool has_dif_bc, const Array<Float,2>& inc_flux_dif,
-            Bool do_broadband, Array<Float,3>& flux_up_loc, Array<Float,3>& flux_dn_loc, Array<Float,3>& flux_dir_loc)
+            const Array<Float,2>& inc_flux_dir, const Array<Float,2>& inc_flux_dif,
+            Array<Float,3>& gpt_flux_up, Array<Float,3>& gpt_flux_dn, Array<Float,3>& gpt_flux_dir)
+    {
+        const int nlev = nlay+1;
+        const bool do_broadband = (gpt_flux_up.dim(3) == 1);
+        const bool has_dif_bc = (inc_flux_dif.size() > 0);
+
+        Sw_2stream_buffers buffers(ncol, nlay);
+
+        // In broadband mode the g-point fluxes are accumulated into the output.
+        std::vector<Float> flux_up_loc, flux_dn_loc, flux_dir_loc;
+
+        if (do_broadband)
+        {
+            flux_up_loc .resize(ncol*nlev);
+            flux_dn_loc .resize(ncol*nlev);
+            flux_dir_loc.resize(ncol*nlev);
+
+            gpt_flux_up .fill(Float(0.));
+            gpt_flux_dn .fill(Float(0.));
+            gpt_flux_dir.fill(Float(0.));
+        }
+
+        for (int igpt=1; igpt<=ngpt; ++igpt)
+        {
+            const Float* tau;
+            const Float* ssa;
+            const Float* g;
+            int lay_stride;
+            gpt_optical_props(igpt, tau, ssa, g, lay_stride);
+
+            const int offset_flux = (igpt-1)*ncol*nlev;
+            Float* flux_up  = do_broadband ? flux_up_loc .data() : gpt_flux_up .ptr() + offset_flux;
+            Float* flux_dn  = do_broadband ? flux_dn_loc .data() : gpt_flux_dn .ptr() + offset_flux;
+            Float* flux_dir = do_broadband ? flux_dir_loc.data() : gpt_flux_dir.ptr() + offset_flux;
+
+            sw_solver_2stream_gpt<mu0_per_layer>(
+                    ncol, nlay, top_at_1,
+                    tau, ssa, g, lay_stride,
+                    mu0, mu0_lay,
+                    sfc_alb_dir_gpt.ptr() + (igpt-1)*ncol,
+                    sfc_alb_dif_gpt.ptr() + (igpt-1)*ncol,
+                    inc_flux_dir.ptr() + (igpt-1)*ncol,
+                    has_dif_bc ? inc_flux_dif.ptr() + (igpt-1)*ncol : nullptr,
+                    flux_up, flux_dn, flux_dir,
+                    buffers);
+
+            if (do_broadband)
+            {
+                for (int i=0; i<ncol*nlev; ++i)
+                {
+                    gpt_flux_up .ptr()[i] += flux_up [i];
+                    gpt_flux_dn .ptr()[i] += flux_dn [i];
+                    gpt_flux_dir.ptr()[i] += flux_dir[i];
+                }
+            }
+        }
+    }
+
+    // Work arrays of the batched two-stream solver, with the terms that do not depend on the scenario per
+    // column and the others per scenario and column.
+    struct Sw_2stream_batched_buffers
     {
-        rrtmgp_kernels::rte_sw_solver_2stream(
-                &ncol, &nlay, &ngpt, &top_at_1,
-                const_cast<Float*>(tau.ptr()),
-                const_cast<Float*>(ssa.ptr()),
-                const_cast<Float*>(g  .ptr()),
-                const_cast<Float*>(mu0.ptr()),
-                const_cast<Float*>(sfc_alb_dir_gpt.ptr()),
-                const_cast<Float*>(sfc_alb_dif_gpt.ptr()),
-                const_cast<Float*>(inc_flux.ptr()),
-                gpt_flux_up.ptr(), gpt_flux_dn.ptr(), gpt_flux_dir.ptr(),
-                &has_dif_bc, const_cast<Float*>(inc_flux_dif.ptr()),
-                &do_broadband, flux_up_loc.ptr(), flux_dn_loc.ptr(), flux_dir_loc.ptr());
+        Sw_2stream_batched_buffers(const int ncol, const int nlay, const int nscen) :
+            gamma1(ncol), gamma2(ncol), k_ms(ncol), exp_minusktau(ncol), rt_term(ncol),
+            rdif(ncol*nlay), tdif(ncol*nlay),
+            source_up(nscen*ncol*nlay), source_dn(nscen*ncol*nlay), denom(nscen*ncol*nlay),
+            albedo(nscen*ncol*(nlay+1)), src(nscen*ncol*(nlay+1)), flux(nscen*ncol)
+        {}
+
+        std::vector<Float> gamma1, gamma2, k_ms, exp_minusktau, rt_term;
+        std::vector<Float> rdif, tdif;
+        std::vector<Float> source_up, source_dn, denom;
+        std::vector<Float> albedo, src;
+        std::vector<Float> flux;
+    };
+
+    // Two-stream solve of a single g-point for nscen scenarios of solar geometry and surface that share the
+    // optical properties. The (nscen, ncol) slices have the scenario as the fastest dimension, thus the optical
+    // properties and the diffuse layer terms are read and computed once per column, and the scenarios vectorize.
+    void sw_solver_2stream_gpt_batched(
+            const int ncol, const int nlay, const int nscen, const Bool top_at_1,
+            const Float* tau, const Float* ssa, const Float* g, const int lay_stride,
+            const Float* __restrict__ mu0,
+            const Float* __restrict__ sfc_alb_dir, const Float* __restrict__ sfc_alb_dif,
+            const Float* __restrict__ inc_flux_dir,
+            Float* flux_up, Float* flux_dn, Float* flux_dir,
+            Sw_2stream_batched_buffers& buffers)
+    {
+        const int nlev = nlay+1;
+        const int nv = nscen*ncol;
+
+        const int top_level = top_at_1 ? 1 : nlev;
+        Float* __restrict__ dir_top = flux_dir + (top_level-1)*nv;
+
+        for (int iv=0; iv<nv; ++iv)
+            dir_top[iv] = inc_flux_dir[iv]*mu0[iv];
+
+        Float* __restrict__ gamma1 = buffers.gamma1.data();
+        Float* __restrict__ gamma2 = buffers.gamma2.data();
+        Float* __restrict__ k_ms = buffers.k_ms.data();
+        Float* __restrict__ exp_minusktau = buffers.exp_minusktau.data();
+        Float* __restrict__ rt_term = buffers.rt_term.data();
+
+        for (int k=0; k<nlay; ++k)
+        {
+            const int ilay = top_at_1 ? k+1 : nlay-k;
+            const int ilev_top = top_at_1 ? k+1 : nlay+1-k;
+            const int ilev_bot = top_at_1 ? k+2 : nlay-k;
+
+            const Float* __restrict__ tau_lay = tau + (ilay-1)*lay_stride;
+            const Float* __restrict__ ssa_lay = ssa + (ilay-1)*lay_stride;
+            const Float* __restrict__ g_lay   = g   + (ilay-1)*lay_stride;
+
+            Float* __restrict__ rdif = buffers.rdif.data() + k*ncol;
+            Float* __restrict__ tdif = buffers.tdif.data() + k*ncol;
+            Float* __restrict__ source_up = buffers.source_up.data() + k*nv;
+            Float* __restrict__ source_dn = buffers.source_dn.data() + k*nv;
+            const Float* __restrict__ dir_inc = flux_dir + (ilev_top-1)*nv;
+            Float* __restrict__ dir_trans = flux_dir + (ilev_bot-1)*nv;
+
+            for (int icol=0; icol<ncol; ++icol)
+                sw_diffuse_rt(
+                        tau_lay[icol], ssa_lay[icol], g_lay[icol],
+                        gamma1[icol], gamma2[icol], k_ms[icol], exp_minusktau[icol], rt_term[icol],
+                        rdif[icol], tdif[icol]);
+
+            for (int icol=0; icol<ncol; ++icol)
+                for (int iscen=0; iscen<nscen; ++iscen)
+                {
+                    const int iv = icol*nscen + iscen;
+
+                    Float r_dir, t_dir, t_noscat;
+                    sw_direct_rt(
+                            tau_lay[icol], ssa_lay[icol], g_lay[icol], mu0[iv],
+                            gamma1[icol], gamma2[icol], k_ms[icol], exp_minusktau[icol], rt_term[icol],
+                            r_dir, t_dir, t_noscat);
+
+                    source_up[iv] = r_dir*dir_inc[iv];
+                    source_dn[iv] = t_dir*dir_inc[iv];
+                    dir_trans[iv] = t_noscat*dir_inc[iv];
+                }
+        }
+
+        const int sfc_level = top_at_1 ? nlev : 1;
+        const Float* __restrict__ dir_sfc = flux_dir + (sfc_level-1)*nv;
+
+        for (int iv=0; iv<nv; ++iv)
+        {
+            buffers.albedo[nlay*nv + iv] = sfc_alb_dif[iv];
+            buffers.src[nlay*nv + iv] = dir_sfc[iv]*sfc_alb_dir[iv];
+        }
+
+        for (int k=nlay-1; k>=0; --k)
+        {
+            const Float* __restrict__ rdif = buffers.rdif.data() + k*ncol;
+            const Float* __restrict__ tdif = buffers.tdif.data() + k*ncol;
+            const Float* __restrict__ source_up = buffers.source_up.data() + k*nv;
+            const Float* __restrict__ source_dn = buffers.source_dn.data() + k*nv;
+            const Float* __restrict__ albedo_below = buffers.albedo.data() + (k+1)*nv;
+            const Float* __restrict__ src_below = buffers.src.data() + (k+1)*nv;
+
+            Float* __restrict__ denom = buffers.denom.data() + k*nv;
+            Float* __restrict__ albedo = buffers.albedo.data() + k*nv;
+            Float* __restrict__ src = buffers.src.data() + k*nv;
+
+            for (int icol=0; icol<ncol; ++icol)
+                for (int iscen=0; iscen<nscen; ++iscen)
+                {
+                    const int iv = icol*nscen + iscen;
+                    denom[iv] = Float(1.) / (Float(1.) - rdif[icol]*albedo_below[iv]);
+                    albedo[iv] = rdif[icol] + tdif[icol]*tdif[icol]*albedo_below[iv]*denom[iv];
+                    src[iv] = source_up[iv] + tdif[icol]*denom[iv]*(src_below[iv] + albedo_below[iv]*source_dn[iv]);
+                }
+        }
+
+        // There is no diffuse radiation entering at the top of the domain.
+        Float* __restrict__ flx = buffers.flux.data();
+        Float* __restrict__ dn_top = flux_dn + (top_level-1)*nv;
+        Float* __restrict__ up_top = flux_up + (top_level-1)*nv;
+
+        for (int iv=0; iv<nv; ++iv)
+        {
+            flx[iv] = Float(0.);
+            up_top[iv] = buffers.src[iv];
+            dn_top[iv] = dir_top[iv];
+        }
+
+        for (int k=0; k<nlay; ++k)
+        {
+            const int ilev = top_at_1 ? k+2 : nlay-k;
+
+            const Float* __restrict__ rdif = buffers.rdif.data() + k*ncol;
+            const Float* __restrict__ tdif = buffers.tdif.data() + k*ncol;
+            const Float* __restrict__ source_dn = buffers.source_dn.data() + k*nv;
+            const Float* __restrict__ denom = buffers.denom.data() + k*nv;
+            const Float* __restrict__ albedo = buffers.albedo.data() + (k+1)*nv;
+            const Float* __restrict__ src = buffers.src.data() + (k+1)*nv;
+            const Float* __restrict__ dir = flux_dir + (ilev-1)*nv;
+
+            Float* __restrict__ dn = flux_dn + (ilev-1)*nv;
+            Float* __restrict__ up = flux_up + (ilev-1)*nv;
+
+            for (int icol=0; icol<ncol; ++icol)
+                for (int iscen=0; iscen<nscen; ++iscen)
+                {
+                    const int iv = icol*nscen + iscen;
+                    flx[iv] = (tdif[icol]*flx[iv] + rdif[icol]*src[iv] + source_dn[iv])*denom[iv];
+                    up[iv] = flx[iv]*albedo[iv] + src[iv];
+                    dn[iv] = flx[iv] + dir[iv];
+                }
+        }
     }
+
 }
 
 
@@ -105,58 +530,228 @@ void Rte_sw::rte_sw(
         Array<Float,3>& gpt_flux_up,
         Array<Float,3>& gpt_flux_dn,
         Array<Float,3>& gpt_flux_dir)
+{
+    rte_sw(optical_props, top_at_1, mu0, Array<Float,2>(), inc_flux_dir,
+           sfc_alb_dir, sfc_alb_dif, inc_flux_dif,
+           gpt_flux_up, gpt_flux_dn, gpt_flux_dir);
+}
+
+
+void Rte_sw::rte_sw(
+        const std::unique_ptr<Optical_props_arry>& optical_props,
+        const Bool top_at_1,
+        const Array<Float,1>& mu0,
+        const Array<Float,2>& mu0_lay,
+        const Array<Float,2>& inc_flux_dir,
+        const Array<Float,2>& sfc_alb_dir,
+        const Array<Float,2>& sfc_alb_dif,
+        const Array<Float,2>& inc_flux_dif,
+        Array<Float,3>& gpt_flux_up,
+        Array<Float,3>& gpt_flux_dn,
+        Array<Float,3>& gpt_flux_dir)
 {
     const int ncol = optical_props->get_ncol();
     const int nlay = optical_props->get_nlay();
     const int ngpt = optical_props->get_ngpt();
 
+    const bool mu0_per_layer = (mu0_lay.size() > 0);
+
+    // The solvers read mu0_lay per layer through a pointer, thus a mismatch has to throw here.
+    if (mu0_per_layer && (mu0_lay.get_dims() != std::array<int,2>{ncol, nlay} || !mu0_lay.is_contiguous()))
+        throw std::runtime_error("The layer mu0 has to be a contiguous (ncol, nlay) array");
+
+    // Optical properties without ssa and g only give the direct beam, the diffuse fluxes are zero.
+    if (dynamic_cast<Optical_props_1scl*>(optical_props.get()))
+    {
+        if (inc_flux_dif.size() > 0)
+            throw std::runtime_error("Incoming diffuse flux is not available in the direct-beam solver");
+
+        const bool do_broadband = (gpt_flux_dir.dim(3) == 1);
+
+        if (mu0_per_layer)
+            sw_solver_noscat<true>(top_at_1, optical_props->get_tau(), mu0, mu0_lay, inc_flux_dir, do_broadband, gpt_flux_dir);
+        else
+            sw_solver_noscat<false>(top_at_1, optical_props->get_tau(), mu0, mu0_lay, inc_flux_dir, do_broadband, gpt_flux_dir);
+
+        if (gpt_flux_up.size() > 0)
+            gpt_flux_up.fill(Float(0.));
+        if (gpt_flux_dn.size() > 0)
+            gpt_flux_dn = gpt_flux_dir;
+
+        return;
+    }
+
     Array<Float,2> sfc_alb_dir_gpt({ncol, ngpt});
     Array<Float,2> sfc_alb_dif_gpt({ncol, ngpt});
 
     expand_and_transpose(optical_props, sfc_alb_dir, sfc_alb_dir_gpt);
     expand_and_transpose(optical_props, sfc_alb_dif, sfc_alb_dif_gpt);
 
+    // The optical properties are read in place, strided layouts included.
+    const Array<Float,3>& tau = optical_props->get_tau();
+    const Array<Float,3>& ssa = optical_props->get_ssa();
+    const Array<Float,3>& g   = optical_props->get_g  ();
+
+    auto gpt_optical_props = [&](
+            const int igpt, const Float*& tau_gpt, const Float*& ssa_gpt, const Float*& g_gpt, int& lay_stride)
+    {
+        tau_gpt = row(tau, 1, igpt);
+        ssa_gpt = row(ssa, 1, igpt);
+        g_gpt   = row(g  , 1, igpt);
+        lay_stride = tau.get_strides()[1];
+    };
 
-    // CvH: first, we only run with constant mu0 with height, thus we copy into height.
-    Array<Float,2> mu0_2d({ncol, nlay});
-    for (int j=1; j<=nlay; ++j)
-        for (int i=1; i<=ncol; ++i)
-            mu0_2d({i, j}) = mu0({i});
-
-    // Run the radiative transfer solver
-    // CvH: only two-stream solutions, I skipped the sw_solver_noscat
-    const Bool has_dif_bc = (inc_flux_dif.size() > 0);
-    const Bool do_broadband = (gpt_flux_up.dim(3) == 1) ? true : false;
-
-    rrtmgp_kernel_launcher::sw_solver_2stream(
-            ncol, nlay, ngpt, top_at_1,
-            optical_props->get_tau(),
-            optical_props->get_ssa(),
-            optical_props->get_g  (),
-            mu0_2d,
-            sfc_alb_dir_gpt, sfc_alb_dif_gpt,
-            inc_flux_dir,
-            gpt_flux_up, gpt_flux_dn, gpt_flux_dir,
-            has_dif_bc, inc_flux_dif,
-            do_broadband, gpt_flux_up, gpt_flux_dn, gpt_flux_dir);
+    if (mu0_per_layer)
+        sw_solver_2stream<true>(
+                ncol, nlay, ngpt, top_at_1, gpt_optical_props, mu0, mu0_lay,
+                sfc_alb_dir_gpt, sfc_alb_dif_gpt, inc_flux_dir, inc_flux_dif,
+                gpt_flux_up, gpt_flux_dn, gpt_flux_dir);
+    else
+        sw_solver_2stream<false>(
+                ncol, nlay, ngpt, top_at_1, gpt_optical_props, mu0, mu0_lay,
+                sfc_alb_dir_gpt, sfc_alb_dif_gpt, inc_flux_dir, inc_flux_dif,
+                gpt_flux_up, gpt_flux_dn, gpt_flux_dir);
 
     // CvH: The original fortran code had a call to the reduce here.
     // fluxes->reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dir, optical_props, top_at_1);
 }
 
 
+void Rte_sw::rte_sw(
+        const Optical_props_2str_combined& optical_props,
+        const Bool top_at_1,
+        const Array<Float,1>& mu0,
+        const Array<Float,2>& inc_flux_dir,
+        const Array<Float,2>& sfc_alb_dir,
+        const Array<Float,2>& sfc_alb_dif,
+        const Array<Float,2>& inc_flux_dif,
+        Array<Float,3>& gpt_flux_up,
+        Array<Float,3>& gpt_flux_dn,
+        Array<Float,3>& gpt_flux_dir)
+{
+    const int ncol = optical_props.get_ncol();
+    const int nlay = optical_props.get_nlay();
+    const int ngpt = optical_props.get_ngpt();
+
+    Array<Float,2> sfc_alb_dir_gpt({ncol, ngpt});
+    Array<Float,2> sfc_alb_dif_gpt({ncol, ngpt});
+
+    expand_and_transpose(optical_props, sfc_alb_dir, sfc_alb_dir_gpt);
+    expand_and_transpose(optical_props, sfc_alb_dif, sfc_alb_dif_gpt);
+
+    // Only a single g-point of combined optical properties is alive at a time.
+    Array<Float,2> tau({ncol, nlay});
+    Array<Float,2> ssa({ncol, nlay});
+    Array<Float,2> g  ({ncol, nlay});
+
+    auto gpt_optical_props = [&](
+            const int igpt, const Float*& tau_gpt, const Float*& ssa_gpt, const Float*& g_gpt, int& lay_stride)
+    {
+        optical_props.combine_gpt(igpt, tau, ssa, g);
+        tau_gpt = tau.ptr();
+        ssa_gpt = ssa.ptr();
+        g_gpt   = g  .ptr();
+        lay_stride = ncol;
+    };
+
+    sw_solver_2stream<false>(
+            ncol, nlay, ngpt, top_at_1, gpt_optical_props, mu0, Array<Float,2>(),
+            sfc_alb_dir_gpt, sfc_alb_dif_gpt, inc_flux_dir, inc_flux_dif,
+            gpt_flux_up, gpt_flux_dn, gpt_flux_dir);
+}
+
+
 void Rte_sw::expand_and_transpose(
         const std::unique_ptr<Optical_props_arry>& ops,
         const Array<Float,2> arr_in,
         Array<Float,2>& arr_out)
+{
+    expand_and_transpose(*ops, arr_in, arr_out);
+}
+
+
+void Rte_sw::expand_and_transpose(
+        const Optical_props& ops,
+        const Array<Float,2> arr_in,
+        Array<Float,2>& arr_out)
 {
     const int ncol = arr_in.dim(2);
-    const int nband = ops->get_nband();
+    const int nband = ops.get_nband();
 
-    Array<int,2> limits = ops->get_band_lims_gpoint();
+    Array<int,2> limits = ops.get_band_lims_gpoint();
 
     for (int iband=1; iband<=nband; ++iband)
         for (int icol=1; icol<=ncol; ++icol)
             for (int igpt=limits({1, iband}); igpt<=limits({2, iband}); ++igpt)
                 arr_out({icol, igpt}) = arr_in({iband, icol});
 }
+
+
+void Rte_sw::rte_sw_batched(
+        const std::unique_ptr<Optical_props_arry>& optical_props,
+        const Bool top_at_1,
+        const Array<Float,2>& mu0,
+        const Array<Float,3>& inc_flux_dir,
+        const Array<Float,3>& sfc_alb_dir,
+        const Array<Float,3>& sfc_alb_dif,
+        Array<Float,3>& flux_up,
+        Array<Float,3>& flux_dn,
+        Array<Float,3>& flux_dir)
+{
+    const int ncol = optical_props->get_ncol();
+    const int nlay = optical_props->get_nlay();
+    const int ngpt = optical_props->get_ngpt();
+    const int nbnd = optical_props->get_nband();
+    const int nscen = mu0.dim(1);
+    const int nlev = nlay+1;
+    const int nv = nscen*ncol;
+
+    // The kernel reads and writes all arrays without bounds checks, thus a mismatch has to throw here.
+    const std::array<int,3> dims_gpt = {nscen, ncol, ngpt};
+    const std::array<int,3> dims_bnd = {nscen, ncol, nbnd};
+    const std::array<int,3> dims_lev = {nscen, ncol, nlev};
+
+    if (mu0.dim(2) != ncol || inc_flux_dir.get_dims() != dims_gpt
+            || sfc_alb_dir.get_dims() != dims_bnd || sfc_alb_dif.get_dims() != dims_bnd
+            || flux_up.get_dims() != dims_lev || flux_dn.get_dims() != dims_lev || flux_dir.get_dims() != dims_lev)
+        throw std::runtime_error("Scenario dimensions of the batched shortwave solver do not match");
+
+    if (dynamic_cast<Optical_props_2str*>(optical_props.get()) == nullptr)
+        throw std::runtime_error("Batched shortwave solver requires two-stream optical properties");
+
+    const Array<Float,3>& tau = optical_props->get_tau();
+    const Array<Float,3>& ssa = optical_props->get_ssa();
+    const Array<Float,3>& g   = optical_props->get_g  ();
+    const int lay_stride = tau.get_strides()[1];
+
+    Sw_2stream_batched_buffers buffers(ncol, nlay, nscen);
+
+    std::vector<Float> flux_up_loc(nv*nlev), flux_dn_loc(nv*nlev), flux_dir_loc(nv*nlev);
+
+    flux_up .fill(Float(0.));
+    flux_dn .fill(Float(0.));
+    flux_dir.fill(Float(0.));
+
+    // The albedos are read per band, which saves their expansion to the g-points.
+    const Array<int,2>& band_lims_gpt = optical_props->get_band_lims_gpoint();
+
+    for (int ibnd=1; ibnd<=nbnd; ++ibnd)
+        for (int igpt=band_lims_gpt({1, ibnd}); igpt<=band_lims_gpt({2, ibnd}); ++igpt)
+        {
+            sw_solver_2stream_gpt_batched(
+                    ncol, nlay, nscen, top_at_1,
+                    row(tau, 1, igpt), row(ssa, 1, igpt), row(g, 1, igpt), lay_stride,
+                    mu0.ptr(),
+                    sfc_alb_dir.ptr() + (ibnd-1)*nv, sfc_alb_dif.ptr() + (ibnd-1)*nv,
+                    inc_flux_dir.ptr() + (igpt-1)*nv,
+                    flux_up_loc.data(), flux_dn_loc.data(), flux_dir_loc.data(),
+                    buffers);
+
+            for (int i=0; i<nv*nlev; ++i)
+            {
+                flux_up .ptr()[i] += flux_up_loc [i];
+                flux_dn .ptr()[i] += flux_dn_loc [i];
+                flux_dir.ptr()[i] += flux_dir_loc[i];
+            }
+        }
+}
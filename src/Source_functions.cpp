@@ -40,39 +40,48 @@ Source_func_lw::Source_func_lw(
 {}
 
 
+Source_func_lw::Source_func_lw(
+        Array<Float,2>& sfc_source,
+        Array<Float,3>& lay_source,
+        Array<Float,3>& lev_source_inc,
+        Array<Float,3>& lev_source_dec,
+        const Optical_props& optical_props) :
+    Optical_props(optical_props),
+    sfc_source(sfc_source.view()),
+    sfc_source_jac(sfc_source.get_dims()),
+    lay_source(lay_source.view()),
+    lev_source_inc(lev_source_inc.view()),
+    lev_source_dec(lev_source_dec.view())
+{}
+
+
 void Source_func_lw::set_subset(
         const Source_func_lw& sources_sub,
         const int col_s, const int col_e)
 {
-    for (int igpt=1; igpt<=lay_source.dim(3); ++igpt)
-        for (int icol=col_s; icol<=col_e; ++icol)
-            sfc_source({icol, igpt}) = sources_sub.get_sfc_source()({icol-col_s+1, igpt});
+    const int n_lay = lay_source.dim(2);
+    const int n_gpt = lay_source.dim(3);
+
+    sfc_source.subset_view({{ {col_s, col_e}, {1, n_gpt} }}) = sources_sub.get_sfc_source();
 
-    for (int igpt=1; igpt<=lay_source.dim(3); ++igpt)
-        for (int ilay=1; ilay<=lay_source.dim(2); ++ilay)
-            for (int icol=col_s; icol<=col_e; ++icol)
-            {
-                lay_source    ({icol, ilay, igpt}) = sources_sub.get_lay_source()    ({icol-col_s+1, ilay, igpt});
-                lev_source_inc({icol, ilay, igpt}) = sources_sub.get_lev_source_inc()({icol-col_s+1, ilay, igpt});
-                lev_source_dec({icol, ilay, igpt}) = sources_sub.get_lev_source_dec()({icol-col_s+1, ilay, igpt});
-            }
+    const std::array<std::pair<int, int>, 3> cols = {{ {col_s, col_e}, {1, n_lay}, {1, n_gpt} }};
+    lay_source    .subset_view(cols) = sources_sub.get_lay_source();
+    lev_source_inc.subset_view(cols) = sources_sub.get_lev_source_inc();
+    lev_source_dec.subset_view(cols) = sources_sub.get_lev_source_dec();
 }
 
 
 void Source_func_lw::get_subset(
-        const Source_func_lw& sources_sub,
+        Source_func_lw& sources_sub,
         const int col_s, const int col_e)
 {
-    for (int igpt=1; igpt<=lay_source.dim(3); ++igpt)
-        for (int icol=col_s; icol<=col_e; ++icol)
-            sfc_source({icol-col_s+1, igpt}) = sources_sub.get_sfc_source()({icol, igpt});
+    const int n_lay = lay_source.dim(2);
+    const int n_gpt = lay_source.dim(3);
+
+    sfc_source = sources_sub.get_sfc_source().subset_view({{ {col_s, col_e}, {1, n_gpt} }});
 
-    for (int igpt=1; igpt<=lay_source.dim(3); ++igpt)
-        for (int ilay=1; ilay<=lay_source.dim(2); ++ilay)
-            for (int icol=col_s; icol<=col_e; ++icol)
-            {
-                lay_source    ({icol-col_s+1, ilay, igpt}) = sources_sub.get_lay_source()    ({icol, ilay, igpt});
-                lev_source_inc({icol-col_s+1, ilay, igpt}) = sources_sub.get_lev_source_inc()({icol, ilay, igpt});
-                lev_source_dec({icol-col_s+1, ilay, igpt}) = sources_sub.get_lev_source_dec()({icol, ilay, igpt});
-            }
+    const std::array<std::pair<int, int>, 3> cols = {{ {col_s, col_e}, {1, n_lay}, {1, n_gpt} }};
+    lay_source     = sources_sub.get_lay_source()    .subset_view(cols);
+    lev_source_inc = sources_sub.get_lev_source_inc().subset_view(cols);
+    lev_source_dec = sources_sub.get_lev_source_dec().subset_view(cols);
 }
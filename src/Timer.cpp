@@ -0,0 +1,541 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Timer.h"
+
+
+namespace
+{
+    // Cycles, instructions, last-level cache misses and the optional floating point event.
+    constexpr int n_hw_events = 4;
+    using Hw_counts = std::array<long long, n_hw_events>;
+    const char* hw_event_names[n_hw_events] = {"cycles", "instructions", "llc_misses", "fp_ops"};
+
+    struct Node
+    {
+        const char* name;
+        int parent;
+        std::vector<int> children;
+
+        long long calls = 0;
+        double time_total = 0.;
+        double time_min = 0.;
+        double time_max = 0.;
+
+        // A node is open at most once per thread, so the counts at entry can be kept here.
+        bool hw_open = false;
+        Hw_counts hw_start = {};
+        Hw_counts hw_total = {};
+    };
+
+    struct Thread_data
+    {
+        int thread_id;
+        std::vector<Node> nodes;
+        int current = 0;
+        std::map<std::string, long long> counters;
+
+        // Leader of the perf event group of this thread, -1 if not opened (yet).
+        bool hw_tried = false;
+        int hw_fd = -1;
+        std::vector<int> hw_fds;
+
+        ~Thread_data()
+        {
+            #ifdef __linux__
+            for (const int fd : hw_fds)
+                close(fd);
+            #endif
+        }
+    };
+
+    std::atomic<bool> timer_enabled(false);
+    std::atomic<bool> hw_enabled(false);
+    unsigned long long hw_fp_event = 0;
+
+    // The thread data is owned here, so that it outlives the threads that recorded it.
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<Thread_data>> registry;
+
+    Thread_data& get_thread_data()
+    {
+        thread_local Thread_data* thread_data = nullptr;
+
+        if (thread_data == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+
+            registry.emplace_back(std::make_unique<Thread_data>());
+            thread_data = registry.back().get();
+            thread_data->thread_id = registry.size() - 1;
+            thread_data->nodes.push_back({"", -1, {}});
+        }
+
+        return *thread_data;
+    }
+
+    int find_or_add_child(Thread_data& data, const char* name)
+    {
+        // Names are mostly literals, so the pointer comparison usually hits.
+        for (const int child : data.nodes[data.current].children)
+        {
+            const char* child_name = data.nodes[child].name;
+            if (child_name == name || std::strcmp(child_name, name) == 0)
+                return child;
+        }
+
+        const int child = data.nodes.size();
+        data.nodes.push_back({name, data.current, {}});
+        data.nodes[data.current].children.push_back(child);
+        return child;
+    }
+
+    #ifdef __linux__
+    int open_hw_event(const uint32_t type, const uint64_t config, const int group_fd)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = group_fd == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        // Count the calling thread only, on any cpu.
+        return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+    #endif
+
+    // Open the counters of the calling thread as one group, so that they are scheduled together.
+    bool open_hw_counters(Thread_data& data)
+    {
+        data.hw_tried = true;
+
+        #ifdef __linux__
+        const int fd = open_hw_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (fd < 0)
+            return false;
+        data.hw_fds.push_back(fd);
+
+        const std::array<std::pair<uint32_t, uint64_t>, 3> events {{
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+            { PERF_TYPE_RAW, hw_fp_event } }};
+
+        for (const auto& event : events)
+        {
+            // The floating point event is model specific and only counted if it is given.
+            if (event.first == PERF_TYPE_RAW && hw_fp_event == 0)
+                break;
+
+            const int fd_event = open_hw_event(event.first, event.second, fd);
+            if (fd_event < 0)
+            {
+                for (const int f : data.hw_fds)
+                    close(f);
+                data.hw_fds.clear();
+                return false;
+            }
+            data.hw_fds.push_back(fd_event);
+        }
+
+        ioctl(fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+        data.hw_fd = fd;
+        return true;
+        #else
+        return false;
+        #endif
+    }
+
+    void read_hw_counters(const Thread_data& data, Hw_counts& counts)
+    {
+        #ifdef __linux__
+        // The group read returns the number of events, followed by their values.
+        std::array<uint64_t, n_hw_events+1> buffer = {};
+        if (read(data.hw_fd, buffer.data(), sizeof(buffer)) <= 0)
+            return;
+
+        for (uint64_t i=0; i<std::min<uint64_t>(buffer[0], n_hw_events); ++i)
+            counts[i] = buffer[i+1];
+        #endif
+    }
+
+    struct Region_stats
+    {
+        int depth = 0;
+        long long calls = 0;
+        double time_total = 0.;
+        double time_self = 0.;
+        double time_min = 0.;
+        double time_max = 0.;
+        Hw_counts hw_total = {};
+        std::map<int, std::pair<long long, double>> per_thread;
+    };
+
+    // Merge the region trees of all threads by their slash-separated path.
+    std::vector<std::pair<std::string, Region_stats>> merge_regions()
+    {
+        std::vector<std::pair<std::string, Region_stats>> regions;
+        std::map<std::string, int> index;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+
+        for (const auto& data : registry)
+        {
+            std::vector<std::string> paths(data->nodes.size());
+            std::vector<int> depths(data->nodes.size(), 0);
+
+            // Parents are always stored before their children.
+            for (int i=1; i<int(data->nodes.size()); ++i)
+            {
+                const Node& node = data->nodes[i];
+                paths[i] = node.parent == 0 ? node.name : paths[node.parent] + "/" + node.name;
+                depths[i] = node.parent == 0 ? 0 : depths[node.parent] + 1;
+
+                // Regions that have not been stopped since the last reset are not reported.
+                if (node.calls == 0)
+                    continue;
+
+                double time_children = 0.;
+                for (const int child : node.children)
+                    time_children += data->nodes[child].time_total;
+
+                auto it = index.find(paths[i]);
+                if (it == index.end())
+                {
+                    it = index.emplace(paths[i], regions.size()).first;
+                    regions.emplace_back(paths[i], Region_stats());
+                    regions.back().second.depth = depths[i];
+                    regions.back().second.time_min = node.time_min;
+                }
+
+                Region_stats& stats = regions[it->second].second;
+                stats.calls += node.calls;
+                stats.time_total += node.time_total;
+                stats.time_self += node.time_total - time_children;
+                stats.time_min = std::min(stats.time_min, node.time_min);
+                stats.time_max = std::max(stats.time_max, node.time_max);
+                for (int ie=0; ie<n_hw_events; ++ie)
+                    stats.hw_total[ie] += node.hw_total[ie];
+
+                auto& thread_stats = stats.per_thread[data->thread_id];
+                thread_stats.first += node.calls;
+                thread_stats.second += node.time_total;
+            }
+        }
+
+        std::sort(regions.begin(), regions.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        return regions;
+    }
+
+    std::map<std::string, long long> merge_counters()
+    {
+        std::map<std::string, long long> counters;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const auto& data : registry)
+            for (const auto& c : data->counters)
+                counters[c.first] += c.second;
+
+        return counters;
+    }
+
+    // Rates of the hardware counters over the inclusive time of a region. The memory traffic is
+    // estimated as one cache line per LLC miss, which gives the roofline position together with the fp_ops.
+    struct Hw_metrics
+    {
+        double ipc;
+        double bandwidth;
+        double fp_rate;
+        double fp_intensity;
+    };
+
+    Hw_metrics get_hw_metrics(const Region_stats& stats)
+    {
+        constexpr double cache_line_size = 64.;
+
+        const double bytes = cache_line_size * stats.hw_total[2];
+        const double time = std::max(stats.time_total, 1.e-9) * 1.e6; // In ms, scaled to giga per second.
+
+        Hw_metrics metrics;
+        metrics.ipc = stats.hw_total[0] > 0 ? double(stats.hw_total[1]) / stats.hw_total[0] : 0.;
+        metrics.bandwidth = bytes / time;
+        metrics.fp_rate = stats.hw_total[3] / time;
+        metrics.fp_intensity = bytes > 0. ? stats.hw_total[3] / bytes : 0.;
+        return metrics;
+    }
+
+    std::ofstream open_report(const std::string& file_name)
+    {
+        std::ofstream file(file_name);
+        if (!file)
+            throw std::runtime_error("Cannot open timer report " + file_name);
+        return file;
+    }
+}
+
+
+namespace Timer
+{
+    void set_enabled(const bool enabled)
+    {
+        timer_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool is_enabled()
+    {
+        return timer_enabled.load(std::memory_order_relaxed);
+    }
+
+    void set_hardware_counters(const bool enabled, const unsigned long long fp_event)
+    {
+        if (!enabled)
+        {
+            hw_enabled.store(false, std::memory_order_relaxed);
+            return;
+        }
+
+        hw_fp_event = fp_event;
+
+        // Check on the calling thread that the counters can be opened, other threads open them on first use.
+        Thread_data& data = get_thread_data();
+        if (!data.hw_tried && !open_hw_counters(data))
+            throw std::runtime_error("Cannot open the hardware counters with perf_event_open, check /proc/sys/kernel/perf_event_paranoid");
+
+        hw_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    Region::Region(const char* name) : node(-1)
+    {
+        if (!is_enabled())
+            return;
+
+        Thread_data& data = get_thread_data();
+        node = find_or_add_child(data, name);
+        data.current = node;
+
+        if (hw_enabled.load(std::memory_order_relaxed))
+        {
+            if (!data.hw_tried)
+                open_hw_counters(data);
+
+            if (data.hw_fd >= 0)
+            {
+                read_hw_counters(data, data.nodes[node].hw_start);
+                data.nodes[node].hw_open = true;
+            }
+        }
+
+        time_start = std::chrono::steady_clock::now();
+    }
+
+    Region::~Region()
+    {
+        stop();
+    }
+
+    void Region::stop()
+    {
+        if (node < 0)
+            return;
+
+        const auto time_end = std::chrono::steady_clock::now();
+        const double duration = std::chrono::duration<double, std::milli>(time_end-time_start).count();
+
+        Thread_data& data = get_thread_data();
+        Node& n = data.nodes[node];
+
+        if (n.hw_open)
+        {
+            Hw_counts hw_end = n.hw_start;
+            read_hw_counters(data, hw_end);
+            for (int ie=0; ie<n_hw_events; ++ie)
+                n.hw_total[ie] += hw_end[ie] - n.hw_start[ie];
+            n.hw_open = false;
+        }
+
+        n.time_min = n.calls == 0 ? duration : std::min(n.time_min, duration);
+        n.time_max = std::max(n.time_max, duration);
+        n.time_total += duration;
+        ++n.calls;
+
+        data.current = n.parent;
+        node = -1;
+    }
+
+    void count(const char* name, const long long value)
+    {
+        if (!is_enabled())
+            return;
+
+        get_thread_data().counters[name] += value;
+    }
+
+    void write_json(const std::string& file_name)
+    {
+        const auto regions = merge_regions();
+        const auto counters = merge_counters();
+
+        std::ofstream file = open_report(file_name);
+
+        file << "{\n  \"regions\": [";
+        for (size_t i=0; i<regions.size(); ++i)
+        {
+            const Region_stats& stats = regions[i].second;
+
+            file << (i == 0 ? "\n" : ",\n")
+                 << "    { \"path\": \"" << regions[i].first << "\""
+                 << ", \"depth\": " << stats.depth
+                 << ", \"calls\": " << stats.calls
+                 << ", \"total_ms\": " << stats.time_total
+                 << ", \"self_ms\": " << stats.time_self
+                 << ", \"mean_ms\": " << stats.time_total / std::max(stats.calls, 1LL)
+                 << ", \"min_ms\": " << stats.time_min
+                 << ", \"max_ms\": " << stats.time_max
+                 << ", \"threads\": [";
+
+            bool first = true;
+            for (const auto& t : stats.per_thread)
+            {
+                file << (first ? "" : ", ")
+                     << "{ \"thread\": " << t.first
+                     << ", \"calls\": " << t.second.first
+                     << ", \"total_ms\": " << t.second.second << " }";
+                first = false;
+            }
+            file << "]";
+
+            if (hw_enabled.load(std::memory_order_relaxed))
+            {
+                const Hw_metrics metrics = get_hw_metrics(stats);
+
+                file << ", \"hardware\": { ";
+                for (int ie=0; ie<n_hw_events; ++ie)
+                    file << "\"" << hw_event_names[ie] << "\": " << stats.hw_total[ie] << ", ";
+                file << "\"ipc\": " << metrics.ipc
+                     << ", \"bandwidth_gb_s\": " << metrics.bandwidth
+                     << ", \"fp_ops_g_s\": " << metrics.fp_rate
+                     << ", \"fp_ops_per_byte\": " << metrics.fp_intensity << " }";
+            }
+            file << " }";
+        }
+        file << "\n  ],\n  \"counters\": {";
+
+        bool first = true;
+        for (const auto& c : counters)
+        {
+            file << (first ? "\n" : ",\n") << "    \"" << c.first << "\": " << c.second;
+            first = false;
+        }
+        file << "\n  }\n}\n";
+    }
+
+    void write_csv(const std::string& file_name)
+    {
+        const auto regions = merge_regions();
+        const auto counters = merge_counters();
+
+        std::ofstream file = open_report(file_name);
+
+        const bool write_hw = hw_enabled.load(std::memory_order_relaxed);
+
+        file << "path,depth,threads,calls,total_ms,self_ms,mean_ms,min_ms,max_ms";
+        if (write_hw)
+        {
+            for (int ie=0; ie<n_hw_events; ++ie)
+                file << "," << hw_event_names[ie];
+            file << ",ipc,bandwidth_gb_s,fp_ops_g_s,fp_ops_per_byte";
+        }
+        file << "\n";
+
+        for (const auto& r : regions)
+        {
+            const Region_stats& stats = r.second;
+            file << r.first << "," << stats.depth << "," << stats.per_thread.size() << ","
+                 << stats.calls << "," << stats.time_total << "," << stats.time_self << ","
+                 << stats.time_total / std::max(stats.calls, 1LL) << ","
+                 << stats.time_min << "," << stats.time_max;
+
+            if (write_hw)
+            {
+                const Hw_metrics metrics = get_hw_metrics(stats);
+                for (int ie=0; ie<n_hw_events; ++ie)
+                    file << "," << stats.hw_total[ie];
+                file << "," << metrics.ipc << "," << metrics.bandwidth << ","
+                     << metrics.fp_rate << "," << metrics.fp_intensity;
+            }
+            file << "\n";
+        }
+
+        // Counters go in the same table, with only the calls column filled in.
+        for (const auto& c : counters)
+            file << "counter/" << c.first << ",0,,"  << c.second << ",,,,,"
+                 << std::string(write_hw ? n_hw_events+4 : 0, ',') << "\n";
+    }
+
+    void reset()
+    {
+        // The nodes are kept, such that regions that are open during the reset stay valid.
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (auto& data : registry)
+        {
+            for (Node& node : data->nodes)
+            {
+                node.calls = 0;
+                node.time_total = 0.;
+                node.time_min = 0.;
+                node.time_max = 0.;
+                node.hw_total = {};
+            }
+
+            for (auto& c : data->counters)
+                c.second = 0;
+        }
+    }
+}
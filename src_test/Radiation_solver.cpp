@@ -17,15 +17,18 @@
  * along with MicroHH.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <cmath>
 #include <numeric>
+#include <type_traits>
 
 #include "Radiation_solver.h"
 #include "Status.h"
 #include "Netcdf_interface.h"
 
 #include "Array.h"
+#include "Array_accounting.h"
 #include "Gas_concs.h"
 #include "Gas_optics_rrtmgp.h"
 #include "Optical_props.h"
@@ -33,6 +36,7 @@
 #include "Fluxes.h"
 #include "Rte_lw.h"
 #include "Rte_sw.h"
+#include "Timer.h"
 
 
 namespace
@@ -364,6 +368,149 @@ namespace
                 mext_phobic, ssa_phobic, g_phobic,
                 mext_philic, ssa_philic, g_philic);
     }
+
+
+    // Gather the columns in cols (1-based) of dimension col_dim into array_out, which keeps its storage.
+    template<int N>
+    void gather_columns(
+            const Array<Float,N>& array, const std::vector<int>& cols, const int col_dim, Array<Float,N>& array_out)
+    {
+        std::array<int,N> dims = array.get_dims();
+        const int n_col = dims[col_dim-1];
+        const int n_inner = std::accumulate(dims.begin(), dims.begin()+col_dim-1, 1, std::multiplies<>());
+        const int n_outer = array.size() / (n_inner*n_col);
+
+        dims[col_dim-1] = cols.size();
+        if (array_out.get_dims() != dims || !array_out.is_contiguous())
+            throw std::runtime_error("Gathered columns do not fit the output array");
+
+        for (int io=0; io<n_outer; ++io)
+            for (int icol=0; icol<int(cols.size()); ++icol)
+            {
+                const Float* in = array.ptr() + (io*n_col + cols[icol]-1)*n_inner;
+                std::copy(in, in+n_inner, array_out.ptr() + (io*cols.size() + icol)*n_inner);
+            }
+    }
+
+
+    // Gather the columns in cols (1-based) of dimension col_dim into a dense array.
+    template<int N>
+    Array<Float,N> gather_columns(const Array<Float,N>& array, const std::vector<int>& cols, const int col_dim)
+    {
+        if (array.size() == 0)
+            return Array<Float,N>();
+
+        std::array<int,N> dims = array.get_dims();
+        dims[col_dim-1] = cols.size();
+        Array<Float,N> array_out(dims);
+
+        gather_columns(array, cols, col_dim, array_out);
+
+        return array_out;
+    }
+
+
+    // Copy the columns col_s to col_e (1-based) of the first dimension into array_out, which keeps its storage.
+    template<int N>
+    void copy_columns(const Array<Float,N>& array, const int col_s, const int col_e, Array<Float,N>& array_out)
+    {
+        const int n_col = array.dim(1);
+        const int n_col_out = col_e - col_s + 1;
+        const int n_outer = array.size() / n_col;
+
+        std::array<int,N> dims = array.get_dims();
+        dims[0] = n_col_out;
+        if (array_out.get_dims() != dims || !array_out.is_contiguous())
+            throw std::runtime_error("Copied columns do not fit the output array");
+
+        for (int io=0; io<n_outer; ++io)
+        {
+            const Float* in = array.ptr() + io*n_col + col_s-1;
+            std::copy(in, in+n_col_out, array_out.ptr() + io*n_col_out);
+        }
+    }
+
+
+    // Scatter the dense array back to the columns in cols, the other columns are left untouched.
+    template<int N>
+    void scatter_columns(const Array<Float,N>& array, Array<Float,N>& array_out, const std::vector<int>& cols, const int col_dim)
+    {
+        if (array_out.size() == 0)
+            return;
+
+        const std::array<int,N> dims = array_out.get_dims();
+        const int n_col = dims[col_dim-1];
+        const int n_inner = std::accumulate(dims.begin(), dims.begin()+col_dim-1, 1, std::multiplies<>());
+        const int n_outer = array_out.size() / (n_inner*n_col);
+
+        for (int io=0; io<n_outer; ++io)
+            for (int icol=0; icol<int(cols.size()); ++icol)
+            {
+                const Float* in = array.ptr() + (io*cols.size() + icol)*n_inner;
+                std::copy(in, in+n_inner, array_out.ptr() + (io*n_col + cols[icol]-1)*n_inner);
+            }
+    }
+
+
+    // Clear the blocks of a workspace if they were made for other settings.
+    template<typename Workspace>
+    void set_workspace_settings(Workspace& workspace, typename Workspace::Settings&& settings)
+    {
+        if (workspace.settings == settings)
+            return;
+
+        workspace.blocks.clear();
+        workspace.settings = std::move(settings);
+    }
+
+
+    // Check whether two arrays have the same dimensions and values.
+    bool equal_values(const Array<Float,2>& a, const Array<Float,2>& b)
+    {
+        if (a.get_dims() != b.get_dims())
+            return false;
+
+        for (int i=1; i<=a.dim(2); ++i)
+            for (int j=1; j<=a.dim(1); ++j)
+                if (a({j, i}) != b({j, i}))
+                    return false;
+
+        return true;
+    }
+
+
+    // Set the columns in cols (1-based) of dimension col_dim to zero.
+    template<int N>
+    void zero_columns(Array<Float,N>& array, const std::vector<int>& cols, const int col_dim)
+    {
+        if (array.size() == 0)
+            return;
+
+        const std::array<int,N> dims = array.get_dims();
+        const int n_col = dims[col_dim-1];
+        const int n_inner = std::accumulate(dims.begin(), dims.begin()+col_dim-1, 1, std::multiplies<>());
+        const int n_outer = array.size() / (n_inner*n_col);
+
+        for (int io=0; io<n_outer; ++io)
+            for (const int icol : cols)
+            {
+                Float* out = array.ptr() + (io*n_col + icol-1)*n_inner;
+                std::fill(out, out+n_inner, Float(0.));
+            }
+    }
+}
+
+
+bool Radiation_solver_longwave::Workspace::Settings::operator==(const Settings& other) const
+{
+    return n_lay == other.n_lay
+        && lw_scattering == other.lw_scattering
+        && switch_fluxes == other.switch_fluxes
+        && switch_cloud_optics == other.switch_cloud_optics
+        && switch_output_bnd_fluxes == other.switch_output_bnd_fluxes
+        && switch_lw_jacobians == other.switch_lw_jacobians
+        && switch_output_bin_fluxes == other.switch_output_bin_fluxes
+        && equal_values(bin_lims_wvn, other.bin_lims_wvn);
 }
 
 
@@ -372,6 +519,8 @@ Radiation_solver_longwave::Radiation_solver_longwave(
         const std::string& file_name_gas,
         const std::string& file_name_cloud)
 {
+    Array_accounting::Tag accounting_tag("lw_coefficients");
+
     // Construct the gas optics classes for the solver.
     this->kdist = std::make_unique<Gas_optics_rrtmgp>(
             load_and_init_gas_optics(gas_concs, file_name_gas));
@@ -381,11 +530,25 @@ Radiation_solver_longwave::Radiation_solver_longwave(
 }
 
 
+void Radiation_solver_longwave::set_n_col_block(const int n_col_block)
+{
+    if (n_col_block < 1)
+        throw std::runtime_error("The column block size has to be at least 1");
+
+    this->n_col_block = n_col_block;
+}
+
+
 void Radiation_solver_longwave::solve(
         const bool switch_fluxes,
         const bool switch_cloud_optics,
         const bool switch_output_optical,
         const bool switch_output_bnd_fluxes,
+        const bool switch_lw_rescaling,
+        const bool switch_lw_two_stream,
+        const bool switch_lw_jacobians,
+        const bool switch_heating_rates,
+        const bool switch_output_bin_fluxes,
         const Gas_concs& gas_concs,
         const Array<Float,2>& p_lay, const Array<Float,2>& p_lev,
         const Array<Float,2>& t_lay, const Array<Float,2>& t_lev,
@@ -393,151 +556,255 @@ void Radiation_solver_longwave::solve(
         const Array<Float,1>& t_sfc, const Array<Float,2>& emis_sfc,
         const Array<Float,2>& lwp, const Array<Float,2>& iwp,
         const Array<Float,2>& rel, const Array<Float,2>& rei,
+        const Array<Float,2>& bin_lims_wvn,
         Array<Float,3>& tau, Array<Float,3>& lay_source,
         Array<Float,3>& lev_source_inc, Array<Float,3>& lev_source_dec, Array<Float,2>& sfc_source,
         Array<Float,2>& lw_flux_up, Array<Float,2>& lw_flux_dn, Array<Float,2>& lw_flux_net,
-        Array<Float,3>& lw_bnd_flux_up, Array<Float,3>& lw_bnd_flux_dn, Array<Float,3>& lw_bnd_flux_net) const
+        Array<Float,3>& lw_bnd_flux_up, Array<Float,3>& lw_bnd_flux_dn, Array<Float,3>& lw_bnd_flux_net,
+        Array<Float,2>& lw_flux_up_jac,
+        Array<Float,2>& lw_heating_rate, Array<Float,3>& lw_bnd_heating_rate,
+        Array<Float,3>& lw_bin_flux_up, Array<Float,3>& lw_bin_flux_dn, Array<Float,3>& lw_bin_flux_net,
+        Workspace* workspace) const
 {
+    Array_accounting::Tag accounting_tag("lw_solve");
+
     const int n_col = p_lay.dim(1);
     const int n_lay = p_lay.dim(2);
     const int n_lev = p_lev.dim(2);
-    const int n_gpt = this->kdist->get_ngpt();
     const int n_bnd = this->kdist->get_nband();
 
     const Bool top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
 
-    constexpr int n_col_block = 12;
+    const int n_col_block = this->n_col_block;
 
     // Read the sources and create containers for the substeps.
     int n_blocks = n_col / n_col_block;
     int n_col_block_residual = n_col % n_col_block;
 
-    std::unique_ptr<Optical_props_arry> optical_props_subset;
-    std::unique_ptr<Optical_props_arry> optical_props_residual;
+    if (switch_lw_rescaling && switch_lw_two_stream)
+        throw std::runtime_error("Longwave rescaling and two-stream solver cannot be combined");
 
-    optical_props_subset = std::make_unique<Optical_props_1scl>(n_col_block, n_lay, *kdist);
+    const Lw_scattering lw_scattering =
+            switch_lw_two_stream ? Lw_scattering::Two_stream :
+            switch_lw_rescaling  ? Lw_scattering::Rescaling  : Lw_scattering::None;
 
-    std::unique_ptr<Source_func_lw> sources_subset;
-    std::unique_ptr<Source_func_lw> sources_residual;
+    // Scattering needs ssa and g of the gases and clouds.
+    auto make_optical_props = [&](const int n_col_in, const Optical_props& spectral_disc)
+    {
+        std::unique_ptr<Optical_props_arry> optical_props;
+        if (lw_scattering == Lw_scattering::None)
+            optical_props = std::make_unique<Optical_props_1scl>(n_col_in, n_lay, spectral_disc);
+        else
+            optical_props = std::make_unique<Optical_props_2str>(n_col_in, n_lay, spectral_disc);
+        return optical_props;
+    };
 
-    sources_subset = std::make_unique<Source_func_lw>(n_col_block, n_lay, *kdist);
+    // Views on the output arrays, in which the blocks are stored with set_subset.
+    std::unique_ptr<Optical_props_1scl> optical_props_out;
+    std::unique_ptr<Source_func_lw> sources_out;
 
-    if (n_col_block_residual > 0)
+    if (switch_output_optical)
     {
-        optical_props_residual = std::make_unique<Optical_props_1scl>(n_col_block_residual, n_lay, *kdist);
-        sources_residual = std::make_unique<Source_func_lw>(n_col_block_residual, n_lay, *kdist);
+        optical_props_out = std::make_unique<Optical_props_1scl>(tau, *kdist);
+        sources_out = std::make_unique<Source_func_lw>(
+                sfc_source, lay_source, lev_source_inc, lev_source_dec, *kdist);
     }
 
-    std::unique_ptr<Optical_props_1scl> cloud_optical_props_subset;
-    std::unique_ptr<Optical_props_1scl> cloud_optical_props_residual;
+    // The solver accumulates the fluxes per band, thus the bins are weighted per band.
+    Array<Float,2> bin_weights;
 
-    if (switch_cloud_optics)
+    if (switch_output_bin_fluxes)
     {
-        cloud_optical_props_subset = std::make_unique<Optical_props_1scl>(n_col_block, n_lay, *cloud_optics);
-        if (n_col_block_residual > 0)
-            cloud_optical_props_residual = std::make_unique<Optical_props_1scl>(n_col_block_residual, n_lay, *cloud_optics);
+        Array<int,2> band_lims_bnd({2, n_bnd});
+        for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+        {
+            band_lims_bnd({1, ibnd}) = ibnd;
+            band_lims_bnd({2, ibnd}) = ibnd;
+        }
+
+        bin_weights = Fluxes_custom_bins::bin_weights(
+                this->kdist->get_band_lims_wavenumber(), band_lims_bnd, bin_lims_wvn);
     }
 
+    const int n_bin = bin_weights.size() > 0 ? bin_weights.dim(2) : 0;
+
+    // Fluxes in the spectral bins are accumulated together with the broadband fluxes.
+    auto make_fluxes = [&](const int n_col_in) -> std::unique_ptr<Fluxes_broadband>
+    {
+        if (switch_output_bin_fluxes)
+            return std::make_unique<Fluxes_custom_bins>(n_col_in, n_lev, bin_weights);
+        else
+            return std::make_unique<Fluxes_broadband>(n_col_in, n_lev);
+    };
+
+    // The work arrays of the blocks are taken from the workspace of the caller, if any, and made on first use.
+    Workspace workspace_local;
+    Workspace& ws = workspace ? *workspace : workspace_local;
+
+    Workspace::Settings settings;
+    settings.n_lay = n_lay;
+    settings.lw_scattering = lw_scattering;
+    settings.switch_fluxes = switch_fluxes;
+    settings.switch_cloud_optics = switch_cloud_optics;
+    settings.switch_output_bnd_fluxes = switch_output_bnd_fluxes;
+    settings.switch_lw_jacobians = switch_lw_jacobians;
+    settings.switch_output_bin_fluxes = switch_output_bin_fluxes;
+    if (switch_output_bin_fluxes)
+        settings.bin_lims_wvn = bin_lims_wvn;
+    set_workspace_settings(ws, std::move(settings));
+
+    auto get_work = [&](const int n_col_in) -> Workspace::Block&
+    {
+        Workspace::Block& work = ws.blocks[n_col_in];
+        if (work.optical_props)
+            return work;
+
+        work.optical_props = make_optical_props(n_col_in, *kdist);
+        work.sources = std::make_unique<Source_func_lw>(n_col_in, n_lay, *kdist);
+
+        if (switch_cloud_optics)
+            work.cloud_optical_props = make_optical_props(n_col_in, *cloud_optics);
+
+        work.col_dry.set_dims({n_col_in, n_lay});
+
+        if (switch_fluxes)
+        {
+            work.fluxes = make_fluxes(n_col_in);
+
+            // The solver accumulates the fluxes per band if postprocessing is desired.
+            const int n_flux = (switch_output_bnd_fluxes || switch_output_bin_fluxes) ? n_bnd : 1;
+            work.gpt_flux_up.set_dims({n_col_in, n_lev, n_flux});
+            work.gpt_flux_dn.set_dims({n_col_in, n_lev, n_flux});
+
+            // The broadband surface temperature Jacobian of the upward flux, if requested.
+            if (switch_lw_jacobians)
+                work.flux_up_jac.set_dims({n_col_in, n_lev});
+        }
+
+        return work;
+    };
+
     // Lambda function for solving optical properties subset.
     auto call_kernels = [&](
             const int col_s_in, const int col_e_in,
-            std::unique_ptr<Optical_props_arry>& optical_props_subset_in,
-            std::unique_ptr<Optical_props_1scl>& cloud_optical_props_subset_in,
-            Source_func_lw& sources_subset_in,
             const Array<Float,2>& emis_sfc_subset_in,
-            Fluxes_broadband& fluxes,
-            Fluxes_broadband& bnd_fluxes)
+            Workspace::Block& work)
     {
         const int n_col_in = col_e_in - col_s_in + 1;
+
+        std::unique_ptr<Optical_props_arry>& optical_props_subset_in = work.optical_props;
+        std::unique_ptr<Optical_props_arry>& cloud_optical_props_subset_in = work.cloud_optical_props;
+        Source_func_lw& sources_subset_in = *work.sources;
+
+        Timer::count("lw_columns", n_col_in);
+
+        Timer::Region region_subset("subset");
         Gas_concs gas_concs_subset(gas_concs, col_s_in, n_col_in);
 
         auto p_lev_subset = p_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }});
+        region_subset.stop();
 
-        Array<Float,2> col_dry_subset({n_col_in, n_lay});
+        Array<Float,2>& col_dry_subset = work.col_dry;
         if (col_dry.size() == 0)
+        {
+            Timer::Region region("get_col_dry");
             Gas_optics_rrtmgp::get_col_dry(col_dry_subset, gas_concs_subset.get_vmr("h2o"), p_lev_subset);
+        }
         else
-            col_dry_subset = std::move(col_dry.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}));
-
-        kdist->gas_optics(
-                p_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
-                p_lev_subset,
-                t_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
-                t_sfc.subset({{ {col_s_in, col_e_in} }}),
-                gas_concs_subset,
-                optical_props_subset_in,
-                sources_subset_in,
-                col_dry_subset,
-                t_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }}) );
+            copy_columns(col_dry, col_s_in, col_e_in, col_dry_subset);
 
-        if (switch_cloud_optics)
         {
+            Timer::Region region("gas_optics");
+            kdist->gas_optics(
+                    p_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
+                    p_lev_subset,
+                    t_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
+                    t_sfc.subset({{ {col_s_in, col_e_in} }}),
+                    gas_concs_subset,
+                    optical_props_subset_in,
+                    sources_subset_in,
+                    col_dry_subset,
+                    t_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }}) );
+        }
+
+        if (switch_cloud_optics && lw_scattering == Lw_scattering::None)
+        {
+            Timer::Region region_cloud("cloud_optics");
             cloud_optics->cloud_optics(
                     lwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                     iwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                     rel.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                     rei.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
-                    *cloud_optical_props_subset_in);
+                    dynamic_cast<Optical_props_1scl&>(*cloud_optical_props_subset_in));
+            region_cloud.stop();
 
             // cloud->delta_scale();
 
             // Add the cloud optical props to the gas optical properties.
+            Timer::Region region_add("add_to");
             add_to(
                     dynamic_cast<Optical_props_1scl&>(*optical_props_subset_in),
                     dynamic_cast<Optical_props_1scl&>(*cloud_optical_props_subset_in));
         }
+        else if (switch_cloud_optics)
+        {
+            Timer::Region region_cloud("cloud_optics");
+            cloud_optics->cloud_optics(
+                    lwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
+                    iwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
+                    rel.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
+                    rei.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
+                    dynamic_cast<Optical_props_2str&>(*cloud_optical_props_subset_in));
+            region_cloud.stop();
+
+            Timer::Region region_add("add_to");
+            add_to(
+                    dynamic_cast<Optical_props_2str&>(*optical_props_subset_in),
+                    dynamic_cast<Optical_props_2str&>(*cloud_optical_props_subset_in));
+        }
 
         // Store the optical properties, if desired.
         if (switch_output_optical)
         {
-            for (int igpt=1; igpt<=n_gpt; ++igpt)
-                for (int ilay=1; ilay<=n_lay; ++ilay)
-                    for (int icol=1; icol<=n_col_in; ++icol)
-                    {
-                        tau           ({icol+col_s_in-1, ilay, igpt}) = optical_props_subset_in->get_tau()    ({icol, ilay, igpt});
-                        lay_source    ({icol+col_s_in-1, ilay, igpt}) = sources_subset_in.get_lay_source()    ({icol, ilay, igpt});
-                        lev_source_inc({icol+col_s_in-1, ilay, igpt}) = sources_subset_in.get_lev_source_inc()({icol, ilay, igpt});
-                        lev_source_dec({icol+col_s_in-1, ilay, igpt}) = sources_subset_in.get_lev_source_dec()({icol, ilay, igpt});
-                    }
-
-            for (int igpt=1; igpt<=n_gpt; ++igpt)
-                for (int icol=1; icol<=n_col_in; ++icol)
-                    sfc_source({icol+col_s_in-1, igpt}) = sources_subset_in.get_sfc_source()({icol, igpt});
+            optical_props_out->set_subset(optical_props_subset_in, col_s_in, col_e_in);
+            sources_out->set_subset(sources_subset_in, col_s_in, col_e_in);
         }
 
         if (!switch_fluxes)
             return;
 
-        Array<Float,3> gpt_flux_up;
-        Array<Float,3> gpt_flux_dn;
+        Array<Float,3>& gpt_flux_up = work.gpt_flux_up;
+        Array<Float,3>& gpt_flux_dn = work.gpt_flux_dn;
+        Array<Float,2>& flux_up_jac = work.flux_up_jac;
+        Fluxes_broadband& fluxes = *work.fluxes;
+
+        constexpr int n_ang = 1;
 
-        // Save the output per gpt if postprocessing is desired.
-        if (switch_output_bnd_fluxes)
-        {
-            gpt_flux_up.set_dims({n_col_in, n_lev, n_gpt});
-            gpt_flux_dn.set_dims({n_col_in, n_lev, n_gpt});
-        }
-        else
         {
-            gpt_flux_up.set_dims({n_col_in, n_lev, 1});
-            gpt_flux_dn.set_dims({n_col_in, n_lev, 1});
+            Timer::Region region("rte_lw");
+            Rte_lw::rte_lw(
+                    optical_props_subset_in,
+                    top_at_1,
+                    sources_subset_in,
+                    emis_sfc_subset_in,
+                    Array<Float,2>(), // Add an empty array, no inc_flux.
+                    gpt_flux_up, gpt_flux_dn,
+                    flux_up_jac,
+                    n_ang,
+                    lw_scattering);
         }
 
-        constexpr int n_ang = 1;
+        if (switch_lw_jacobians)
+            lw_flux_up_jac.subset_view({{ {col_s_in, col_e_in}, {1, n_lev} }}) = flux_up_jac;
 
-        Rte_lw::rte_lw(
-                optical_props_subset_in,
-                top_at_1,
-                sources_subset_in,
-                emis_sfc_subset_in,
-                Array<Float,2>({n_col_in, n_gpt}), // Add an empty array, no inc_flux.
-                gpt_flux_up, gpt_flux_dn,
-                n_ang);
-
-        if (switch_output_bnd_fluxes)
+        if (switch_output_bnd_fluxes || switch_output_bin_fluxes)
         {
-            // Aggegated fluxes.
+            // Aggregated fluxes, the sum over the bands, and the fluxes in the bins.
+            Timer::Region region_reduce("flux_reduce");
             fluxes.reduce(gpt_flux_up, gpt_flux_dn, optical_props_subset_in, top_at_1);
+            region_reduce.stop();
+
+            Timer::Region region_copy("copy_back");
 
             for (int ilev=1; ilev<=n_lev; ++ilev)
                 for (int icol=1; icol<=n_col_in; ++icol)
@@ -547,21 +814,37 @@ void Radiation_solver_longwave::solve(
                     lw_flux_net({icol+col_s_in-1, ilev}) = fluxes.get_flux_net()({icol, ilev});
                 }
 
-            // Aggegated fluxes per band
-            bnd_fluxes.reduce(gpt_flux_up, gpt_flux_dn, optical_props_subset_in, top_at_1);
-
-            for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
-                for (int ilev=1; ilev<=n_lev; ++ilev)
-                    for (int icol=1; icol<=n_col_in; ++icol)
-                    {
-                        lw_bnd_flux_up ({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_up ()({icol, ilev, ibnd});
-                        lw_bnd_flux_dn ({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_dn ()({icol, ilev, ibnd});
-                        lw_bnd_flux_net({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_net()({icol, ilev, ibnd});
-                    }
+            // Aggregated fluxes per band
+            if (switch_output_bnd_fluxes)
+            {
+                for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+                    for (int ilev=1; ilev<=n_lev; ++ilev)
+                        for (int icol=1; icol<=n_col_in; ++icol)
+                        {
+                            lw_bnd_flux_up ({icol+col_s_in-1, ilev, ibnd}) = gpt_flux_up({icol, ilev, ibnd});
+                            lw_bnd_flux_dn ({icol+col_s_in-1, ilev, ibnd}) = gpt_flux_dn({icol, ilev, ibnd});
+                            lw_bnd_flux_net({icol+col_s_in-1, ilev, ibnd}) = gpt_flux_dn({icol, ilev, ibnd}) - gpt_flux_up({icol, ilev, ibnd});
+                        }
+            }
+
+            if (switch_output_bin_fluxes)
+            {
+                Fluxes_custom_bins& bin_fluxes = static_cast<Fluxes_custom_bins&>(fluxes);
+
+                for (int ibin=1; ibin<=n_bin; ++ibin)
+                    for (int ilev=1; ilev<=n_lev; ++ilev)
+                        for (int icol=1; icol<=n_col_in; ++icol)
+                        {
+                            lw_bin_flux_up ({icol+col_s_in-1, ilev, ibin}) = bin_fluxes.get_bin_flux_up ()({icol, ilev, ibin});
+                            lw_bin_flux_dn ({icol+col_s_in-1, ilev, ibin}) = bin_fluxes.get_bin_flux_dn ()({icol, ilev, ibin});
+                            lw_bin_flux_net({icol+col_s_in-1, ilev, ibin}) = bin_fluxes.get_bin_flux_net()({icol, ilev, ibin});
+                        }
+            }
         }
         else
         {
             // Copy the data to the output.
+            Timer::Region region_copy("copy_back");
             for (int ilev=1; ilev<=n_lev; ++ilev)
                 for (int icol=1; icol<=n_col_in; ++icol)
                 {
@@ -570,6 +853,22 @@ void Radiation_solver_longwave::solve(
                     lw_flux_net({icol+col_s_in-1, ilev}) = gpt_flux_dn({icol, ilev, 1}) - gpt_flux_up({icol, ilev, 1});
                 }
         }
+
+        // Heating rates of the block, directly from the net fluxes that are still in cache.
+        if (switch_heating_rates)
+        {
+            Timer::Region region("heating_rate");
+            Array<Float,2> heating_rate_out = lw_heating_rate.subset_view({{ {col_s_in, col_e_in}, {1, n_lay} }});
+            Fluxes_broadband::heating_rate(
+                    lw_flux_net.subset_view({{ {col_s_in, col_e_in}, {1, n_lev} }}), p_lev_subset, heating_rate_out);
+
+            if (switch_output_bnd_fluxes)
+            {
+                Array<Float,3> bnd_heating_rate_out = lw_bnd_heating_rate.subset_view({{ {col_s_in, col_e_in}, {1, n_lay}, {1, n_bnd} }});
+                Fluxes_broadband::heating_rate(
+                        lw_bnd_flux_net.subset_view({{ {col_s_in, col_e_in}, {1, n_lev}, {1, n_bnd} }}), p_lev_subset, bnd_heating_rate_out);
+            }
+        }
     };
 
     for (int b=1; b<=n_blocks; ++b)
@@ -579,19 +878,7 @@ void Radiation_solver_longwave::solve(
 
         Array<Float,2> emis_sfc_subset = emis_sfc.subset({{ {1, n_bnd}, {col_s, col_e} }});
 
-        std::unique_ptr<Fluxes_broadband> fluxes_subset =
-                std::make_unique<Fluxes_broadband>(n_col_block, n_lev);
-        std::unique_ptr<Fluxes_broadband> bnd_fluxes_subset =
-                std::make_unique<Fluxes_byband>(n_col_block, n_lev, n_bnd);
-
-        call_kernels(
-                col_s, col_e,
-                optical_props_subset,
-                cloud_optical_props_subset,
-                *sources_subset,
-                emis_sfc_subset,
-                *fluxes_subset,
-                *bnd_fluxes_subset);
+        call_kernels(col_s, col_e, emis_sfc_subset, get_work(n_col_block));
     }
 
     if (n_col_block_residual > 0)
@@ -600,23 +887,26 @@ void Radiation_solver_longwave::solve(
         const int col_e = n_col;
 
         Array<Float,2> emis_sfc_residual = emis_sfc.subset({{ {1, n_bnd}, {col_s, col_e} }});
-        std::unique_ptr<Fluxes_broadband> fluxes_residual =
-                std::make_unique<Fluxes_broadband>(n_col_block_residual, n_lev);
-        std::unique_ptr<Fluxes_broadband> bnd_fluxes_residual =
-                std::make_unique<Fluxes_byband>(n_col_block_residual, n_lev, n_bnd);
-
-        call_kernels(
-                col_s, col_e,
-                optical_props_residual,
-                cloud_optical_props_residual,
-                *sources_residual,
-                emis_sfc_residual,
-                *fluxes_residual,
-                *bnd_fluxes_residual);
+
+        call_kernels(col_s, col_e, emis_sfc_residual, get_work(n_col_block_residual));
     }
 }
 
 
+bool Radiation_solver_shortwave::Workspace::Settings::operator==(const Settings& other) const
+{
+    return n_lay == other.n_lay
+        && switch_fluxes == other.switch_fluxes
+        && switch_cloud_optics == other.switch_cloud_optics
+        && switch_aerosol_optics == other.switch_aerosol_optics
+        && switch_output_bnd_fluxes == other.switch_output_bnd_fluxes
+        && switch_sw_direct_only == other.switch_sw_direct_only
+        && switch_heating_rates == other.switch_heating_rates
+        && switch_output_bin_fluxes == other.switch_output_bin_fluxes
+        && equal_values(bin_lims_wvn, other.bin_lims_wvn);
+}
+
+
 Radiation_solver_shortwave::Radiation_solver_shortwave(
         const Gas_concs& gas_concs,
         const bool switch_cloud_optics,
@@ -625,6 +915,8 @@ Radiation_solver_shortwave::Radiation_solver_shortwave(
         const std::string& file_name_cloud,
         const std::string& file_name_aerosol)
 {
+    Array_accounting::Tag accounting_tag("sw_coefficients");
+
     // Construct the gas optics classes for the solver.
     this->kdist = std::make_unique<Gas_optics_rrtmgp>(
             load_and_init_gas_optics(gas_concs, file_name_gas));
@@ -639,6 +931,15 @@ Radiation_solver_shortwave::Radiation_solver_shortwave(
 }
 
 
+void Radiation_solver_shortwave::set_n_col_block(const int n_col_block)
+{
+    if (n_col_block < 1)
+        throw std::runtime_error("The column block size has to be at least 1");
+
+    this->n_col_block = n_col_block;
+}
+
+
 void Radiation_solver_shortwave::solve(
         const bool switch_fluxes,
         const bool switch_cloud_optics,
@@ -647,6 +948,10 @@ void Radiation_solver_shortwave::solve(
         const bool switch_output_bnd_fluxes,
         const bool switch_delta_cloud,
         const bool switch_delta_aerosol,
+        const bool switch_combine_lazily,
+        const bool switch_sw_direct_only,
+        const bool switch_heating_rates,
+        const bool switch_output_bin_fluxes,
         const Gas_concs& gas_concs,
         const Array<Float,2>& p_lay, const Array<Float,2>& p_lev,
         const Array<Float,2>& t_lay, const Array<Float,2>& t_lev,
@@ -657,13 +962,20 @@ void Radiation_solver_shortwave::solve(
         const Array<Float,2>& rel, const Array<Float,2>& rei,
         const Array<Float,2>& rh,
         const Aerosol_concs& aerosol_concs,
+        const Array<Float,2>& bin_lims_wvn,
         Array<Float,3>& tau, Array<Float,3>& ssa, Array<Float,3>& g,
         Array<Float,2>& toa_src,
         Array<Float,2>& sw_flux_up, Array<Float,2>& sw_flux_dn,
         Array<Float,2>& sw_flux_dn_dir, Array<Float,2>& sw_flux_net,
         Array<Float,3>& sw_bnd_flux_up, Array<Float,3>& sw_bnd_flux_dn,
-        Array<Float,3>& sw_bnd_flux_dn_dir, Array<Float,3>& sw_bnd_flux_net) const
+        Array<Float,3>& sw_bnd_flux_dn_dir, Array<Float,3>& sw_bnd_flux_net,
+        Array<Float,2>& sw_heating_rate, Array<Float,3>& sw_bnd_heating_rate,
+        Array<Float,3>& sw_bin_flux_up, Array<Float,3>& sw_bin_flux_dn,
+        Array<Float,3>& sw_bin_flux_dn_dir, Array<Float,3>& sw_bin_flux_net,
+        Workspace* workspace) const
 {
+    Array_accounting::Tag accounting_tag("sw_solve");
+
     const int n_col = p_lay.dim(1);
     const int n_lay = p_lay.dim(2);
     const int n_lev = p_lev.dim(2);
@@ -672,75 +984,217 @@ void Radiation_solver_shortwave::solve(
 
     const Bool top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
 
-    constexpr int n_col_block = 12;
+    // Solve only the sunlit columns, which are gathered per block, and set the fluxes of the night columns to zero.
+    // The optical properties do not depend on mu0, thus if those are output the night columns get the optics only.
+    std::vector<int> cols_sunlit;
+    std::vector<int> cols_night;
+    for (int icol=1; icol<=n_col; ++icol)
+    {
+        if (mu0({icol}) > Float(0.))
+            cols_sunlit.push_back(icol);
+        else
+            cols_night.push_back(icol);
+    }
 
-    // Read the sources and create containers for the substeps.
-    int n_blocks = n_col / n_col_block;
-    int n_col_block_residual = n_col % n_col_block;
+    if (!cols_night.empty())
+    {
+        for (Array<Float,2>* array : {&sw_flux_up, &sw_flux_dn, &sw_flux_dn_dir, &sw_flux_net, &sw_heating_rate})
+            zero_columns(*array, cols_night, 1);
 
-    std::unique_ptr<Optical_props_arry> optical_props_subset;
-    std::unique_ptr<Optical_props_arry> optical_props_residual;
+        for (Array<Float,3>* array : {
+                &sw_bnd_flux_up, &sw_bnd_flux_dn, &sw_bnd_flux_dn_dir, &sw_bnd_flux_net, &sw_bnd_heating_rate,
+                &sw_bin_flux_up, &sw_bin_flux_dn, &sw_bin_flux_dn_dir, &sw_bin_flux_net})
+            zero_columns(*array, cols_night, 1);
+    }
 
-    optical_props_subset = std::make_unique<Optical_props_2str>(n_col_block, n_lay, *kdist);
-    if (n_col_block_residual > 0)
-        optical_props_residual = std::make_unique<Optical_props_2str>(n_col_block_residual, n_lay, *kdist);
+    const int n_col_block = this->n_col_block;
 
-    std::unique_ptr<Optical_props_2str> cloud_optical_props_subset;
-    std::unique_ptr<Optical_props_2str> cloud_optical_props_residual;
+    // Without scattering only the extinction is needed, which gives the direct beam only.
+    auto make_optical_props = [&](const int n_col_in) -> std::unique_ptr<Optical_props_arry>
+    {
+        if (switch_sw_direct_only)
+            return std::make_unique<Optical_props_1scl>(n_col_in, n_lay, *kdist);
+        else
+            return std::make_unique<Optical_props_2str>(n_col_in, n_lay, *kdist);
+    };
 
-    std::unique_ptr<Optical_props_2str> aerosol_optical_props_subset;
-    std::unique_ptr<Optical_props_2str> aerosol_optical_props_residual;
+    // Views on the output arrays, in which the blocks are stored with set_subset.
+    std::unique_ptr<Optical_props_arry> optical_props_out;
 
-    if (switch_cloud_optics)
+    if (switch_output_optical)
     {
-        cloud_optical_props_subset = std::make_unique<Optical_props_2str>(n_col_block, n_lay, *cloud_optics);
-        if (n_col_block_residual > 0)
-            cloud_optical_props_residual = std::make_unique<Optical_props_2str>(n_col_block_residual, n_lay, *cloud_optics);
+        if (switch_sw_direct_only)
+        {
+            optical_props_out = std::make_unique<Optical_props_1scl>(tau, *kdist);
+            ssa.fill(Float(0.));
+            g.fill(Float(0.));
+        }
+        else
+            optical_props_out = std::make_unique<Optical_props_2str>(tau, ssa, g, *kdist);
     }
 
-    if (switch_aerosol_optics)
+    // The bin weights are constant within a band, thus if the band fluxes are computed
+    // the bins are weighted per band and reduced from the band fluxes.
+    Array<Float,2> bin_weights;
+
+    if (switch_output_bin_fluxes && switch_output_bnd_fluxes)
     {
-        aerosol_optical_props_subset = std::make_unique<Optical_props_2str>(n_col_block, n_lay, *aerosol_optics);
-        if (n_col_block_residual > 0)
-            aerosol_optical_props_residual = std::make_unique<Optical_props_2str>(n_col_block_residual, n_lay, *aerosol_optics);
+        Array<int,2> band_lims_bnd({2, n_bnd});
+        for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+        {
+            band_lims_bnd({1, ibnd}) = ibnd;
+            band_lims_bnd({2, ibnd}) = ibnd;
+        }
+
+        bin_weights = Fluxes_custom_bins::bin_weights(
+                this->kdist->get_band_lims_wavenumber(), band_lims_bnd, bin_lims_wvn);
     }
+    else if (switch_output_bin_fluxes)
+        bin_weights = Fluxes_custom_bins::bin_weights(
+                this->kdist->get_band_lims_wavenumber(), this->kdist->get_band_lims_gpoint(), bin_lims_wvn);
+
+    const int n_bin = bin_weights.size() > 0 ? bin_weights.dim(2) : 0;
+
+    // The work arrays of the blocks are taken from the workspace of the caller, if any, and made on first use.
+    Workspace workspace_local;
+    Workspace& ws = workspace ? *workspace : workspace_local;
+
+    Workspace::Settings settings;
+    settings.n_lay = n_lay;
+    settings.switch_fluxes = switch_fluxes;
+    settings.switch_cloud_optics = switch_cloud_optics;
+    settings.switch_aerosol_optics = switch_aerosol_optics;
+    settings.switch_output_bnd_fluxes = switch_output_bnd_fluxes;
+    settings.switch_sw_direct_only = switch_sw_direct_only;
+    settings.switch_heating_rates = switch_heating_rates;
+    settings.switch_output_bin_fluxes = switch_output_bin_fluxes;
+    if (switch_output_bin_fluxes)
+        settings.bin_lims_wvn = bin_lims_wvn;
+    set_workspace_settings(ws, std::move(settings));
+
+    auto get_work = [&](const int n_col_in) -> Workspace::Block&
+    {
+        Workspace::Block& work = ws.blocks[n_col_in];
+        if (work.optical_props)
+            return work;
+
+        work.optical_props = make_optical_props(n_col_in);
+
+        if (switch_cloud_optics)
+            work.cloud_optical_props = std::make_unique<Optical_props_2str>(n_col_in, n_lay, *cloud_optics);
+
+        if (switch_aerosol_optics)
+            work.aerosol_optical_props = std::make_unique<Optical_props_2str>(n_col_in, n_lay, *aerosol_optics);
+
+        work.col_dry.set_dims({n_col_in, n_lay});
+        work.toa_src.set_dims({n_col_in, n_gpt});
+
+        if (switch_fluxes)
+        {
+            work.bnd_fluxes = std::make_unique<Fluxes_byband>(n_col_in, n_lev, n_bnd);
+            if (switch_output_bin_fluxes)
+                work.bin_fluxes = std::make_unique<Fluxes_custom_bins>(n_col_in, n_lev, bin_weights);
+
+            // Save the output per gpt if postprocessing is desired.
+            const int n_flux = (switch_output_bnd_fluxes || switch_output_bin_fluxes) ? n_gpt : 1;
+            work.gpt_flux_up.set_dims({n_col_in, n_lev, n_flux});
+            work.gpt_flux_dn.set_dims({n_col_in, n_lev, n_flux});
+            work.gpt_flux_dn_dir.set_dims({n_col_in, n_lev, n_flux});
+
+            // Heating rates of gathered blocks are computed here before they are scattered.
+            if (switch_heating_rates)
+            {
+                work.heating_rate.set_dims({n_col_in, n_lay});
+                if (switch_output_bnd_fluxes)
+                    work.bnd_heating_rate.set_dims({n_col_in, n_lay, n_bnd});
+            }
+        }
+
+        return work;
+    };
 
     // Lambda function for solving optical properties subset.
     auto call_kernels = [&](
-            const int col_s_in, const int col_e_in,
-            std::unique_ptr<Optical_props_arry>& optical_props_subset_in,
-            std::unique_ptr<Optical_props_2str>& cloud_optical_props_subset_in,
-            std::unique_ptr<Optical_props_2str>& aerosol_optical_props_subset_in,
-            Fluxes_broadband& fluxes,
-            Fluxes_broadband& bnd_fluxes)
+            const std::vector<int>& cols_in,
+            Workspace::Block& work,
+            const bool switch_fluxes_in)
     {
-        const int n_col_in = col_e_in - col_s_in + 1;
-        Gas_concs gas_concs_subset(gas_concs, col_s_in, n_col_in);
+        const int n_col_in = cols_in.size();
+        const int col_s_in = cols_in.front();
+        const int col_e_in = cols_in.back();
+        Timer::count("sw_columns", n_col_in);
 
-        auto p_lev_subset = p_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }});
+        std::unique_ptr<Optical_props_arry>& optical_props_subset_in = work.optical_props;
+        std::unique_ptr<Optical_props_2str>& cloud_optical_props_subset_in = work.cloud_optical_props;
+        std::unique_ptr<Optical_props_2str>& aerosol_optical_props_subset_in = work.aerosol_optical_props;
+
+        // Blocks of consecutive columns are a contiguous range, the others gather their columns.
+        const bool gather = col_e_in - col_s_in + 1 != n_col_in;
+
+        // Columns of the block of an input that has the columns in the first dimension.
+        auto get_block = [&](const auto& array)
+        {
+            constexpr int N = std::tuple_size<decltype(array.get_dims())>::value;
+            if (gather)
+                return gather_columns(array, cols_in, 1);
+
+            std::array<std::pair<int, int>, N> range;
+            range[0] = {col_s_in, col_e_in};
+            for (int i=1; i<N; ++i)
+                range[i] = {1, array.dim(i+1)};
+            return array.subset(range);
+        };
+
+        // The surface albedo has the columns in the second dimension.
+        auto get_block_alb = [&](const Array<Float,2>& array)
+        {
+            return gather ? gather_columns(array, cols_in, 2) : array.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }});
+        };
+
+        Timer::Region region_subset("subset");
+        Gas_concs gas_concs_subset = gather
+                ? Gas_concs(gas_concs, cols_in)
+                : Gas_concs(gas_concs, col_s_in, n_col_in);
 
-        Array<Float,2> col_dry_subset({n_col_in, n_lay});
+        auto p_lev_subset = get_block(p_lev);
+        region_subset.stop();
+
+        Array<Float,2>& col_dry_subset = work.col_dry;
         if (col_dry.size() == 0)
+        {
+            Timer::Region region("get_col_dry");
             Gas_optics_rrtmgp::get_col_dry(col_dry_subset, gas_concs_subset.get_vmr("h2o"), p_lev_subset);
+        }
+        else if (gather)
+            gather_columns(col_dry, cols_in, 1, col_dry_subset);
         else
-            col_dry_subset = std::move(col_dry.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}));
+            copy_columns(col_dry, col_s_in, col_e_in, col_dry_subset);
 
-        Array<Float,2> toa_src_subset({n_col_in, n_gpt});
+        Array<Float,2>& toa_src_subset = work.toa_src;
 
-        kdist->gas_optics(
-                p_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
-                p_lev_subset,
-                t_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
-                gas_concs_subset,
-                optical_props_subset_in,
-                toa_src_subset,
-                col_dry_subset);
+        {
+            Timer::Region region("gas_optics");
+            kdist->gas_optics(
+                    get_block(p_lay),
+                    p_lev_subset,
+                    get_block(t_lay),
+                    gas_concs_subset,
+                    optical_props_subset_in,
+                    toa_src_subset,
+                    col_dry_subset);
 
-        auto tsi_scaling_subset = tsi_scaling.subset({{ {col_s_in, col_e_in} }});
+            auto tsi_scaling_subset = get_block(tsi_scaling);
 
-        for (int igpt=1; igpt<=n_gpt; ++igpt)
-            for (int icol=1; icol<=n_col_in; ++icol)
-                toa_src_subset({icol, igpt}) *= tsi_scaling_subset({icol});
+            for (int igpt=1; igpt<=n_gpt; ++igpt)
+                for (int icol=1; icol<=n_col_in; ++icol)
+                    toa_src_subset({icol, igpt}) *= tsi_scaling_subset({icol});
+        }
+
+        // The particle optical props are kept per band and combined per g-point in the solver,
+        // unless the combined optical properties are requested as output.
+        const bool combine_lazily =
+                switch_combine_lazily && !switch_output_optical && !switch_sw_direct_only
+                && (switch_cloud_optics || switch_aerosol_optics);
 
 
         if (switch_cloud_optics)
@@ -748,166 +1202,270 @@ void Radiation_solver_shortwave::solve(
             Array<int,2> cld_mask_liq({n_col_in, n_lay});
             Array<int,2> cld_mask_ice({n_col_in, n_lay});
 
+            Timer::Region region_cloud("cloud_optics");
             cloud_optics->cloud_optics(
-                    lwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
-                    iwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
-                    rel.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
-                    rei.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
+                    get_block(lwp),
+                    get_block(iwp),
+                    get_block(rel),
+                    get_block(rei),
                     *cloud_optical_props_subset_in);
-
-            if (switch_delta_cloud)
-                cloud_optical_props_subset_in->delta_scale();
-
-            // Add the cloud optical props to the gas optical properties.
-            add_to(
-                    dynamic_cast<Optical_props_2str&>(*optical_props_subset_in),
-                    dynamic_cast<Optical_props_2str&>(*cloud_optical_props_subset_in));
+            region_cloud.stop();
+
+            // Add the cloud optical props to the gas optical properties,
+            // fusing the delta-scaling into the addition if requested.
+            Timer::Region region_add("add_to");
+            if (combine_lazily || switch_sw_direct_only)
+            {
+                if (switch_delta_cloud)
+                    cloud_optical_props_subset_in->delta_scale();
+                if (switch_sw_direct_only)
+                    add_extinction_to(
+                            dynamic_cast<Optical_props_1scl&>(*optical_props_subset_in),
+                            *cloud_optical_props_subset_in);
+            }
+            else if (switch_delta_cloud)
+                add_to_delta_scaled(
+                        dynamic_cast<Optical_props_2str&>(*optical_props_subset_in),
+                        dynamic_cast<Optical_props_2str&>(*cloud_optical_props_subset_in));
+            else
+                add_to(
+                        dynamic_cast<Optical_props_2str&>(*optical_props_subset_in),
+                        dynamic_cast<Optical_props_2str&>(*cloud_optical_props_subset_in));
         }
 
         if (switch_aerosol_optics)
         {
-            Aerosol_concs aerosol_concs_subset(aerosol_concs, 1, n_col_in);
+            Timer::Region region_aerosol("aerosol_optics");
+            Aerosol_concs aerosol_concs_subset = gather
+                    ? Aerosol_concs(aerosol_concs, cols_in)
+                    : Aerosol_concs(aerosol_concs, col_s_in, n_col_in);
             aerosol_optics->aerosol_optics(
                     aerosol_concs_subset,
-                    rh.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
+                    get_block(rh),
                     p_lev_subset,
                     *aerosol_optical_props_subset_in);
-
-            if (switch_delta_aerosol)
-                aerosol_optical_props_subset_in->delta_scale();
-
-            // Add the aerosol optical props to the gas optical properties.
-            add_to(
-                    dynamic_cast<Optical_props_2str&>(*optical_props_subset_in),
-                    dynamic_cast<Optical_props_2str&>(*aerosol_optical_props_subset_in));
+            region_aerosol.stop();
+
+            // Add the aerosol optical props to the gas optical properties, or
+            // to the cloud optical props per band if those are combined lazily.
+            Timer::Region region_add("add_to");
+            if (switch_sw_direct_only)
+            {
+                if (switch_delta_aerosol)
+                    aerosol_optical_props_subset_in->delta_scale();
+                add_extinction_to(
+                        dynamic_cast<Optical_props_1scl&>(*optical_props_subset_in),
+                        *aerosol_optical_props_subset_in);
+            }
+            else
+            {
+                Optical_props_2str& op_target = (combine_lazily && switch_cloud_optics)
+                        ? *cloud_optical_props_subset_in
+                        : dynamic_cast<Optical_props_2str&>(*optical_props_subset_in);
+
+                if (combine_lazily && !switch_cloud_optics)
+                {
+                    if (switch_delta_aerosol)
+                        aerosol_optical_props_subset_in->delta_scale();
+                }
+                else if (switch_delta_aerosol)
+                    add_to_delta_scaled(op_target, *aerosol_optical_props_subset_in);
+                else
+                    add_to(op_target, *aerosol_optical_props_subset_in);
+            }
         }
 
 
         // Store the optical properties, if desired.
-        if (switch_output_optical)
+        if (switch_output_optical && gather)
         {
-            for (int igpt=1; igpt<=n_gpt; ++igpt)
-                for (int ilay=1; ilay<=n_lay; ++ilay)
-                    for (int icol=1; icol<=n_col_in; ++icol)
-                    {
-                        tau({icol+col_s_in-1, ilay, igpt}) = optical_props_subset_in->get_tau()({icol, ilay, igpt});
-                        ssa({icol+col_s_in-1, ilay, igpt}) = optical_props_subset_in->get_ssa()({icol, ilay, igpt});
-                        g  ({icol+col_s_in-1, ilay, igpt}) = optical_props_subset_in->get_g  ()({icol, ilay, igpt});
-                    }
-
-            for (int igpt=1; igpt<=n_gpt; ++igpt)
-                for (int icol=1; icol<=n_col_in; ++icol)
-                    toa_src({icol+col_s_in-1, igpt}) = toa_src_subset({icol, igpt});
+            Array<Float,3> buffer;
+            scatter_columns(contiguous(optical_props_subset_in->get_tau(), buffer), tau, cols_in, 1);
+            if (!switch_sw_direct_only)
+            {
+                scatter_columns(contiguous(optical_props_subset_in->get_ssa(), buffer), ssa, cols_in, 1);
+                scatter_columns(contiguous(optical_props_subset_in->get_g(), buffer), g, cols_in, 1);
+            }
+            scatter_columns(toa_src_subset, toa_src, cols_in, 1);
+        }
+        else if (switch_output_optical)
+        {
+            optical_props_out->set_subset(optical_props_subset_in, col_s_in, col_e_in);
+            toa_src.subset_view({{ {col_s_in, col_e_in}, {1, n_gpt} }}) = toa_src_subset;
         }
 
-        if (!switch_fluxes)
+        if (!switch_fluxes_in)
             return;
 
-        Array<Float,3> gpt_flux_up;
-        Array<Float,3> gpt_flux_dn;
-        Array<Float,3> gpt_flux_dn_dir;
+        Array<Float,3>& gpt_flux_up = work.gpt_flux_up;
+        Array<Float,3>& gpt_flux_dn = work.gpt_flux_dn;
+        Array<Float,3>& gpt_flux_dn_dir = work.gpt_flux_dn_dir;
+
+        Fluxes_broadband& bnd_fluxes = *work.bnd_fluxes;
+        std::unique_ptr<Fluxes_custom_bins>& bin_fluxes = work.bin_fluxes;
 
-        // Save the output per gpt if postprocessing is desired.
-        if (switch_output_bnd_fluxes)
+        Timer::Region region_rte("rte_sw");
+        if (combine_lazily)
         {
-            gpt_flux_up.set_dims({n_col_in, n_lev, n_gpt});
-            gpt_flux_dn.set_dims({n_col_in, n_lev, n_gpt});
-            gpt_flux_dn_dir.set_dims({n_col_in, n_lev, n_gpt});
+            const Optical_props_2str_combined combined_optical_props(
+                    dynamic_cast<Optical_props_2str&>(*optical_props_subset_in),
+                    switch_cloud_optics ? *cloud_optical_props_subset_in : *aerosol_optical_props_subset_in);
+
+            Rte_sw::rte_sw(
+                    combined_optical_props,
+                    top_at_1,
+                    get_block(mu0),
+                    toa_src_subset,
+                    get_block_alb(sfc_alb_dir),
+                    get_block_alb(sfc_alb_dif),
+                    Array<Float,2>(), // Add an empty array, no inc_flux.
+                    gpt_flux_up,
+                    gpt_flux_dn,
+                    gpt_flux_dn_dir);
         }
         else
         {
-            gpt_flux_up.set_dims({n_col_in, n_lev, 1});
-            gpt_flux_dn.set_dims({n_col_in, n_lev, 1});
-            gpt_flux_dn_dir.set_dims({n_col_in, n_lev, 1});
+            Rte_sw::rte_sw(
+                    optical_props_subset_in,
+                    top_at_1,
+                    get_block(mu0),
+                    toa_src_subset,
+                    get_block_alb(sfc_alb_dir),
+                    get_block_alb(sfc_alb_dif),
+                    Array<Float,2>(), // Add an empty array, no inc_flux.
+                    gpt_flux_up,
+                    gpt_flux_dn,
+                    gpt_flux_dn_dir);
         }
+        region_rte.stop();
 
-        Rte_sw::rte_sw(
-                optical_props_subset_in,
-                top_at_1,
-                mu0.subset({{ {col_s_in, col_e_in} }}),
-                toa_src_subset,
-                sfc_alb_dir.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }}),
-                sfc_alb_dif.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }}),
-                Array<Float,2>(), // Add an empty array, no inc_flux.
-                gpt_flux_up,
-                gpt_flux_dn,
-                gpt_flux_dn_dir);
-
-        if (switch_output_bnd_fluxes)
+        if (switch_output_bnd_fluxes || switch_output_bin_fluxes)
         {
-            // Aggegated fluxes.
-            fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, optical_props_subset_in, top_at_1);
+            // Aggregated fluxes and fluxes per band or per bin, in a single pass over the g-point fluxes.
+            // If both are requested, the bins are reduced from the band fluxes.
+            Timer::Region region_reduce("flux_reduce");
+            if (switch_output_bnd_fluxes)
+                bnd_fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, optical_props_subset_in, top_at_1);
+            if (switch_output_bin_fluxes && switch_output_bnd_fluxes)
+                bin_fluxes->reduce(
+                        bnd_fluxes.get_bnd_flux_up(), bnd_fluxes.get_bnd_flux_dn(), bnd_fluxes.get_bnd_flux_dn_dir(),
+                        optical_props_subset_in, top_at_1);
+            else if (switch_output_bin_fluxes)
+                bin_fluxes->reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, optical_props_subset_in, top_at_1);
+            region_reduce.stop();
+
+            Timer::Region region_copy("copy_back");
+
+            Fluxes_broadband& fluxes = switch_output_bnd_fluxes ? bnd_fluxes : *bin_fluxes;
+
             for (int ilev=1; ilev<=n_lev; ++ilev)
                 for (int icol=1; icol<=n_col_in; ++icol)
                 {
-                    sw_flux_up    ({icol+col_s_in-1, ilev}) = fluxes.get_flux_up    ()({icol, ilev});
-                    sw_flux_dn    ({icol+col_s_in-1, ilev}) = fluxes.get_flux_dn    ()({icol, ilev});
-                    sw_flux_dn_dir({icol+col_s_in-1, ilev}) = fluxes.get_flux_dn_dir()({icol, ilev});
-                    sw_flux_net   ({icol+col_s_in-1, ilev}) = fluxes.get_flux_net   ()({icol, ilev});
+                    sw_flux_up    ({cols_in[icol-1], ilev}) = fluxes.get_flux_up    ()({icol, ilev});
+                    sw_flux_dn    ({cols_in[icol-1], ilev}) = fluxes.get_flux_dn    ()({icol, ilev});
+                    sw_flux_dn_dir({cols_in[icol-1], ilev}) = fluxes.get_flux_dn_dir()({icol, ilev});
+                    sw_flux_net   ({cols_in[icol-1], ilev}) = fluxes.get_flux_net   ()({icol, ilev});
                 }
 
-            // Aggegated fluxes per band
-            bnd_fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, optical_props_subset_in, top_at_1);
-
-            for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
-                for (int ilev=1; ilev<=n_lev; ++ilev)
-                    for (int icol=1; icol<=n_col_in; ++icol)
-                    {
-                        sw_bnd_flux_up    ({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_up    ()({icol, ilev, ibnd});
-                        sw_bnd_flux_dn    ({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_dn    ()({icol, ilev, ibnd});
-                        sw_bnd_flux_dn_dir({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_dn_dir()({icol, ilev, ibnd});
-                        sw_bnd_flux_net   ({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_net   ()({icol, ilev, ibnd});
-                    }
+            if (switch_output_bnd_fluxes)
+            {
+                for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+                    for (int ilev=1; ilev<=n_lev; ++ilev)
+                        for (int icol=1; icol<=n_col_in; ++icol)
+                        {
+                            sw_bnd_flux_up    ({cols_in[icol-1], ilev, ibnd}) = bnd_fluxes.get_bnd_flux_up    ()({icol, ilev, ibnd});
+                            sw_bnd_flux_dn    ({cols_in[icol-1], ilev, ibnd}) = bnd_fluxes.get_bnd_flux_dn    ()({icol, ilev, ibnd});
+                            sw_bnd_flux_dn_dir({cols_in[icol-1], ilev, ibnd}) = bnd_fluxes.get_bnd_flux_dn_dir()({icol, ilev, ibnd});
+                            sw_bnd_flux_net   ({cols_in[icol-1], ilev, ibnd}) = bnd_fluxes.get_bnd_flux_net   ()({icol, ilev, ibnd});
+                        }
+            }
+
+            if (switch_output_bin_fluxes)
+            {
+                for (int ibin=1; ibin<=n_bin; ++ibin)
+                    for (int ilev=1; ilev<=n_lev; ++ilev)
+                        for (int icol=1; icol<=n_col_in; ++icol)
+                        {
+                            sw_bin_flux_up    ({cols_in[icol-1], ilev, ibin}) = bin_fluxes->get_bin_flux_up    ()({icol, ilev, ibin});
+                            sw_bin_flux_dn    ({cols_in[icol-1], ilev, ibin}) = bin_fluxes->get_bin_flux_dn    ()({icol, ilev, ibin});
+                            sw_bin_flux_dn_dir({cols_in[icol-1], ilev, ibin}) = bin_fluxes->get_bin_flux_dn_dir()({icol, ilev, ibin});
+                            sw_bin_flux_net   ({cols_in[icol-1], ilev, ibin}) = bin_fluxes->get_bin_flux_net   ()({icol, ilev, ibin});
+                        }
+            }
         }
         else
         {
             // Copy the data to the output.
+            Timer::Region region_copy("copy_back");
             for (int ilev=1; ilev<=n_lev; ++ilev)
                 for (int icol=1; icol<=n_col_in; ++icol)
                 {
-                    sw_flux_up    ({icol+col_s_in-1, ilev}) = gpt_flux_up    ({icol, ilev, 1});
-                    sw_flux_dn    ({icol+col_s_in-1, ilev}) = gpt_flux_dn    ({icol, ilev, 1});
-                    sw_flux_dn_dir({icol+col_s_in-1, ilev}) = gpt_flux_dn_dir({icol, ilev, 1});
-                    sw_flux_net   ({icol+col_s_in-1, ilev}) = gpt_flux_dn({icol, ilev, 1}) - gpt_flux_up({icol, ilev, 1});
+                    sw_flux_up    ({cols_in[icol-1], ilev}) = gpt_flux_up    ({icol, ilev, 1});
+                    sw_flux_dn    ({cols_in[icol-1], ilev}) = gpt_flux_dn    ({icol, ilev, 1});
+                    sw_flux_dn_dir({cols_in[icol-1], ilev}) = gpt_flux_dn_dir({icol, ilev, 1});
+                    sw_flux_net   ({cols_in[icol-1], ilev}) = gpt_flux_dn({icol, ilev, 1}) - gpt_flux_up({icol, ilev, 1});
                 }
         }
+
+        // Heating rates of the block, directly from the net fluxes that are still in cache.
+        if (switch_heating_rates)
+        {
+            Timer::Region region("heating_rate");
+            if (gather)
+            {
+                Array<Float,2>& heating_rate_out = work.heating_rate;
+                Fluxes_broadband::heating_rate(get_block(sw_flux_net), p_lev_subset, heating_rate_out);
+                scatter_columns(heating_rate_out, sw_heating_rate, cols_in, 1);
+            }
+            else
+            {
+                Array<Float,2> heating_rate_out = sw_heating_rate.subset_view({{ {col_s_in, col_e_in}, {1, n_lay} }});
+                Fluxes_broadband::heating_rate(
+                        sw_flux_net.subset_view({{ {col_s_in, col_e_in}, {1, n_lev} }}), p_lev_subset, heating_rate_out);
+            }
+
+            if (switch_output_bnd_fluxes && gather)
+            {
+                Array<Float,3>& bnd_heating_rate_out = work.bnd_heating_rate;
+                Fluxes_broadband::heating_rate(
+                        bnd_fluxes.get_bnd_flux_net(), p_lev_subset, bnd_heating_rate_out);
+                scatter_columns(bnd_heating_rate_out, sw_bnd_heating_rate, cols_in, 1);
+            }
+            else if (switch_output_bnd_fluxes)
+            {
+                Array<Float,3> bnd_heating_rate_out = sw_bnd_heating_rate.subset_view({{ {col_s_in, col_e_in}, {1, n_lay}, {1, n_bnd} }});
+                Fluxes_broadband::heating_rate(
+                        bnd_fluxes.get_bnd_flux_net(), p_lev_subset, bnd_heating_rate_out);
+            }
+        }
     };
 
-    for (int b=1; b<=n_blocks; ++b)
+    // Solve the columns in cols per block, with the fluxes only if switch_fluxes_in is set.
+    auto solve_columns = [&](const std::vector<int>& cols, const bool switch_fluxes_in)
     {
-        const int col_s = (b-1) * n_col_block + 1;
-        const int col_e =  b    * n_col_block;
+        const int n_col_cols = cols.size();
+        const int n_blocks = n_col_cols / n_col_block;
+        const int n_col_block_residual = n_col_cols % n_col_block;
 
-        std::unique_ptr<Fluxes_broadband> fluxes_subset =
-                std::make_unique<Fluxes_broadband>(n_col_block, n_lev);
-        std::unique_ptr<Fluxes_broadband> bnd_fluxes_subset =
-                std::make_unique<Fluxes_byband>(n_col_block, n_lev, n_bnd);
-
-        call_kernels(
-                col_s, col_e,
-                optical_props_subset,
-                cloud_optical_props_subset,
-                aerosol_optical_props_subset,
-                *fluxes_subset,
-                *bnd_fluxes_subset);
-    }
+        for (int b=1; b<=n_blocks; ++b)
+        {
+            const std::vector<int> cols_block(
+                    cols.begin() + (b-1)*n_col_block, cols.begin() + b*n_col_block);
 
-    if (n_col_block_residual > 0)
-    {
-        const int col_s = n_col - n_col_block_residual + 1;
-        const int col_e = n_col;
+            call_kernels(cols_block, get_work(n_col_block), switch_fluxes_in);
+        }
 
-        std::unique_ptr<Fluxes_broadband> fluxes_residual =
-                std::make_unique<Fluxes_broadband>(n_col_block_residual, n_lev);
-        std::unique_ptr<Fluxes_broadband> bnd_fluxes_residual =
-                std::make_unique<Fluxes_byband>(n_col_block_residual, n_lev, n_bnd);
-
-        call_kernels(
-                col_s, col_e,
-                optical_props_residual,
-                cloud_optical_props_residual,
-                aerosol_optical_props_residual,
-                *fluxes_residual,
-                *bnd_fluxes_residual);
-    }
+        if (n_col_block_residual > 0)
+        {
+            const std::vector<int> cols_block(
+                    cols.end() - n_col_block_residual, cols.end());
+
+            call_kernels(cols_block, get_work(n_col_block_residual), switch_fluxes_in);
+        }
+    };
+
+    solve_columns(cols_sunlit, switch_fluxes);
+
+    if (switch_output_optical)
+        solve_columns(cols_night, false);
 }
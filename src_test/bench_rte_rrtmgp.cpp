@@ -0,0 +1,1042 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * benchmarking of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Status.h"
+#include "Array.h"
+#include "Aerosol_optics.h"
+#include "Cloud_optics.h"
+#include "Fluxes.h"
+#include "Gas_concs.h"
+#include "Gas_optics_rrtmgp.h"
+#include "Optical_props.h"
+#include "Rte_lw.h"
+#include "Rte_sw.h"
+#include "Source_functions.h"
+#include "types.h"
+
+
+namespace
+{
+    // Fastest wall-clock time in ms out of n_repeat calls of function, setup is not timed.
+    template<class Setup, class Function>
+    double time_min(Setup&& setup, Function&& function, const int n_repeat)
+    {
+        double time_min = std::numeric_limits<double>::max();
+        for (int n=0; n<n_repeat; ++n)
+        {
+            setup();
+
+            auto time_start = std::chrono::high_resolution_clock::now();
+            function();
+            auto time_end = std::chrono::high_resolution_clock::now();
+
+            time_min = std::min(time_min, std::chrono::duration<double, std::milli>(time_end-time_start).count());
+        }
+        return time_min;
+    }
+
+
+    void print_timing(const std::string& name, const double time, const double time_ref)
+    {
+        std::ostringstream ss;
+        ss << std::left << std::setw(40) << name
+           << std::right << std::setw(12) << std::fixed << std::setprecision(4) << time << " (ms)"
+           << std::setw(10) << std::setprecision(2) << time_ref/time << "x" << std::endl;
+        Status::print_message(ss);
+    }
+
+
+    // Time per call, columns per second and the effective bandwidth for n_bytes of compulsory traffic.
+    void print_throughput(const std::string& name, const double time, const int n_col, const double n_bytes)
+    {
+        std::ostringstream ss;
+        ss << std::left << std::setw(40) << name
+           << std::right << std::setw(12) << std::fixed << std::setprecision(4) << time << " (ms)"
+           << std::setw(12) << std::setprecision(3) << n_col/(time*1.e3) << " (Mcol/s)"
+           << std::setw(10) << std::setprecision(2) << n_bytes/(time*1.e6) << " (GB/s)" << std::endl;
+        Status::print_message(ss);
+    }
+
+
+    // Synthetic spectral discretization with n_gpt_per_bnd g-points in each band.
+    Optical_props make_optical_props(const int n_bnd, const int n_gpt_per_bnd)
+    {
+        Array<Float,2> band_lims_wvn({2, n_bnd});
+        Array<int,2> band_lims_gpt({2, n_bnd});
+
+        for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+        {
+            band_lims_wvn({1, ibnd}) = Float(100.)*(ibnd-1);
+            band_lims_wvn({2, ibnd}) = Float(100.)*ibnd;
+            band_lims_gpt({1, ibnd}) = (ibnd-1)*n_gpt_per_bnd + 1;
+            band_lims_gpt({2, ibnd}) =  ibnd   *n_gpt_per_bnd;
+        }
+
+        return Optical_props(band_lims_wvn, band_lims_gpt);
+    }
+
+
+    // Element-wise, such that strided views can be filled as well.
+    template<int N>
+    void fill_random(Array<Float,N>& array, const Float min, const Float max, std::mt19937& generator)
+    {
+        Array<Float,N> values(array.get_dims());
+        std::uniform_real_distribution<Float> distribution(min, max);
+        for (Float& v : values.v())
+            v = distribution(generator);
+        array = values;
+    }
+
+
+    void fill_random(Optical_props_2str& optical_props, std::mt19937& generator)
+    {
+        fill_random(optical_props.get_tau(), Float(0.), Float(2.), generator);
+        fill_random(optical_props.get_ssa(), Float(0.), Float(1.), generator);
+        fill_random(optical_props.get_g  (), Float(0.), Float(0.9), generator);
+    }
+
+
+    // Delta-scaling and adding the particle optical properties to the gas optical properties.
+    void bench_add_to_delta_scaled(
+            const Optical_props& gas_props, const Optical_props& particle_props,
+            const int n_col, const int n_lay, const int n_repeat, std::mt19937& generator)
+    {
+        Optical_props_2str gas(n_col, n_lay, gas_props);
+        Optical_props_2str gas_ref(n_col, n_lay, gas_props);
+        Optical_props_2str particles(n_col, n_lay, particle_props);
+        Optical_props_2str particles_ref(n_col, n_lay, particle_props);
+
+        fill_random(gas_ref, generator);
+        fill_random(particles_ref, generator);
+
+        auto reset = [&]()
+        {
+            gas.get_tau() = gas_ref.get_tau();
+            gas.get_ssa() = gas_ref.get_ssa();
+            gas.get_g  () = gas_ref.get_g  ();
+            particles.get_tau() = particles_ref.get_tau();
+            particles.get_ssa() = particles_ref.get_ssa();
+            particles.get_g  () = particles_ref.get_g  ();
+        };
+
+        const double time_three_pass = time_min(
+                reset,
+                [&]() { particles.delta_scale(); add_to(gas, particles); },
+                n_repeat);
+
+        const double time_fused = time_min(
+                reset,
+                [&]() { add_to_delta_scaled(gas, particles); },
+                n_repeat);
+
+        print_timing("delta_scale + add_to (by band)", time_three_pass, time_three_pass);
+        print_timing("add_to_delta_scaled (by band)", time_fused, time_three_pass);
+    }
+
+
+    std::string layout_name(const Optical_props_layout layout)
+    {
+        return (layout == Optical_props_layout::Separate) ? "separate" : "interleaved";
+    }
+
+
+    // Delta-scaling, adding and the shortwave solver for the separate and interleaved layouts.
+    void bench_layouts(
+            const Optical_props& gas_props, const Optical_props& particle_props,
+            const int n_col, const int n_lay, const int n_repeat, std::mt19937& generator)
+    {
+        const int n_gpt = gas_props.get_ngpt();
+        const int n_bnd = gas_props.get_nband();
+        const int n_lev = n_lay+1;
+
+        Array<Float,1> mu0({n_col});
+        Array<Float,2> inc_flux_dir({n_col, n_gpt});
+        Array<Float,2> sfc_alb_dir({n_bnd, n_col});
+        Array<Float,2> sfc_alb_dif({n_bnd, n_col});
+
+        fill_random(mu0, Float(0.1), Float(1.), generator);
+        fill_random(inc_flux_dir, Float(0.), Float(10.), generator);
+        fill_random(sfc_alb_dir, Float(0.), Float(0.3), generator);
+        fill_random(sfc_alb_dif, Float(0.), Float(0.3), generator);
+
+        Array<Float,3> flux_up ({n_col, n_lev, 1});
+        Array<Float,3> flux_dn ({n_col, n_lev, 1});
+        Array<Float,3> flux_dir({n_col, n_lev, 1});
+
+        Optical_props_2str gas_ref(n_col, n_lay, gas_props);
+        Optical_props_2str particles_ref(n_col, n_lay, particle_props);
+        fill_random(gas_ref, generator);
+        fill_random(particles_ref, generator);
+
+        double time_ref_add = 0.;
+        double time_ref_solver = 0.;
+
+        for (const Optical_props_layout layout : {Optical_props_layout::Separate, Optical_props_layout::Interleaved})
+        {
+            Optical_props_2str particles(n_col, n_lay, particle_props, layout);
+            std::unique_ptr<Optical_props_arry> gas =
+                    std::make_unique<Optical_props_2str>(n_col, n_lay, gas_props, layout);
+            Optical_props_2str& gas_2str = dynamic_cast<Optical_props_2str&>(*gas);
+
+            auto reset = [&]()
+            {
+                gas->get_tau() = gas_ref.get_tau();
+                gas->get_ssa() = gas_ref.get_ssa();
+                gas->get_g  () = gas_ref.get_g  ();
+                particles.get_tau() = particles_ref.get_tau();
+                particles.get_ssa() = particles_ref.get_ssa();
+                particles.get_g  () = particles_ref.get_g  ();
+            };
+
+            const double time_add = time_min(
+                    reset,
+                    [&]() { particles.delta_scale(); add_to(gas_2str, particles); },
+                    n_repeat);
+
+            const double time_solver = time_min(
+                    [](){},
+                    [&]()
+                    {
+                        Rte_sw::rte_sw(
+                                gas, true, mu0, inc_flux_dir,
+                                sfc_alb_dir, sfc_alb_dif, Array<Float,2>(),
+                                flux_up, flux_dn, flux_dir);
+                    },
+                    n_repeat);
+
+            if (layout == Optical_props_layout::Separate)
+            {
+                time_ref_add = time_add;
+                time_ref_solver = time_solver;
+            }
+
+            print_timing("delta_scale + add_to (" + layout_name(layout) + ")", time_add, time_ref_add);
+            print_timing("rte_sw (" + layout_name(layout) + ")", time_solver, time_ref_solver);
+        }
+
+        std::unique_ptr<Optical_props_arry> gas_direct =
+                std::make_unique<Optical_props_1scl>(n_col, n_lay, gas_props);
+        gas_direct->get_tau() = gas_ref.get_tau();
+
+        const double time_direct = time_min(
+                [](){},
+                [&]()
+                {
+                    Rte_sw::rte_sw(
+                            gas_direct, true, mu0, inc_flux_dir,
+                            sfc_alb_dir, sfc_alb_dif, Array<Float,2>(),
+                            flux_up, flux_dn, flux_dir);
+                },
+                n_repeat);
+
+        print_timing("rte_sw (direct beam only)", time_direct, time_ref_solver);
+
+        // Spherical geometry, with a cosine of the solar zenith angle per layer.
+        std::unique_ptr<Optical_props_arry> gas =
+                std::make_unique<Optical_props_2str>(n_col, n_lay, gas_props);
+        gas->get_tau() = gas_ref.get_tau();
+        gas->get_ssa() = gas_ref.get_ssa();
+        gas->get_g  () = gas_ref.get_g  ();
+
+        Array<Float,2> mu0_lay({n_col, n_lay});
+        for (int ilay=1; ilay<=n_lay; ++ilay)
+            for (int icol=1; icol<=n_col; ++icol)
+                mu0_lay({icol, ilay}) = mu0({icol});
+
+        const double time_mu0_lay = time_min(
+                [](){},
+                [&]()
+                {
+                    Rte_sw::rte_sw(
+                            gas, true, mu0, mu0_lay, inc_flux_dir,
+                            sfc_alb_dir, sfc_alb_dif, Array<Float,2>(),
+                            flux_up, flux_dn, flux_dir);
+                },
+                n_repeat);
+
+        print_timing("rte_sw (per-layer mu0)", time_mu0_lay, time_ref_solver);
+    }
+
+
+    // Shortwave solver for several solar geometries and surfaces with the same optical properties,
+    // a call per scenario compared to a single batched call.
+    void bench_sw_batched(
+            const Optical_props& gas_props,
+            const int n_col, const int n_lay, const int n_repeat, std::mt19937& generator)
+    {
+        constexpr int n_scen = 8;
+
+        const int n_gpt = gas_props.get_ngpt();
+        const int n_bnd = gas_props.get_nband();
+        const int n_lev = n_lay+1;
+
+        std::unique_ptr<Optical_props_arry> gas =
+                std::make_unique<Optical_props_2str>(n_col, n_lay, gas_props);
+        fill_random(dynamic_cast<Optical_props_2str&>(*gas), generator);
+
+        Array<Float,2> mu0({n_scen, n_col});
+        Array<Float,3> inc_flux_dir({n_scen, n_col, n_gpt});
+        Array<Float,3> sfc_alb_dir({n_scen, n_col, n_bnd});
+        Array<Float,3> sfc_alb_dif({n_scen, n_col, n_bnd});
+
+        fill_random(mu0, Float(0.1), Float(1.), generator);
+        fill_random(inc_flux_dir, Float(0.), Float(10.), generator);
+        fill_random(sfc_alb_dir, Float(0.), Float(0.3), generator);
+        fill_random(sfc_alb_dif, Float(0.), Float(0.3), generator);
+
+        // The same scenarios in the layout of the single-scenario solver.
+        std::vector<Array<Float,1>> mu0_scen(n_scen, Array<Float,1>({n_col}));
+        std::vector<Array<Float,2>> inc_flux_dir_scen(n_scen, Array<Float,2>({n_col, n_gpt}));
+        std::vector<Array<Float,2>> sfc_alb_dir_scen(n_scen, Array<Float,2>({n_bnd, n_col}));
+        std::vector<Array<Float,2>> sfc_alb_dif_scen(n_scen, Array<Float,2>({n_bnd, n_col}));
+
+        for (int iscen=1; iscen<=n_scen; ++iscen)
+            for (int icol=1; icol<=n_col; ++icol)
+            {
+                mu0_scen[iscen-1]({icol}) = mu0({iscen, icol});
+                for (int igpt=1; igpt<=n_gpt; ++igpt)
+                    inc_flux_dir_scen[iscen-1]({icol, igpt}) = inc_flux_dir({iscen, icol, igpt});
+                for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+                {
+                    sfc_alb_dir_scen[iscen-1]({ibnd, icol}) = sfc_alb_dir({iscen, icol, ibnd});
+                    sfc_alb_dif_scen[iscen-1]({ibnd, icol}) = sfc_alb_dif({iscen, icol, ibnd});
+                }
+            }
+
+        Array<Float,3> flux_up ({n_col, n_lev, 1});
+        Array<Float,3> flux_dn ({n_col, n_lev, 1});
+        Array<Float,3> flux_dir({n_col, n_lev, 1});
+
+        const double time_ref = time_min(
+                [](){},
+                [&]()
+                {
+                    for (int iscen=0; iscen<n_scen; ++iscen)
+                        Rte_sw::rte_sw(
+                                gas, true, mu0_scen[iscen], inc_flux_dir_scen[iscen],
+                                sfc_alb_dir_scen[iscen], sfc_alb_dif_scen[iscen], Array<Float,2>(),
+                                flux_up, flux_dn, flux_dir);
+                },
+                n_repeat);
+
+        Array<Float,3> flux_up_batched ({n_scen, n_col, n_lev});
+        Array<Float,3> flux_dn_batched ({n_scen, n_col, n_lev});
+        Array<Float,3> flux_dir_batched({n_scen, n_col, n_lev});
+
+        const double time_batched = time_min(
+                [](){},
+                [&]()
+                {
+                    Rte_sw::rte_sw_batched(
+                            gas, true, mu0, inc_flux_dir, sfc_alb_dir, sfc_alb_dif,
+                            flux_up_batched, flux_dn_batched, flux_dir_batched);
+                },
+                n_repeat);
+
+        print_timing("rte_sw (8 scenarios, a call each)", time_ref, time_ref);
+        print_timing("rte_sw_batched (8 scenarios)", time_batched, time_ref);
+    }
+
+
+    // Reduction of the g-point fluxes to broadband and band fluxes, compared to a single read of the g-point fluxes.
+    void bench_fluxes(
+            const Optical_props& gas_props,
+            const int n_col, const int n_lay, const int n_repeat, std::mt19937& generator)
+    {
+        const int n_gpt = gas_props.get_ngpt();
+        const int n_bnd = gas_props.get_nband();
+        const int n_lev = n_lay+1;
+
+        const std::unique_ptr<Optical_props_arry> spectral_disc =
+                std::make_unique<Optical_props_1scl>(n_col, n_lay, gas_props);
+
+        Array<Float,3> gpt_flux_up ({n_col, n_lev, n_gpt});
+        Array<Float,3> gpt_flux_dn ({n_col, n_lev, n_gpt});
+        Array<Float,3> gpt_flux_dir({n_col, n_lev, n_gpt});
+        fill_random(gpt_flux_up , Float(0.), Float(10.), generator);
+        fill_random(gpt_flux_dn , Float(0.), Float(10.), generator);
+        fill_random(gpt_flux_dir, Float(0.), Float(10.), generator);
+
+        Array<Float,2> flux_sum({n_col, n_lev});
+
+        const double time_read = time_min(
+                [](){},
+                [&]()
+                {
+                    const int n = n_col*n_lev;
+                    flux_sum.fill(Float(0.));
+                    for (int igpt=0; igpt<n_gpt; ++igpt)
+                        for (int i=0; i<n; ++i)
+                            flux_sum.ptr()[i] += gpt_flux_up .ptr()[igpt*n + i]
+                                               + gpt_flux_dn .ptr()[igpt*n + i]
+                                               + gpt_flux_dir.ptr()[igpt*n + i];
+                },
+                n_repeat);
+
+        Fluxes_byband fluxes(n_col, n_lev, n_bnd);
+
+        const double time_reduce = time_min(
+                [](){},
+                [&]() { fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dir, spectral_disc, true); },
+                n_repeat);
+
+        // Three bins spread over the spectrum, each overlapping a few bands partly.
+        const Array<Float,2>& band_lims_wvn = gas_props.get_band_lims_wavenumber();
+        const Float wvn_min = band_lims_wvn({1, 1});
+        const Float wvn_max = band_lims_wvn({2, n_bnd});
+
+        Array<Float,2> bin_lims_wvn({2, 3});
+        for (int ibin=1; ibin<=3; ++ibin)
+        {
+            bin_lims_wvn({1, ibin}) = wvn_min + (wvn_max-wvn_min)*(Float(ibin)-Float(0.8))/Float(3.);
+            bin_lims_wvn({2, ibin}) = wvn_min + (wvn_max-wvn_min)*(Float(ibin)-Float(0.3))/Float(3.);
+        }
+
+        Fluxes_custom_bins bin_fluxes(
+                n_col, n_lev,
+                Fluxes_custom_bins::bin_weights(band_lims_wvn, gas_props.get_band_lims_gpoint(), bin_lims_wvn));
+
+        const double time_reduce_bins = time_min(
+                [](){},
+                [&]() { bin_fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dir, spectral_disc, true); },
+                n_repeat);
+
+        print_timing("single read of g-point fluxes", time_read, time_read);
+        print_timing("Fluxes_byband::reduce (with dir)", time_reduce, time_read);
+        print_timing("Fluxes_custom_bins::reduce (3 bins)", time_reduce_bins, time_read);
+    }
+
+
+    // Longwave solver with fluxes per g-point, per band and broadband, and the costs of the scattering modes.
+    void bench_lw(
+            const Optical_props& gas_props,
+            const int n_col, const int n_lay, const int n_repeat, std::mt19937& generator)
+    {
+        const int n_gpt = gas_props.get_ngpt();
+        const int n_bnd = gas_props.get_nband();
+        const int n_lev = n_lay+1;
+
+        std::unique_ptr<Optical_props_arry> optical_props =
+                std::make_unique<Optical_props_2str>(n_col, n_lay, gas_props);
+        fill_random(optical_props->get_tau(), Float(0.), Float(2.), generator);
+        fill_random(optical_props->get_ssa(), Float(0.), Float(1.), generator);
+        fill_random(optical_props->get_g  (), Float(0.), Float(0.9), generator);
+
+        Source_func_lw sources(n_col, n_lay, gas_props);
+        fill_random(sources.get_sfc_source(), Float(0.), Float(10.), generator);
+        fill_random(sources.get_lay_source(), Float(0.), Float(10.), generator);
+        fill_random(sources.get_lev_source_inc(), Float(0.), Float(10.), generator);
+        fill_random(sources.get_lev_source_dec(), Float(0.), Float(10.), generator);
+
+        Array<Float,2> sfc_emis({n_bnd, n_col});
+        fill_random(sfc_emis, Float(0.9), Float(1.), generator);
+
+        auto time_rte_lw = [&](const int n_flx, const Lw_scattering scattering)
+        {
+            Array<Float,3> flux_up({n_col, n_lev, n_flx});
+            Array<Float,3> flux_dn({n_col, n_lev, n_flx});
+
+            return time_min(
+                    [](){},
+                    [&]()
+                    {
+                        Rte_lw::rte_lw(
+                                optical_props, true, sources, sfc_emis, Array<Float,2>(),
+                                flux_up, flux_dn, 1, scattering);
+                    },
+                    n_repeat);
+        };
+
+        const double time_ref = time_rte_lw(n_gpt, Lw_scattering::None);
+        print_timing("rte_lw (per g-point)", time_ref, time_ref);
+        print_timing("rte_lw (by band)", time_rte_lw(n_bnd, Lw_scattering::None), time_ref);
+
+        const double time_ref_broadband = time_rte_lw(1, Lw_scattering::None);
+        print_timing("rte_lw (broadband)", time_ref_broadband, time_ref);
+        print_timing("rte_lw rescaling (broadband)", time_rte_lw(1, Lw_scattering::Rescaling), time_ref_broadband);
+        print_timing("rte_lw two-stream (broadband)", time_rte_lw(1, Lw_scattering::Two_stream), time_ref_broadband);
+
+        // Surface temperature Jacobian, and the update of the upward flux with it between full solves.
+        fill_random(sources.get_sfc_source_jac(), Float(0.), Float(0.1), generator);
+
+        Array<Float,3> flux_up({n_col, n_lev, 1});
+        Array<Float,3> flux_dn({n_col, n_lev, 1});
+        Array<Float,2> flux_up_jac({n_col, n_lev});
+
+        const double time_jacobian = time_min(
+                [](){},
+                [&]()
+                {
+                    Rte_lw::rte_lw(
+                            optical_props, true, sources, sfc_emis, Array<Float,2>(),
+                            flux_up, flux_dn, flux_up_jac, 1);
+                },
+                n_repeat);
+
+        Array<Float,2> flux_up_ref(flux_up.v(), {n_col, n_lev});
+        Array<Float,2> flux_up_new({n_col, n_lev});
+        Array<Float,1> t_sfc_ref({n_col});
+        Array<Float,1> t_sfc({n_col});
+        fill_random(t_sfc_ref, Float(280.), Float(300.), generator);
+        fill_random(t_sfc, Float(280.), Float(300.), generator);
+
+        const double time_update = time_min(
+                [](){},
+                [&]() { Rte_lw::update_flux_up(flux_up_ref, flux_up_jac, t_sfc_ref, t_sfc, flux_up_new); },
+                n_repeat);
+
+        print_timing("rte_lw with Jacobian (broadband)", time_jacobian, time_ref_broadband);
+        print_timing("update_flux_up", time_update, time_ref_broadband);
+    }
+
+
+    // Synthetic atmosphere with the surface at the first level, and h2o, co2 and o3.
+    struct Atmosphere
+    {
+        Array<Float,2> p_lay;
+        Array<Float,2> p_lev;
+        Array<Float,2> t_lay;
+        Array<Float,2> t_lev;
+        Array<Float,1> t_sfc;
+        Array<Float,2> col_dry;
+        Gas_concs gas_concs;
+    };
+
+
+    Atmosphere make_atmosphere(const int n_col, const int n_lay, std::mt19937& generator)
+    {
+        const int n_lev = n_lay+1;
+
+        Atmosphere atm;
+        atm.p_lay.set_dims({n_col, n_lay});
+        atm.p_lev.set_dims({n_col, n_lev});
+        atm.t_lay.set_dims({n_col, n_lay});
+        atm.t_lev.set_dims({n_col, n_lev});
+        atm.t_sfc.set_dims({n_col});
+        atm.col_dry.set_dims({n_col, n_lay});
+
+        Array<Float,1> dt_col({n_col});
+        fill_random(dt_col, Float(-10.), Float(10.), generator);
+
+        // Levels equidistant in log-pressure from 1000 to 1 hPa, with a linear temperature profile.
+        for (int ilev=1; ilev<=n_lev; ++ilev)
+            for (int icol=1; icol<=n_col; ++icol)
+            {
+                const Float frac = Float(ilev-1) / n_lay;
+                atm.p_lev({icol, ilev}) = Float(1.e5) * std::pow(Float(1.e-3), frac);
+                atm.t_lev({icol, ilev}) = Float(290.) - Float(80.)*frac + dt_col({icol});
+            }
+
+        for (int ilay=1; ilay<=n_lay; ++ilay)
+            for (int icol=1; icol<=n_col; ++icol)
+            {
+                atm.p_lay({icol, ilay}) = std::sqrt(atm.p_lev({icol, ilay}) * atm.p_lev({icol, ilay+1}));
+                atm.t_lay({icol, ilay}) = Float(0.5) * (atm.t_lev({icol, ilay}) + atm.t_lev({icol, ilay+1}));
+            }
+
+        for (int icol=1; icol<=n_col; ++icol)
+            atm.t_sfc({icol}) = atm.t_lev({icol, 1}) + Float(1.);
+
+        Array<Float,2> h2o({n_col, n_lay});
+        Array<Float,2> o3({n_col, n_lay});
+        fill_random(h2o, Float(1.e-6), Float(1.e-2), generator);
+        fill_random(o3, Float(1.e-8), Float(1.e-5), generator);
+
+        atm.gas_concs.set_vmr("h2o", h2o);
+        atm.gas_concs.set_vmr("co2", Float(4.e-4));
+        atm.gas_concs.set_vmr("o3", o3);
+
+        Gas_optics_rrtmgp::get_col_dry(atm.col_dry, h2o, atm.p_lev);
+
+        return atm;
+    }
+
+
+    // Synthetic k-distribution with the table dimensions of RRTMGP. The key species are h2o with
+    // co2 or o3 below the tropopause and o3 with co2 above, and o3 is a minor absorber in every band.
+    std::unique_ptr<Gas_optics_rrtmgp> make_gas_optics(
+            const Gas_concs& gas_concs, const int n_bnd, const int n_gpt_per_bnd,
+            const bool longwave, std::mt19937& generator)
+    {
+        constexpr int n_temps = 14;
+        constexpr int n_press = 59;
+        constexpr int n_mixingfracs = 9;
+        constexpr int n_layers = 2;
+        constexpr int n_planck_temps = 196;
+        constexpr int n_gas = 3;
+
+        const int n_gpt = n_bnd*n_gpt_per_bnd;
+        const Optical_props spectral_disc = make_optical_props(n_bnd, n_gpt_per_bnd);
+
+        Array<std::string,1> gas_names({n_gas});
+        gas_names({1}) = "h2o";
+        gas_names({2}) = "co2";
+        gas_names({3}) = "o3";
+
+        Array<int,3> key_species({2, n_layers, n_bnd});
+        for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+        {
+            key_species({1, 1, ibnd}) = 1;
+            key_species({2, 1, ibnd}) = (ibnd % 2 == 0) ? 3 : 2;
+            key_species({1, 2, ibnd}) = 3;
+            key_species({2, 2, ibnd}) = 2;
+        }
+
+        // Reference pressures from 1100 hPa to 1 Pa, and temperatures from 160 to 355 K.
+        Array<Float,1> press_ref({n_press});
+        for (int ipress=1; ipress<=n_press; ++ipress)
+            press_ref({ipress}) = Float(1.1e5) * std::pow(Float(1.)/Float(1.1e5), Float(ipress-1)/(n_press-1));
+
+        Array<Float,1> temp_ref({n_temps});
+        for (int itemp=1; itemp<=n_temps; ++itemp)
+            temp_ref({itemp}) = Float(160.) + Float(15.)*(itemp-1);
+
+        Array<Float,3> vmr_ref({n_layers, n_gas+1, n_temps});
+        fill_random(vmr_ref, Float(1.e-6), Float(1.e-2), generator);
+
+        Array<Float,4> kmajor({n_gpt, n_mixingfracs, n_press+1, n_temps});
+        fill_random(kmajor, Float(1.e-25), Float(1.e-23), generator);
+
+        // A minor absorber interval per band, used in both the lower and the upper atmosphere.
+        Array<std::string,1> gas_minor({1});
+        gas_minor({1}) = "o3";
+        Array<std::string,1> identifier_minor(gas_minor);
+
+        Array<std::string,1> minor_gases({n_bnd});
+        Array<std::string,1> scaling_gas({n_bnd});
+        Array<int,2> minor_limits_gpt({2, n_bnd});
+        Array<Bool,1> minor_scales_with_density({n_bnd});
+        Array<Bool,1> scale_by_complement({n_bnd});
+        Array<int,1> kminor_start({n_bnd});
+
+        for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+        {
+            minor_gases({ibnd}) = "o3";
+            scaling_gas({ibnd}) = "h2o";
+            minor_limits_gpt({1, ibnd}) = spectral_disc.get_band_lims_gpoint()({1, ibnd});
+            minor_limits_gpt({2, ibnd}) = spectral_disc.get_band_lims_gpoint()({2, ibnd});
+            kminor_start({ibnd}) = (ibnd-1)*n_gpt_per_bnd + 1;
+        }
+
+        Array<Float,3> kminor({n_gpt, n_mixingfracs, n_temps});
+        fill_random(kminor, Float(1.e-27), Float(1.e-25), generator);
+
+        if (longwave)
+        {
+            Array<Float,2> totplnk({n_planck_temps, n_bnd});
+            Array<Float,4> planck_frac({n_gpt, n_mixingfracs, n_press+1, n_temps});
+            fill_random(totplnk, Float(1.), Float(100.), generator);
+            fill_random(planck_frac, Float(0.), Float(2.)/n_gpt_per_bnd, generator);
+
+            return std::make_unique<Gas_optics_rrtmgp>(
+                    gas_concs, gas_names, key_species,
+                    spectral_disc.get_band_lims_gpoint(), spectral_disc.get_band_lims_wavenumber(),
+                    press_ref, Float(9948.43), temp_ref, Float(500.), Float(250.),
+                    vmr_ref, kmajor, kminor, kminor,
+                    gas_minor, identifier_minor, minor_gases, minor_gases,
+                    minor_limits_gpt, minor_limits_gpt,
+                    minor_scales_with_density, minor_scales_with_density,
+                    scaling_gas, scaling_gas,
+                    scale_by_complement, scale_by_complement,
+                    kminor_start, kminor_start,
+                    totplnk, planck_frac,
+                    Array<Float,3>(), Array<Float,3>());
+        }
+        else
+        {
+            Array<Float,1> solar_src_quiet({n_gpt});
+            Array<Float,1> solar_src_facular({n_gpt});
+            Array<Float,1> solar_src_sunspot({n_gpt});
+            fill_random(solar_src_quiet, Float(0.), Float(10.), generator);
+            fill_random(solar_src_facular, Float(0.), Float(0.1), generator);
+            fill_random(solar_src_sunspot, Float(-0.1), Float(0.), generator);
+
+            Array<Float,3> rayl_lower({n_gpt, n_mixingfracs, n_temps});
+            Array<Float,3> rayl_upper({n_gpt, n_mixingfracs, n_temps});
+            fill_random(rayl_lower, Float(1.e-29), Float(1.e-27), generator);
+            fill_random(rayl_upper, Float(1.e-29), Float(1.e-27), generator);
+
+            return std::make_unique<Gas_optics_rrtmgp>(
+                    gas_concs, gas_names, key_species,
+                    spectral_disc.get_band_lims_gpoint(), spectral_disc.get_band_lims_wavenumber(),
+                    press_ref, Float(9948.43), temp_ref, Float(500.), Float(250.),
+                    vmr_ref, kmajor, kminor, kminor,
+                    gas_minor, identifier_minor, minor_gases, minor_gases,
+                    minor_limits_gpt, minor_limits_gpt,
+                    minor_scales_with_density, minor_scales_with_density,
+                    scaling_gas, scaling_gas,
+                    scale_by_complement, scale_by_complement,
+                    kminor_start, kminor_start,
+                    solar_src_quiet, solar_src_facular, solar_src_sunspot,
+                    Float(1360.9), Float(0.1567), Float(902.7),
+                    rayl_lower, rayl_upper);
+        }
+    }
+
+
+    // Gas optics from synthetic tables, the internal source is computed in the longwave gas_optics call.
+    void bench_gas_optics(
+            const Atmosphere& atm, const int n_gpt_per_bnd, const int n_repeat, std::mt19937& generator)
+    {
+        const int n_col = atm.p_lay.dim(1);
+        const int n_lay = atm.p_lay.dim(2);
+        const double n_col_lay = double(n_col)*n_lay;
+
+        Array<Float,2> col_dry({n_col, n_lay});
+        const double time_col_dry = time_min(
+                [](){},
+                [&]() { Gas_optics_rrtmgp::get_col_dry(col_dry, atm.gas_concs.get_vmr("h2o"), atm.p_lev); },
+                n_repeat);
+        print_throughput("get_col_dry", time_col_dry, n_col, sizeof(Float)*3*n_col_lay);
+
+        std::unique_ptr<Gas_optics_rrtmgp> kdist_lw = make_gas_optics(atm.gas_concs, 16, n_gpt_per_bnd, true, generator);
+        const int n_gpt_lw = kdist_lw->get_ngpt();
+
+        std::unique_ptr<Optical_props_arry> optical_props_lw =
+                std::make_unique<Optical_props_1scl>(n_col, n_lay, *kdist_lw);
+        Source_func_lw sources(n_col, n_lay, *kdist_lw);
+
+        const double time_lw = time_min(
+                [](){},
+                [&]()
+                {
+                    kdist_lw->gas_optics(
+                            atm.p_lay, atm.p_lev, atm.t_lay, atm.t_sfc, atm.gas_concs,
+                            optical_props_lw, sources, atm.col_dry, atm.t_lev);
+                },
+                n_repeat);
+
+        // The tau and the layer and two level sources are written per g-point.
+        print_throughput("gas_optics + source (lw)", time_lw, n_col, sizeof(Float)*4*n_col_lay*n_gpt_lw);
+
+        std::unique_ptr<Gas_optics_rrtmgp> kdist_sw = make_gas_optics(atm.gas_concs, 14, n_gpt_per_bnd, false, generator);
+        const int n_gpt_sw = kdist_sw->get_ngpt();
+
+        std::unique_ptr<Optical_props_arry> optical_props_sw =
+                std::make_unique<Optical_props_2str>(n_col, n_lay, *kdist_sw);
+        Array<Float,2> toa_src({n_col, n_gpt_sw});
+
+        const double time_sw = time_min(
+                [](){},
+                [&]()
+                {
+                    kdist_sw->gas_optics(
+                            atm.p_lay, atm.p_lev, atm.t_lay, atm.gas_concs,
+                            optical_props_sw, toa_src, atm.col_dry);
+                },
+                n_repeat);
+
+        // The tau, ssa and g are written per g-point.
+        print_throughput("gas_optics (sw)", time_sw, n_col, sizeof(Float)*3*n_col_lay*n_gpt_sw);
+    }
+
+
+    // Cloud optics for the longwave and shortwave bands and aerosol optics for the shortwave bands.
+    void bench_particle_optics(
+            const Atmosphere& atm, const int n_repeat, std::mt19937& generator)
+    {
+        const int n_col = atm.p_lay.dim(1);
+        const int n_lay = atm.p_lay.dim(2);
+        const double n_col_lay = double(n_col)*n_lay;
+
+        constexpr int n_size_liq = 20;
+        constexpr int n_size_ice = 18;
+        constexpr int n_rghice = 3;
+
+        // Half of the layers is cloudy.
+        Array<Float,2> lwp({n_col, n_lay});
+        Array<Float,2> iwp({n_col, n_lay});
+        Array<Float,2> rel({n_col, n_lay});
+        Array<Float,2> rei({n_col, n_lay});
+        fill_random(lwp, Float(-0.1), Float(0.1), generator);
+        fill_random(iwp, Float(-0.1), Float(0.1), generator);
+        fill_random(rel, Float(3.), Float(20.), generator);
+        fill_random(rei, Float(20.), Float(150.), generator);
+        for (Float& v : lwp.v())
+            v = std::max(v, Float(0.));
+        for (Float& v : iwp.v())
+            v = std::max(v, Float(0.));
+
+        auto make_cloud_optics = [&](const int n_bnd)
+        {
+            Array<Float,2> lut_extliq({n_size_liq, n_bnd});
+            Array<Float,2> lut_ssaliq({n_size_liq, n_bnd});
+            Array<Float,2> lut_asyliq({n_size_liq, n_bnd});
+            Array<Float,3> lut_extice({n_size_ice, n_bnd, n_rghice});
+            Array<Float,3> lut_ssaice({n_size_ice, n_bnd, n_rghice});
+            Array<Float,3> lut_asyice({n_size_ice, n_bnd, n_rghice});
+
+            fill_random(lut_extliq, Float(0.), Float(100.), generator);
+            fill_random(lut_ssaliq, Float(0.5), Float(1.), generator);
+            fill_random(lut_asyliq, Float(0.7), Float(0.9), generator);
+            fill_random(lut_extice, Float(0.), Float(100.), generator);
+            fill_random(lut_ssaice, Float(0.5), Float(1.), generator);
+            fill_random(lut_asyice, Float(0.7), Float(0.9), generator);
+
+            return Cloud_optics(
+                    make_optical_props(n_bnd, 1).get_band_lims_wavenumber(),
+                    Float(2.5), Float(21.5), Float(1.), Float(10.), Float(180.), Float(1.),
+                    lut_extliq, lut_ssaliq, lut_asyliq,
+                    lut_extice, lut_ssaice, lut_asyice);
+        };
+
+        Cloud_optics cloud_optics_lw = make_cloud_optics(16);
+        Optical_props_1scl cloud_props_lw(n_col, n_lay, cloud_optics_lw);
+
+        const double time_cloud_lw = time_min(
+                [](){},
+                [&]() { cloud_optics_lw.cloud_optics(lwp, iwp, rel, rei, cloud_props_lw); },
+                n_repeat);
+        print_throughput("cloud_optics (lw, 1scl)", time_cloud_lw, n_col, sizeof(Float)*(4+16)*n_col_lay);
+
+        Cloud_optics cloud_optics_sw = make_cloud_optics(14);
+        Optical_props_2str cloud_props_sw(n_col, n_lay, cloud_optics_sw);
+
+        const double time_cloud_sw = time_min(
+                [](){},
+                [&]() { cloud_optics_sw.cloud_optics(lwp, iwp, rel, rei, cloud_props_sw); },
+                n_repeat);
+        print_throughput("cloud_optics (sw, 2str)", time_cloud_sw, n_col, sizeof(Float)*(4+3*14)*n_col_lay);
+
+        // Aerosol optics with the hydrophobic and hydrophilic species that the kernel looks up.
+        constexpr int n_bnd_sw = 14;
+        constexpr int n_hum = 12;
+        constexpr int n_phobic = 11;
+        constexpr int n_philic = 5;
+
+        Array<Float,1> rh_upper({n_hum});
+        for (int ihum=1; ihum<=n_hum; ++ihum)
+            rh_upper({ihum}) = Float(ihum) / n_hum;
+
+        Array<Float,2> mext_phobic({n_bnd_sw, n_phobic});
+        Array<Float,2> ssa_phobic({n_bnd_sw, n_phobic});
+        Array<Float,2> g_phobic({n_bnd_sw, n_phobic});
+        Array<Float,3> mext_philic({n_bnd_sw, n_hum, n_philic});
+        Array<Float,3> ssa_philic({n_bnd_sw, n_hum, n_philic});
+        Array<Float,3> g_philic({n_bnd_sw, n_hum, n_philic});
+
+        fill_random(mext_phobic, Float(0.), Float(1.e3), generator);
+        fill_random(ssa_phobic, Float(0.5), Float(1.), generator);
+        fill_random(g_phobic, Float(0.5), Float(0.9), generator);
+        fill_random(mext_philic, Float(0.), Float(1.e3), generator);
+        fill_random(ssa_philic, Float(0.5), Float(1.), generator);
+        fill_random(g_philic, Float(0.5), Float(0.9), generator);
+
+        Aerosol_optics aerosol_optics(
+                make_optical_props(n_bnd_sw, 1).get_band_lims_wavenumber(), rh_upper,
+                mext_phobic, ssa_phobic, g_phobic,
+                mext_philic, ssa_philic, g_philic);
+
+        Aerosol_concs aerosol_concs;
+        for (int i=1; i<=11; ++i)
+        {
+            Array<Float,2> aermr({n_col, n_lay});
+            fill_random(aermr, Float(0.), Float(1.e-8), generator);
+            aerosol_concs.set_vmr(i<10 ? "aermr0"+std::to_string(i) : "aermr"+std::to_string(i), aermr);
+        }
+
+        Array<Float,2> rh({n_col, n_lay});
+        fill_random(rh, Float(0.), Float(0.99), generator);
+
+        Optical_props_2str aerosol_props(n_col, n_lay, aerosol_optics);
+
+        const double time_aerosol = time_min(
+                [](){},
+                [&]() { aerosol_optics.aerosol_optics(aerosol_concs, rh, atm.p_lev, aerosol_props); },
+                n_repeat);
+        print_throughput("aerosol_optics (sw)", time_aerosol, n_col, sizeof(Float)*(13+3*n_bnd_sw)*n_col_lay);
+    }
+
+
+    // Solvers, flux reduction and the column blocking with Array::subset, as in the radiation solver.
+    void bench_kernels(
+            const Optical_props& gas_props,
+            const int n_col, const int n_lay, const int n_repeat, std::mt19937& generator)
+    {
+        const int n_gpt = gas_props.get_ngpt();
+        const int n_bnd = gas_props.get_nband();
+        const int n_lev = n_lay+1;
+        const double n_col_lay_gpt = double(n_col)*n_lay*n_gpt;
+
+        std::unique_ptr<Optical_props_arry> optical_props =
+                std::make_unique<Optical_props_2str>(n_col, n_lay, gas_props);
+        fill_random(dynamic_cast<Optical_props_2str&>(*optical_props), generator);
+
+        Source_func_lw sources(n_col, n_lay, gas_props);
+        fill_random(sources.get_sfc_source(), Float(0.), Float(10.), generator);
+        fill_random(sources.get_lay_source(), Float(0.), Float(10.), generator);
+        fill_random(sources.get_lev_source_inc(), Float(0.), Float(10.), generator);
+        fill_random(sources.get_lev_source_dec(), Float(0.), Float(10.), generator);
+
+        Array<Float,2> sfc_emis({n_bnd, n_col});
+        fill_random(sfc_emis, Float(0.9), Float(1.), generator);
+
+        Array<Float,3> flux_up ({n_col, n_lev, 1});
+        Array<Float,3> flux_dn ({n_col, n_lev, 1});
+        Array<Float,3> flux_dir({n_col, n_lev, 1});
+
+        const double time_lw = time_min(
+                [](){},
+                [&]()
+                {
+                    Rte_lw::rte_lw(
+                            optical_props, true, sources, sfc_emis, Array<Float,2>(),
+                            flux_up, flux_dn, 1);
+                },
+                n_repeat);
+
+        // The tau and the three sources are read per g-point.
+        print_throughput("rte_lw (broadband)", time_lw, n_col, sizeof(Float)*4*n_col_lay_gpt);
+
+        Array<Float,1> mu0({n_col});
+        Array<Float,2> inc_flux_dir({n_col, n_gpt});
+        Array<Float,2> sfc_alb_dir({n_bnd, n_col});
+        Array<Float,2> sfc_alb_dif({n_bnd, n_col});
+        fill_random(mu0, Float(0.1), Float(1.), generator);
+        fill_random(inc_flux_dir, Float(0.), Float(10.), generator);
+        fill_random(sfc_alb_dir, Float(0.), Float(0.3), generator);
+        fill_random(sfc_alb_dif, Float(0.), Float(0.3), generator);
+
+        const double time_sw = time_min(
+                [](){},
+                [&]()
+                {
+                    Rte_sw::rte_sw(
+                            optical_props, true, mu0, inc_flux_dir,
+                            sfc_alb_dir, sfc_alb_dif, Array<Float,2>(),
+                            flux_up, flux_dn, flux_dir);
+                },
+                n_repeat);
+
+        // The tau, ssa and g are read per g-point.
+        print_throughput("rte_sw (broadband)", time_sw, n_col, sizeof(Float)*3*n_col_lay_gpt);
+
+        Array<Float,3> gpt_flux_up ({n_col, n_lev, n_gpt});
+        Array<Float,3> gpt_flux_dn ({n_col, n_lev, n_gpt});
+        Array<Float,3> gpt_flux_dir({n_col, n_lev, n_gpt});
+        fill_random(gpt_flux_up , Float(0.), Float(10.), generator);
+        fill_random(gpt_flux_dn , Float(0.), Float(10.), generator);
+        fill_random(gpt_flux_dir, Float(0.), Float(10.), generator);
+
+        Fluxes_broadband fluxes_broadband(n_col, n_lev);
+        const double time_reduce_broadband = time_min(
+                [](){},
+                [&]() { fluxes_broadband.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dir, optical_props, true); },
+                n_repeat);
+        print_throughput("Fluxes_broadband::reduce", time_reduce_broadband, n_col, sizeof(Float)*3*double(n_col)*n_lev*n_gpt);
+
+        Fluxes_byband fluxes_byband(n_col, n_lev, n_bnd);
+        const double time_reduce_byband = time_min(
+                [](){},
+                [&]() { fluxes_byband.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dir, optical_props, true); },
+                n_repeat);
+        print_throughput("Fluxes_byband::reduce", time_reduce_byband, n_col, sizeof(Float)*3*double(n_col)*n_lev*n_gpt);
+
+        // The blocks of the radiation solver, a read and a write of every element.
+        constexpr int n_col_block = 12;
+
+        Array<Float,2> field_2d({n_col, n_lev});
+        fill_random(field_2d, Float(0.), Float(1.), generator);
+        Float sum = 0.;
+
+        const double time_subset_2d = time_min(
+                [](){},
+                [&]()
+                {
+                    for (int col_s=1; col_s<=n_col; col_s+=n_col_block)
+                    {
+                        const int col_e = std::min(col_s+n_col_block-1, n_col);
+                        const Array<Float,2> block = field_2d.subset({{ {col_s, col_e}, {1, n_lev} }});
+                        sum += block({1, 1});
+                    }
+                },
+                n_repeat);
+        print_throughput("Array::subset (2d, 12 columns)", time_subset_2d, n_col, sizeof(Float)*2*double(n_col)*n_lev);
+
+        const Array<Float,3>& tau = optical_props->get_tau();
+        const double time_subset_3d = time_min(
+                [](){},
+                [&]()
+                {
+                    for (int col_s=1; col_s<=n_col; col_s+=n_col_block)
+                    {
+                        const int col_e = std::min(col_s+n_col_block-1, n_col);
+                        const Array<Float,3> block = tau.subset({{ {col_s, col_e}, {1, n_lay}, {1, n_gpt} }});
+                        sum += block({1, 1, 1});
+                    }
+                },
+                n_repeat);
+        print_throughput("Array::subset (3d, 12 columns)", time_subset_3d, n_col, sizeof(Float)*2*n_col_lay_gpt);
+
+        // Keep the result alive, such that the subsets are not optimized away.
+        if (sum < Float(0.))
+            Status::print_message("Negative checksum");
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    const int n_col         = (argc > 1) ? std::stoi(argv[1]) : 128;
+    const int n_lay         = (argc > 2) ? std::stoi(argv[2]) : 64;
+    const int n_repeat      = (argc > 3) ? std::stoi(argv[3]) : 20;
+    const int n_gpt_per_bnd = (argc > 4) ? std::stoi(argv[4]) : 16;
+
+    // Shortwave-like spectral discretization.
+    constexpr int n_bnd = 14;
+
+    Status::print_message("###### Starting RTE+RRTMGP benchmark ######");
+    Status::print_message(
+            "n_col = " + std::to_string(n_col) + ", n_lay = " + std::to_string(n_lay)
+            + ", n_gpt = " + std::to_string(n_bnd*n_gpt_per_bnd) + ", n_repeat = " + std::to_string(n_repeat));
+
+    std::mt19937 generator(1);
+
+    const Optical_props gas_props = make_optical_props(n_bnd, n_gpt_per_bnd);
+    const Optical_props particle_props = make_optical_props(n_bnd, 1);
+
+    bench_add_to_delta_scaled(gas_props, particle_props, n_col, n_lay, n_repeat, generator);
+    bench_layouts(gas_props, particle_props, n_col, n_lay, n_repeat, generator);
+    bench_sw_batched(gas_props, n_col, n_lay, n_repeat, generator);
+    bench_fluxes(gas_props, n_col, n_lay, n_repeat, generator);
+
+    // Longwave-like spectral discretization.
+    const Optical_props lw_gas_props = make_optical_props(16, n_gpt_per_bnd);
+    bench_lw(lw_gas_props, n_col, n_lay, n_repeat, generator);
+
+    // Throughput of the kernels of the radiation solver, from synthetic tables and profiles.
+    Status::print_message("###### Kernel throughput ######");
+
+    const Atmosphere atm = make_atmosphere(n_col, n_lay, generator);
+
+    bench_gas_optics(atm, n_gpt_per_bnd, n_repeat, generator);
+    bench_particle_optics(atm, n_repeat, generator);
+    bench_kernels(gas_props, n_col, n_lay, n_repeat, generator);
+
+    return 0;
+}
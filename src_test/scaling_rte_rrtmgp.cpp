@@ -0,0 +1,648 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * measurement of the scaling of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "Status.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Radiation_solver.h"
+#include "types.h"
+
+
+namespace
+{
+    // Comma separated list of integers, for instance "1,2,4,8".
+    std::vector<int> parse_list(const std::string& list)
+    {
+        std::vector<int> values;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            values.push_back(std::stoi(item));
+
+        if (values.empty())
+            throw std::runtime_error("Empty list in argument: " + list);
+
+        std::sort(values.begin(), values.end());
+        return values;
+    }
+
+
+    std::vector<int> default_thread_counts()
+    {
+        const int n_thread_max = std::max(1, int(std::thread::hardware_concurrency()));
+
+        std::vector<int> n_threads;
+        for (int n=1; n<n_thread_max; n*=2)
+            n_threads.push_back(n);
+        n_threads.push_back(n_thread_max);
+
+        return n_threads;
+    }
+
+
+    // Reset the peak resident set size, such that the high-water mark is measured per case.
+    // This works on Linux only, elsewhere the high-water mark is that of the process.
+    void reset_peak_memory()
+    {
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        if (clear_refs)
+            clear_refs << "5";
+    }
+
+
+    // Peak resident set size in MB.
+    double peak_memory_mb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmHWM:") == 0)
+                return std::stod(line.substr(6)) / 1024.;
+        }
+
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.;
+    }
+
+
+    // Current resident set size in MB, zero if unavailable.
+    double current_memory_mb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmRSS:") == 0)
+                return std::stod(line.substr(6)) / 1024.;
+        }
+
+        return 0.;
+    }
+
+
+    bool file_exists(const std::string& file_name)
+    {
+        std::ifstream file(file_name);
+        return file.good();
+    }
+
+
+    // Synthetic domain with a standard-atmosphere-like profile, with the surface at the first level,
+    // a cloud in the lower troposphere in half of the columns, and aerosols everywhere.
+    struct Domain
+    {
+        Gas_concs gas_concs;
+        Aerosol_concs aerosol_concs;
+
+        Array<Float,2> p_lay;
+        Array<Float,2> p_lev;
+        Array<Float,2> t_lay;
+        Array<Float,2> t_lev;
+
+        Array<Float,1> t_sfc;
+        Array<Float,2> emis_sfc;
+
+        Array<Float,1> mu0;
+        Array<Float,1> tsi_scaling;
+        Array<Float,2> sfc_alb_dir;
+        Array<Float,2> sfc_alb_dif;
+
+        Array<Float,2> lwp;
+        Array<Float,2> iwp;
+        Array<Float,2> rel;
+        Array<Float,2> rei;
+        Array<Float,2> rh;
+    };
+
+
+    Domain make_domain(
+            const int n_col, const int n_lay, const int n_bnd_lw, const int n_bnd_sw,
+            std::mt19937& generator)
+    {
+        const int n_lev = n_lay+1;
+
+        std::uniform_real_distribution<Float> dist(Float(0.), Float(1.));
+
+        Domain d;
+        d.p_lay.set_dims({n_col, n_lay});
+        d.p_lev.set_dims({n_col, n_lev});
+        d.t_lay.set_dims({n_col, n_lay});
+        d.t_lev.set_dims({n_col, n_lev});
+
+        // Levels equidistant in log-pressure from 1000 hPa to 10 Pa.
+        for (int icol=1; icol<=n_col; ++icol)
+        {
+            const Float dt = Float(10.) * (dist(generator) - Float(0.5));
+            for (int ilev=1; ilev<=n_lev; ++ilev)
+            {
+                const Float p = Float(1.e5) * std::pow(Float(1.e-4), Float(ilev-1)/n_lay);
+                d.p_lev({icol, ilev}) = p;
+                d.t_lev({icol, ilev}) = std::max(Float(288.) * std::pow(p/Float(1.e5), Float(0.19)), Float(216.65)) + dt;
+            }
+        }
+
+        Array<Float,2> h2o({n_col, n_lay});
+        Array<Float,2> o3({n_col, n_lay});
+
+        for (int ilay=1; ilay<=n_lay; ++ilay)
+            for (int icol=1; icol<=n_col; ++icol)
+            {
+                const Float p = std::sqrt(d.p_lev({icol, ilay}) * d.p_lev({icol, ilay+1}));
+                d.p_lay({icol, ilay}) = p;
+                d.t_lay({icol, ilay}) = Float(0.5) * (d.t_lev({icol, ilay}) + d.t_lev({icol, ilay+1}));
+
+                h2o({icol, ilay}) = std::max(Float(1.5e-2) * std::pow(p/Float(1.e5), Float(3.)), Float(4.e-6));
+                o3 ({icol, ilay}) = Float(8.e-6) * std::exp(-std::pow(std::log(p/Float(1.e3)), Float(2.)) / Float(2.))
+                                  + Float(3.e-8);
+            }
+
+        d.gas_concs.set_vmr("h2o", h2o);
+        d.gas_concs.set_vmr("o3" , o3);
+        d.gas_concs.set_vmr("co2", Float(4.e-4));
+        d.gas_concs.set_vmr("ch4", Float(1.8e-6));
+        d.gas_concs.set_vmr("n2o", Float(3.2e-7));
+        d.gas_concs.set_vmr("o2" , Float(0.209));
+        d.gas_concs.set_vmr("n2" , Float(0.781));
+
+        // Surface and sun.
+        d.t_sfc.set_dims({n_col});
+        d.emis_sfc.set_dims({n_bnd_lw, n_col});
+        d.mu0.set_dims({n_col});
+        d.tsi_scaling.set_dims({n_col});
+        d.sfc_alb_dir.set_dims({n_bnd_sw, n_col});
+        d.sfc_alb_dif.set_dims({n_bnd_sw, n_col});
+
+        for (int icol=1; icol<=n_col; ++icol)
+        {
+            d.t_sfc({icol}) = d.t_lev({icol, 1}) + Float(1.);
+            d.mu0({icol}) = Float(0.2) + Float(0.8)*dist(generator);
+            d.tsi_scaling({icol}) = Float(1.);
+
+            for (int ibnd=1; ibnd<=n_bnd_lw; ++ibnd)
+                d.emis_sfc({ibnd, icol}) = Float(0.98);
+
+            for (int ibnd=1; ibnd<=n_bnd_sw; ++ibnd)
+            {
+                d.sfc_alb_dir({ibnd, icol}) = Float(0.07);
+                d.sfc_alb_dif({ibnd, icol}) = Float(0.07);
+            }
+        }
+
+        // Liquid and ice water path in g/m2, following the allsky case.
+        d.lwp.set_dims({n_col, n_lay});
+        d.iwp.set_dims({n_col, n_lay});
+        d.rel.set_dims({n_col, n_lay});
+        d.rei.set_dims({n_col, n_lay});
+        d.rh.set_dims({n_col, n_lay});
+
+        for (int icol=1; icol<=n_col; ++icol)
+        {
+            const bool cloudy = dist(generator) < Float(0.5);
+            for (int ilay=1; ilay<=n_lay; ++ilay)
+            {
+                const Float p = d.p_lay({icol, ilay});
+                const Float t = d.t_lay({icol, ilay});
+                const bool in_cloud = cloudy && p < Float(9.e4) && p > Float(2.e4);
+
+                d.lwp({icol, ilay}) = (in_cloud && t > Float(263.)) ? Float(10.) : Float(0.);
+                d.iwp({icol, ilay}) = (in_cloud && t < Float(273.)) ? Float(10.) : Float(0.);
+                d.rel({icol, ilay}) = (d.lwp({icol, ilay}) > Float(0.)) ? Float(12.) : Float(0.);
+                d.rei({icol, ilay}) = (d.iwp({icol, ilay}) > Float(0.)) ? Float(95.) : Float(0.);
+                d.rh ({icol, ilay}) = std::min(Float(0.9) * std::pow(p/Float(1.e5), Float(2.)) + Float(0.05), Float(0.99));
+            }
+        }
+
+        for (int i=1; i<=11; ++i)
+        {
+            Array<Float,2> aermr({n_col, n_lay});
+            for (Float& v : aermr.v())
+                v = Float(1.e-9) * dist(generator);
+
+            d.aerosol_concs.set_vmr((i < 10 ? "aermr0" : "aermr") + std::to_string(i), aermr);
+        }
+
+        return d;
+    }
+
+
+    struct Case
+    {
+        bool longwave;
+        bool clouds;
+        bool aerosols;
+    };
+
+
+    // Solve the domains of all threads at once, each thread has its own domain and output,
+    // and the solvers are shared. Returns the fastest of the repeats in seconds.
+    double time_solve(
+            const Case& c,
+            const Radiation_solver_longwave& rad_lw, const Radiation_solver_shortwave& rad_sw,
+            const std::vector<Domain>& domains, const int n_repeat)
+    {
+        const int n_thread = domains.size();
+
+        // Only the broadband fluxes are computed, as in a model.
+        struct Output
+        {
+            Array<Float,2> flux_up;
+            Array<Float,2> flux_dn;
+            Array<Float,2> flux_dn_dir;
+            Array<Float,2> flux_net;
+
+            // The work arrays of the solvers are kept over the repeats, as over the time steps of a model.
+            Radiation_solver_longwave::Workspace lw_workspace;
+            Radiation_solver_shortwave::Workspace sw_workspace;
+        };
+
+        std::vector<Output> outputs(n_thread);
+        for (int i=0; i<n_thread; ++i)
+        {
+            const int n_col = domains[i].p_lay.dim(1);
+            const int n_lev = domains[i].p_lev.dim(2);
+            outputs[i].flux_up .set_dims({n_col, n_lev});
+            outputs[i].flux_dn .set_dims({n_col, n_lev});
+            outputs[i].flux_net.set_dims({n_col, n_lev});
+            if (!c.longwave)
+                outputs[i].flux_dn_dir.set_dims({n_col, n_lev});
+        }
+
+        auto solve = [&](const int i)
+        {
+            const Domain& d = domains[i];
+            Output& out = outputs[i];
+
+            Array<Float,2> col_dry;
+            Array<Float,2> bin_lims_wvn;
+            Array<Float,3> empty_3d;
+
+            if (c.longwave)
+            {
+                Array<Float,3> lw_tau, lay_source, lev_source_inc, lev_source_dec;
+                Array<Float,2> sfc_source;
+                Array<Float,3> lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net;
+                Array<Float,3> lw_bin_flux_up, lw_bin_flux_dn, lw_bin_flux_net;
+                Array<Float,2> lw_flux_up_jac, lw_heating_rate;
+
+                rad_lw.solve(
+                        true, c.clouds, false, false, false, false, false, false, false,
+                        d.gas_concs,
+                        d.p_lay, d.p_lev, d.t_lay, d.t_lev, col_dry,
+                        d.t_sfc, d.emis_sfc,
+                        d.lwp, d.iwp, d.rel, d.rei,
+                        bin_lims_wvn,
+                        lw_tau, lay_source, lev_source_inc, lev_source_dec, sfc_source,
+                        out.flux_up, out.flux_dn, out.flux_net,
+                        lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net,
+                        lw_flux_up_jac,
+                        lw_heating_rate, empty_3d,
+                        lw_bin_flux_up, lw_bin_flux_dn, lw_bin_flux_net,
+                        &out.lw_workspace);
+            }
+            else
+            {
+                Array<Float,3> sw_tau, ssa, g;
+                Array<Float,2> toa_source;
+                Array<Float,3> sw_bnd_flux_up, sw_bnd_flux_dn, sw_bnd_flux_dn_dir, sw_bnd_flux_net;
+                Array<Float,3> sw_bin_flux_up, sw_bin_flux_dn, sw_bin_flux_dn_dir, sw_bin_flux_net;
+                Array<Float,2> sw_heating_rate;
+
+                rad_sw.solve(
+                        true, c.clouds, c.aerosols, false, false, false, false, false, false, false, false,
+                        d.gas_concs,
+                        d.p_lay, d.p_lev, d.t_lay, d.t_lev, col_dry,
+                        d.sfc_alb_dir, d.sfc_alb_dif,
+                        d.tsi_scaling, d.mu0,
+                        d.lwp, d.iwp, d.rel, d.rei,
+                        d.rh, d.aerosol_concs,
+                        bin_lims_wvn,
+                        sw_tau, ssa, g, toa_source,
+                        out.flux_up, out.flux_dn, out.flux_dn_dir, out.flux_net,
+                        sw_bnd_flux_up, sw_bnd_flux_dn, sw_bnd_flux_dn_dir, sw_bnd_flux_net,
+                        sw_heating_rate, empty_3d,
+                        sw_bin_flux_up, sw_bin_flux_dn, sw_bin_flux_dn_dir, sw_bin_flux_net,
+                        &out.sw_workspace);
+            }
+        };
+
+        double time_min = std::numeric_limits<double>::max();
+
+        for (int irep=0; irep<n_repeat; ++irep)
+        {
+            // The first error of any thread is rethrown after the threads are joined.
+            std::vector<std::exception_ptr> errors(n_thread);
+            std::vector<std::thread> threads;
+
+            auto time_start = std::chrono::high_resolution_clock::now();
+
+            for (int i=0; i<n_thread; ++i)
+                threads.emplace_back([&, i]
+                {
+                    try
+                    {
+                        solve(i);
+                    }
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
+                    }
+                });
+
+            for (std::thread& thread : threads)
+                thread.join();
+
+            auto time_end = std::chrono::high_resolution_clock::now();
+
+            for (const std::exception_ptr& error : errors)
+                if (error)
+                    std::rethrow_exception(error);
+
+            time_min = std::min(time_min, std::chrono::duration<double>(time_end-time_start).count());
+        }
+
+        return time_min;
+    }
+
+
+    // Shortwave output of the night column check.
+    struct Sw_check_output
+    {
+        Array<Float,3> tau, ssa, g;
+        Array<Float,2> toa_source;
+        Array<Float,2> flux_up, flux_dn, flux_dn_dir, flux_net;
+    };
+
+
+    Sw_check_output solve_sw_check(const Radiation_solver_shortwave& rad_sw, const Domain& d)
+    {
+        const int n_col = d.p_lay.dim(1);
+        const int n_lay = d.p_lay.dim(2);
+        const int n_lev = d.p_lev.dim(2);
+        const int n_gpt = rad_sw.get_n_gpt();
+
+        Sw_check_output out;
+        out.tau.set_dims({n_col, n_lay, n_gpt});
+        out.ssa.set_dims({n_col, n_lay, n_gpt});
+        out.g.set_dims({n_col, n_lay, n_gpt});
+        out.toa_source.set_dims({n_col, n_gpt});
+        out.flux_up.set_dims({n_col, n_lev});
+        out.flux_dn.set_dims({n_col, n_lev});
+        out.flux_dn_dir.set_dims({n_col, n_lev});
+        out.flux_net.set_dims({n_col, n_lev});
+
+        Array<Float,2> col_dry;
+        Array<Float,2> bin_lims_wvn;
+        Array<Float,2> sw_heating_rate;
+        Array<Float,3> sw_bnd_flux_up, sw_bnd_flux_dn, sw_bnd_flux_dn_dir, sw_bnd_flux_net;
+        Array<Float,3> sw_bin_flux_up, sw_bin_flux_dn, sw_bin_flux_dn_dir, sw_bin_flux_net;
+        Array<Float,3> empty_3d;
+
+        rad_sw.solve(
+                true, true, false, true, false, false, false, false, false, false, false,
+                d.gas_concs,
+                d.p_lay, d.p_lev, d.t_lay, d.t_lev, col_dry,
+                d.sfc_alb_dir, d.sfc_alb_dif,
+                d.tsi_scaling, d.mu0,
+                d.lwp, d.iwp, d.rel, d.rei,
+                d.rh, d.aerosol_concs,
+                bin_lims_wvn,
+                out.tau, out.ssa, out.g, out.toa_source,
+                out.flux_up, out.flux_dn, out.flux_dn_dir, out.flux_net,
+                sw_bnd_flux_up, sw_bnd_flux_dn, sw_bnd_flux_dn_dir, sw_bnd_flux_net,
+                sw_heating_rate, empty_3d,
+                sw_bin_flux_up, sw_bin_flux_dn, sw_bin_flux_dn_dir, sw_bin_flux_net);
+
+        return out;
+    }
+
+
+    // Check that the sunlit columns of a domain with night columns, which the solver gathers per block,
+    // get the same fluxes as in a domain without night columns, that the night columns have no fluxes,
+    // and that the optical properties of all columns are unaffected.
+    void check_night_columns(const Radiation_solver_shortwave& rad_sw, const Domain& d_day)
+    {
+        const int n_col = d_day.p_lay.dim(1);
+
+        Domain d_mixed = d_day;
+        for (int icol=1; icol<=n_col; icol+=3)
+            d_mixed.mu0({icol}) = Float(-0.5);
+
+        const Sw_check_output out_day = solve_sw_check(rad_sw, d_day);
+        const Sw_check_output out_mixed = solve_sw_check(rad_sw, d_mixed);
+
+        // The columns are the first dimension, the night columns have zero fluxes.
+        auto check_equal = [&](const std::string& name, const auto& ref, const auto& value, const bool is_flux)
+        {
+            for (int i=0; i<ref.size(); ++i)
+            {
+                const int icol = i % n_col + 1;
+                const bool is_night = d_mixed.mu0({icol}) <= Float(0.);
+
+                const Float expected = (is_flux && is_night) ? Float(0.) : ref.v()[i];
+                const Float tolerance = Float(1.e-5) * std::max(std::abs(expected), Float(1.));
+                if (std::abs(value.v()[i] - expected) > tolerance)
+                    throw std::runtime_error(
+                            "Night column check failed for " + name + " in column " + std::to_string(icol));
+            }
+        };
+
+        check_equal("flux_up", out_day.flux_up, out_mixed.flux_up, true);
+        check_equal("flux_dn", out_day.flux_dn, out_mixed.flux_dn, true);
+        check_equal("flux_dn_dir", out_day.flux_dn_dir, out_mixed.flux_dn_dir, true);
+        check_equal("flux_net", out_day.flux_net, out_mixed.flux_net, true);
+        check_equal("tau", out_day.tau, out_mixed.tau, false);
+        check_equal("ssa", out_day.ssa, out_mixed.ssa, false);
+        check_equal("g", out_day.g, out_mixed.g, false);
+        check_equal("toa_source", out_day.toa_source, out_mixed.toa_source, false);
+    }
+}
+
+
+void run_scaling(int argc, char** argv)
+{
+    const int n_col = (argc > 1) ? std::stoi(argv[1]) : 768;
+    const std::vector<int> n_threads    = (argc > 2) ? parse_list(argv[2]) : default_thread_counts();
+    const std::vector<int> n_col_blocks = (argc > 3) ? parse_list(argv[3]) : std::vector<int>{4, 12, 48};
+    const std::vector<int> n_lays       = (argc > 4) ? parse_list(argv[4]) : std::vector<int>{64, 128};
+    const int n_repeat = (argc > 5) ? std::stoi(argv[5]) : 3;
+
+    Status::print_message("###### Starting RTE+RRTMGP scaling benchmark ######");
+    Status::print_message(
+            "n_col = " + std::to_string(n_col) + " (strong scaling total, weak scaling per thread)"
+            + ", n_repeat = " + std::to_string(n_repeat));
+
+    std::mt19937 generator(1);
+
+    const bool has_aerosol_optics = file_exists("aerosol_optics.nc");
+    if (!has_aerosol_optics)
+        Status::print_warning("No aerosol_optics.nc found, the cases with aerosols are skipped.");
+
+    // The solvers only need the names of the gases.
+    const Domain init_domain = make_domain(1, n_lays.front(), 1, 1, generator);
+
+    Status::print_message("Initializing the solvers.");
+    Radiation_solver_longwave rad_lw(init_domain.gas_concs, "coefficients_lw.nc", "cloud_coefficients_lw.nc");
+    Radiation_solver_shortwave rad_sw(
+            init_domain.gas_concs, true, has_aerosol_optics,
+            "coefficients_sw.nc", "cloud_coefficients_sw.nc", "aerosol_optics.nc");
+
+    const int n_bnd_lw = rad_lw.get_n_bnd();
+    const int n_bnd_sw = rad_sw.get_n_bnd();
+
+    // The block size is smaller than the domain, such that blocks mix sunlit and night columns.
+    Status::print_message("Checking the shortwave solver with night columns.");
+    rad_sw.set_n_col_block(4);
+    check_night_columns(rad_sw, make_domain(22, n_lays.front(), n_bnd_lw, n_bnd_sw, generator));
+
+    std::ofstream csv("rte_rrtmgp_scaling.csv");
+    if (!csv)
+        throw std::runtime_error("Cannot open rte_rrtmgp_scaling.csv for writing");
+
+    csv << "band,scaling,n_thread,n_col,n_lay,n_col_block,clouds,aerosols,"
+        << "time_s,columns_per_s,columns_per_s_per_core,efficiency,memory_domain_mb,memory_solve_mb\n";
+    csv << std::setprecision(6);
+
+    for (const int n_lay : n_lays)
+        for (const bool longwave : {true, false})
+            for (const bool clouds : {false, true})
+                for (const bool aerosols : {false, true})
+                {
+                    if (aerosols && (longwave || !has_aerosol_optics))
+                        continue;
+
+                    for (const int n_col_block : n_col_blocks)
+                        for (const bool weak : {false, true})
+                        {
+                            const Case c{longwave, clouds, aerosols};
+
+                            rad_lw.set_n_col_block(n_col_block);
+                            rad_sw.set_n_col_block(n_col_block);
+
+                            // The efficiency is relative to the smallest thread count.
+                            double time_ref = -1.;
+                            int n_thread_ref = -1;
+
+                            for (const int n_thread : n_threads)
+                            {
+                                // Strong scaling divides a fixed domain over the threads,
+                                // weak scaling gives each thread a domain of n_col columns.
+                                std::vector<Domain> domains;
+                                int n_col_total = 0;
+                                for (int i=0; i<n_thread; ++i)
+                                {
+                                    const int n_col_thread = weak ? n_col
+                                            : n_col/n_thread + (i < n_col%n_thread ? 1 : 0);
+                                    if (n_col_thread == 0)
+                                        continue;
+
+                                    domains.push_back(make_domain(n_col_thread, n_lay, n_bnd_lw, n_bnd_sw, generator));
+                                    n_col_total += n_col_thread;
+                                }
+
+                                // Threads without columns are skipped, thus the cores in use are the domains.
+                                const int n_core = domains.size();
+
+                                // The memory of the solve is the high-water mark above the resident size
+                                // after the domains are built, which is reported separately.
+                                reset_peak_memory();
+                                const double memory_domain = current_memory_mb();
+                                const double time = time_solve(c, rad_lw, rad_sw, domains, n_repeat);
+                                const double memory_solve = peak_memory_mb() - memory_domain;
+
+                                if (time_ref < 0.)
+                                {
+                                    time_ref = time;
+                                    n_thread_ref = n_core;
+                                }
+
+                                const double efficiency = weak
+                                        ? time_ref / time
+                                        : (time_ref*n_thread_ref) / (time*n_core);
+
+                                const double columns_per_s = n_col_total / time;
+
+                                csv << (longwave ? "lw" : "sw") << ","
+                                    << (weak ? "weak" : "strong") << ","
+                                    << n_core << "," << n_col_total << "," << n_lay << ","
+                                    << n_col_block << "," << clouds << "," << aerosols << ","
+                                    << time << "," << columns_per_s << ","
+                                    << columns_per_s / n_core << "," << efficiency << ","
+                                    << memory_domain << "," << memory_solve << "\n";
+
+                                std::ostringstream message;
+                                message << std::setw(3) << (longwave ? "lw" : "sw") << " "
+                                        << std::setw(6) << (weak ? "weak" : "strong")
+                                        << " n_thread = " << std::setw(3) << n_core
+                                        << " n_lay = " << std::setw(4) << n_lay
+                                        << " n_col_block = " << std::setw(4) << n_col_block
+                                        << " clouds = " << clouds << " aerosols = " << aerosols
+                                        << std::fixed << std::setprecision(1)
+                                        << " : " << std::setw(10) << columns_per_s / n_core << " (col/s/core)"
+                                        << std::setprecision(2)
+                                        << std::setw(7) << efficiency << " (eff)"
+                                        << std::setprecision(1)
+                                        << std::setw(9) << memory_solve << " (MB solve)";
+                                Status::print_message(message);
+                            }
+                        }
+                }
+
+    Status::print_message("Wrote rte_rrtmgp_scaling.csv");
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        run_scaling(argc, argv);
+    }
+
+    // Catch any exceptions and return 1.
+    catch (const std::exception& e)
+    {
+        std::string error = "EXCEPTION: " + std::string(e.what());
+        Status::print_message(error);
+        return 1;
+    }
+    catch (...)
+    {
+        Status::print_message("UNHANDLED EXCEPTION!");
+        return 1;
+    }
+
+    // Return 0 in case of normal exit.
+    return 0;
+}
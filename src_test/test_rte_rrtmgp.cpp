@@ -18,18 +18,51 @@
 
 #include <boost/algorithm/string.hpp>
 #include <chrono>
+#include <cstdlib>
+#include <future>
 #include <iomanip>
+#include <memory>
+#include <numeric>
 
 #include "Status.h"
 #include "Netcdf_interface.h"
 #include "Array.h"
 #include "Aerosol_optics.h"
+#include "Array_accounting.h"
 #include "Radiation_solver.h"
+#include "Timer.h"
 #include "types.h"
 
 
+// Gases and aerosols that are read from the input if available.
+const std::vector<std::string> input_gas_names = {
+    "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+    "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125",
+    "hfc23", "hfc32", "hfc134a", "cf4", "no2" };
+
+const std::vector<std::string> input_aerosol_names = {
+    "aermr01", "aermr02", "aermr03", "aermr04", "aermr05", "aermr06",
+    "aermr07", "aermr08", "aermr09", "aermr10", "aermr11" };
+
+
+// Check whether a variable is a ((time,) lay, y, x) field of the domain, which is read per tile.
+bool is_tile_field(
+        const std::string& name, const int n_col_x, const int n_col_y, const int n_lay,
+        const Netcdf_handle& input_nc)
+{
+    if (!input_nc.variable_exists(name))
+        return false;
+
+    std::map<std::string, int> dims = input_nc.get_variable_dimensions(name);
+    dims.erase("time");
+
+    return dims == std::map<std::string, int>{{"lay", n_lay}, {"y", n_col_y}, {"x", n_col_x}};
+}
+
+
+// Read a gas that is given as a scalar or a profile, the fields are read per tile.
 void read_and_set_vmr(
-        const std::string& gas_name, const int n_col_x, const int n_col_y, const int n_lay,
+        const std::string& gas_name, const int n_lay,
         const Netcdf_handle& input_nc, Gas_concs& gas_concs)
 {
     const std::string vmr_gas_name = "vmr_" + gas_name;
@@ -43,22 +76,15 @@ void read_and_set_vmr(
         {
             gas_concs.set_vmr(gas_name, input_nc.get_variable<Float>(vmr_gas_name));
         }
-        else if (n_dims == 1)
+        else if (n_dims == 1 && dims.count("lay") && dims.at("lay") == n_lay)
         {
-            if (dims.at("lay") == n_lay)
-                gas_concs.set_vmr(gas_name,
-                        Array<Float,1>(input_nc.get_variable<Float>(vmr_gas_name, {n_lay}), {n_lay}));
-            else
-                throw std::runtime_error("Illegal dimensions of gas \"" + gas_name + "\" in input");
-        }
-        else if (n_dims == 3)
-        {
-            if (dims.at("lay") == n_lay && dims.at("x") == n_col_x && dims.at("y") == n_col_y)
-                gas_concs.set_vmr(gas_name,
-                        Array<Float,2>(input_nc.get_variable<Float>(vmr_gas_name, {n_lay, n_col_y, n_col_x}), {n_col_x * n_col_y, n_lay}));
-            else
-                throw std::runtime_error("Illegal dimensions of gas \"" + gas_name + "\" in input");
+            // The profile is read straight into the storage that the gas concentrations take over.
+            Array<Float,2> vmr({1, n_lay});
+            input_nc.get_variable(vmr, vmr_gas_name, {0}, {n_lay});
+            gas_concs.set_vmr(gas_name, std::move(vmr));
         }
+        else
+            throw std::runtime_error("Illegal dimensions of gas \"" + gas_name + "\" in input");
     }
     else
     {
@@ -66,8 +92,9 @@ void read_and_set_vmr(
     }
 }
 
+// Read an aerosol that is given as a profile, the fields are read per tile.
 void read_and_set_aer(
-        const std::string& aerosol_name, const int n_col_x, const int n_col_y, const int n_lay,
+        const std::string& aerosol_name, const int n_lay,
         const Netcdf_handle& input_nc, Aerosol_concs& aerosol_concs)
 {
     if (input_nc.variable_exists(aerosol_name))
@@ -75,21 +102,11 @@ void read_and_set_aer(
         std::map<std::string, int> dims = input_nc.get_variable_dimensions(aerosol_name);
         const int n_dims = dims.size();
 
-        if (n_dims == 1)
-        {
-            if (dims.at("lay") == n_lay)
-                aerosol_concs.set_vmr(aerosol_name,
-                        Array<Float,1>(input_nc.get_variable<Float>(aerosol_name, {n_lay}), {n_lay}));
-            else
-                throw std::runtime_error("Illegal dimensions of gas \"" + aerosol_name + "\" in input");
-        }
-        else if (n_dims == 3)
+        if (n_dims == 1 && dims.count("lay") && dims.at("lay") == n_lay)
         {
-            if (dims.at("lay") == n_lay && dims.at("x") == n_col_x && dims.at("y") == n_col_y)
-                aerosol_concs.set_vmr(aerosol_name,
-                        Array<Float,2>(input_nc.get_variable<Float>(aerosol_name, {n_lay, n_col_y, n_col_x}), {n_col_x * n_col_y, n_lay}));
-            else
-                throw std::runtime_error("Illegal dimensions of \"" + aerosol_name + "\" in input");
+            Array<Float,2> aermr({1, n_lay});
+            input_nc.get_variable(aermr, aerosol_name, {0}, {n_lay});
+            aerosol_concs.set_vmr(aerosol_name, std::move(aermr));
         }
         else
             throw std::runtime_error("Illegal dimensions of \"" + aerosol_name + "\" in input");
@@ -101,6 +118,27 @@ void read_and_set_aer(
 }
 
 
+// Read the wavenumber limits (cm-1) of the spectral output bins, or use the defaults if not in the input.
+Array<Float,2> read_bin_lims(
+        const std::string& bin_lims_name, const std::string& bin_dim_name,
+        const Netcdf_handle& input_nc, const std::vector<Float>& default_bin_lims)
+{
+    if (input_nc.variable_exists(bin_lims_name))
+    {
+        const int n_bin = input_nc.get_variable_dimensions(bin_lims_name).at(bin_dim_name);
+        Array<Float,2> bin_lims({2, n_bin});
+        input_nc.get_variable(bin_lims, bin_lims_name, {0, 0}, {n_bin, 2});
+        return bin_lims;
+    }
+    else
+    {
+        const int n_bin = default_bin_lims.size() / 2;
+        return Array<Float,2>(default_bin_lims, {2, n_bin});
+    }
+}
+
+
+
 
 bool parse_command_line_options(
         std::map<std::string, std::pair<bool, std::string>>& command_line_options,
@@ -168,26 +206,128 @@ void print_command_line_options(
 }
 
 
-void solve_radiation(int argc, char** argv)
+
+// Check whether a variable exists and has a time dimension.
+bool has_time_dimension(const std::string& name, const Netcdf_handle& input_nc)
 {
-    Status::print_message("###### Starting RTE+RRTMGP solver ######");
+    return input_nc.variable_exists(name) && input_nc.get_variable_dimensions(name).count("time");
+}
 
-    ////// FLOW CONTROL SWITCHES //////
-    // Parse the command line options.
-    std::map<std::string, std::pair<bool, std::string>> command_line_options {
-        {"shortwave"        , { true,  "Enable computation of shortwave radiation."}},
-        {"longwave"         , { true,  "Enable computation of longwave radiation." }},
-        {"fluxes"           , { true,  "Enable computation of fluxes."             }},
-        {"cloud-optics"     , { false, "Enable cloud optics."                      }},
-        {"aerosol-optics"   , { false, "Enable aerosol optics."                    }},
-        {"output-optical"   , { false, "Enable output of optical properties."      }},
-        {"output-bnd-fluxes", { false, "Enable output of band fluxes."             }},
-        {"delta-cloud"      , { true,  "delta-scaling of cloud optical properties"   }},
-        {"delta-aerosol"    , { false, "delta-scaling of aerosol optical properties" }}};
 
-    if (parse_command_line_options(command_line_options, argc, argv))
-        return;
+// Prepend time step i_time to the hyperslab of a variable that has a time dimension.
+void add_time_step(
+        const bool has_time, const int i_time,
+        std::vector<int>& i_start, std::vector<int>& i_count)
+{
+    if (has_time)
+    {
+        i_start.insert(i_start.begin(), i_time);
+        i_count.insert(i_count.begin(), 1);
+    }
+}
+
+
+// Queue the read of a hyperslab, at time step i_time if the variable has a time dimension according
+// to has_time, which is resolved once such that queueing does not call the NetCDF library.
+// The read reuses the storage of the array in storage, if any.
+template<int N>
+std::future<Array<Float,N>> prefetch_slab(
+        const std::string& name, const std::array<int,N>& dims,
+        const int i_time, std::vector<int> i_start, std::vector<int> i_count,
+        const std::map<std::string, bool>& has_time, Netcdf_batch_reader& batch_nc,
+        Array<Float,N>&& storage=Array<Float,N>())
+{
+    add_time_step(has_time.at(name), i_time, i_start, i_count);
+    return batch_nc.get_variable<Float,N>(std::move(storage), name, dims, i_start, i_count);
+}
+
+
+// Queue the read of the rows [j_start, j_start+n_y) of a ((time,) n_z, y, x) field into a (n_col_x*n_y, n_z) array.
+std::future<Array<Float,2>> prefetch_tile_field(
+        const std::string& name, const int n_col_x, const int n_z,
+        const int i_time, const int j_start, const int n_y,
+        const std::map<std::string, bool>& has_time, Netcdf_batch_reader& batch_nc,
+        Array<Float,2>&& storage=Array<Float,2>())
+{
+    return prefetch_slab<2>(
+            name, {n_col_x * n_y, n_z}, i_time, {0, j_start, 0}, {n_z, n_y, n_col_x}, has_time, batch_nc,
+            std::move(storage));
+}
+
 
+// Queued reads of one tile of whole rows of the domain, by variable name.
+struct Tile_reads
+{
+    int i_time;
+    int j_start;
+    int n_y;
+
+    std::map<std::string, std::future<Array<Float,2>>> fields;
+    std::map<std::string, std::future<Array<Float,1>>> surface_fields;
+};
+
+
+// Input of one tile of whole rows of the domain.
+struct Tile_input
+{
+    int i_time;
+    int j_start;
+    int n_y;
+
+    Array<Float,2> p_lay;
+    Array<Float,2> t_lay;
+    Array<Float,2> p_lev;
+    Array<Float,2> t_lev;
+    Array<Float,2> col_dry;
+
+    Gas_concs gas_concs;
+
+    Array<Float,2> lwp;
+    Array<Float,2> iwp;
+    Array<Float,2> rel;
+    Array<Float,2> rei;
+
+    Array<Float,2> rh;
+    Aerosol_concs aerosol_concs;
+
+    Array<Float,2> emis_sfc;
+    Array<Float,1> t_sfc;
+
+    Array<Float,1> mu0;
+    Array<Float,2> sfc_alb_dir;
+    Array<Float,2> sfc_alb_dif;
+    Array<Float,1> tsi_scaling;
+};
+
+
+// Output of one tile, as (variable name, values) pairs that map onto a hyperslab of the output file.
+struct Tile_output
+{
+    int i_time;
+    int j_start;
+    int n_y;
+
+    std::vector<std::pair<std::string, std::vector<Float>>> fields;
+};
+
+
+// Output variable that is written per tile, with the sizes of its dimensions in front of (y, x).
+struct Tile_variable
+{
+    Netcdf_variable<Float> nc_var;
+    std::vector<int> count_lead;
+};
+
+
+// Solve the domain as tiles of whole rows that pass through a read, solve and write pipeline.
+// The reads of tile N+1 are queued to the batch reader and the writes of tile N-1 to the
+// asynchronous writer, such that both overlap with the solving of tile N on this thread.
+// Without streaming the domain is a single tile. In time-series mode, every time step of the
+// input passes through the pipeline. The coefficients are loaded once, and the work arrays of the
+// column blocks are kept in a workspace per solver that is reused over all tiles and time steps.
+void solve_radiation_tiles(
+        const std::map<std::string, std::pair<bool, std::string>>& command_line_options)
+{
     const bool switch_shortwave         = command_line_options.at("shortwave"        ).first;
     const bool switch_longwave          = command_line_options.at("longwave"         ).first;
     const bool switch_fluxes            = command_line_options.at("fluxes"           ).first;
@@ -197,104 +337,148 @@ void solve_radiation(int argc, char** argv)
     const bool switch_output_bnd_fluxes = command_line_options.at("output-bnd-fluxes").first;
     const bool switch_delta_cloud       = command_line_options.at("delta-cloud"      ).first;
     const bool switch_delta_aerosol     = command_line_options.at("delta-aerosol"    ).first;
+    const bool switch_combine_lazily    = command_line_options.at("combine-lazily"   ).first;
+    const bool switch_lw_rescaling      = command_line_options.at("lw-rescaling"     ).first;
+    const bool switch_lw_two_stream     = command_line_options.at("lw-two-stream"    ).first;
+    const bool switch_lw_jacobians      = command_line_options.at("lw-jacobians"     ).first;
+    const bool switch_sw_direct_only    = command_line_options.at("sw-direct-only"   ).first;
+    const bool switch_heating_rates     = command_line_options.at("heating-rates"    ).first;
+    const bool switch_output_bin_fluxes = command_line_options.at("output-bin-fluxes").first;
+    const bool switch_output_compression = command_line_options.at("output-compression").first;
+    const bool switch_streaming         = command_line_options.at("streaming"        ).first;
+    const bool switch_time_series       = command_line_options.at("time-series"      ).first;
 
-    // Print the options to the screen.
-    print_command_line_options(command_line_options);
+    // Tiles consist of whole rows of the domain, such that each field is read and written as one hyperslab.
+    constexpr int n_col_tile_target = 8192;
 
 
-    ////// READ THE ATMOSPHERIC DATA //////
-    Status::print_message("Reading atmospheric input data from NetCDF.");
+    ////// OPEN THE INPUT AND INITIALIZE THE SOLVERS //////
+    auto time_start_init = std::chrono::high_resolution_clock::now();
 
     Netcdf_file input_nc("rte_rrtmgp_input.nc", Netcdf_mode::Read);
 
     const int n_col_x = input_nc.get_dimension_size("x");
     const int n_col_y = input_nc.get_dimension_size("y");
-    const int n_col = n_col_x * n_col_y;
     const int n_lay = input_nc.get_dimension_size("lay");
     const int n_lev = input_nc.get_dimension_size("lev");
 
-    // Read the atmospheric fields.
-    Array<Float,2> p_lay(input_nc.get_variable<Float>("p_lay", {n_lay, n_col_y, n_col_x}), {n_col, n_lay});
-    Array<Float,2> t_lay(input_nc.get_variable<Float>("t_lay", {n_lay, n_col_y, n_col_x}), {n_col, n_lay});
-    Array<Float,2> p_lev(input_nc.get_variable<Float>("p_lev", {n_lev, n_col_y, n_col_x}), {n_col, n_lev});
-    Array<Float,2> t_lev(input_nc.get_variable<Float>("t_lev", {n_lev, n_col_y, n_col_x}), {n_col, n_lev});
+    const int n_time = switch_time_series ? input_nc.get_dimension_size("time") : 1;
 
-    // Fetch the col_dry in case present.
-    Array<Float,2> col_dry;
-    if (input_nc.variable_exists("col_dry"))
+    const int n_y_tile = switch_streaming ? std::min(n_col_y, std::max(1, n_col_tile_target / n_col_x)) : n_col_y;
+    const int n_tiles = (n_col_y + n_y_tile - 1) / n_y_tile;
+
+    Status::print_message(
+            "Solving " + std::to_string(n_time) + " time steps of " + std::to_string(n_tiles) + " tiles of "
+            + std::to_string(n_y_tile) + " rows of " + std::to_string(n_col_x) + " columns.");
+
+    // Scalar and profile gases and aerosols are read once, the fields are read per tile.
+    Gas_concs gas_concs_fixed;
+    std::vector<std::string> gas_names_field;
+
+    for (const std::string& gas_name : input_gas_names)
     {
-        col_dry.set_dims({n_col, n_lay});
-        col_dry = std::move(input_nc.get_variable<Float>("col_dry", {n_lay, n_col_y, n_col_x}));
+        if (is_tile_field("vmr_" + gas_name, n_col_x, n_col_y, n_lay, input_nc))
+            gas_names_field.push_back(gas_name);
+        else
+            read_and_set_vmr(gas_name, n_lay, input_nc, gas_concs_fixed);
     }
 
-    // Create container for the gas concentrations and read gases.
-    Gas_concs gas_concs;
+    Aerosol_concs aerosol_concs_fixed;
+    std::vector<std::string> aerosol_names_field;
 
-    read_and_set_vmr("h2o", n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("co2", n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("o3" , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("n2o", n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("co" , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("ch4", n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("o2" , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("n2" , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-
-    read_and_set_vmr("ccl4"   , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("cfc11"  , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("cfc12"  , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("cfc22"  , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("hfc143a", n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("hfc125" , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("hfc23"  , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("hfc32"  , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("hfc134a", n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("cf4"    , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
-    read_and_set_vmr("no2"    , n_col_x, n_col_y, n_lay, input_nc, gas_concs);
+    if (switch_aerosol_optics)
+    {
+        for (const std::string& aerosol_name : input_aerosol_names)
+        {
+            if (is_tile_field(aerosol_name, n_col_x, n_col_y, n_lay, input_nc))
+                aerosol_names_field.push_back(aerosol_name);
+            else
+                read_and_set_aer(aerosol_name, n_lay, input_nc, aerosol_concs_fixed);
+        }
+    }
 
-    Array<Float,2> lwp;
-    Array<Float,2> iwp;
-    Array<Float,2> rel;
-    Array<Float,2> rei;
+    // Whether the variables that are read per tile have a time dimension, resolved once here such that
+    // the queueing of the reads does not wait for the library lock that the writes of the output hold.
+    const bool has_col_dry = input_nc.variable_exists("col_dry");
 
-    if (switch_cloud_optics)
+    std::map<std::string, bool> input_has_time;
+    for (const char* name : {
+            "p_lay", "t_lay", "p_lev", "t_lev", "col_dry", "lwp", "iwp", "rel", "rei", "rh",
+            "emis_sfc", "t_sfc", "mu0", "sfc_alb_dir", "sfc_alb_dif", "tsi", "tsi_scaling"})
+        input_has_time[name] = has_time_dimension(name, input_nc);
+
+    for (const std::string& gas_name : gas_names_field)
+        input_has_time["vmr_" + gas_name] = has_time_dimension("vmr_" + gas_name, input_nc);
+
+    for (const std::string& aerosol_name : aerosol_names_field)
+        input_has_time[aerosol_name] = has_time_dimension(aerosol_name, input_nc);
+
+    // All 3D inputs are read from a single background thread, in the order in which they are queued.
+    Netcdf_batch_reader batch_nc("rte_rrtmgp_input.nc");
+
+    // The gas optics only selects the available gases, thus the first row of the fields suffices.
+    Gas_concs gas_concs_init(gas_concs_fixed);
+    for (const std::string& gas_name : gas_names_field)
+        gas_concs_init.set_vmr(
+                gas_name, prefetch_tile_field("vmr_" + gas_name, n_col_x, n_lay, 0, 0, 1, input_has_time, batch_nc).get());
+
+    std::unique_ptr<Radiation_solver_longwave> rad_lw;
+    std::unique_ptr<Radiation_solver_shortwave> rad_sw;
+
+    if (switch_longwave)
     {
-        lwp.set_dims({n_col, n_lay});
-        lwp = std::move(input_nc.get_variable<Float>("lwp", {n_lay, n_col_y, n_col_x}));
+        Array_accounting::Tag accounting_tag("longwave");
 
-        iwp.set_dims({n_col, n_lay});
-        iwp = std::move(input_nc.get_variable<Float>("iwp", {n_lay, n_col_y, n_col_x}));
+        Status::print_message("Initializing the longwave solver.");
+        rad_lw = std::make_unique<Radiation_solver_longwave>(
+                gas_concs_init, "coefficients_lw.nc", "cloud_coefficients_lw.nc");
+    }
 
-        rel.set_dims({n_col, n_lay});
-        rel = std::move(input_nc.get_variable<Float>("rel", {n_lay, n_col_y, n_col_x}));
+    if (switch_shortwave)
+    {
+        Array_accounting::Tag accounting_tag("shortwave");
 
-        rei.set_dims({n_col, n_lay});
-        rei = std::move(input_nc.get_variable<Float>("rei", {n_lay, n_col_y, n_col_x}));
+        Status::print_message("Initializing the shortwave solver.");
+        rad_sw = std::make_unique<Radiation_solver_shortwave>(
+                gas_concs_init, switch_cloud_optics, switch_aerosol_optics,
+                "coefficients_sw.nc", "cloud_coefficients_sw.nc", "aerosol_optics.nc");
     }
 
-    Array<Float,2> rh;
-    Aerosol_concs aerosol_concs;
+    const int n_bnd_lw = switch_longwave  ? rad_lw->get_n_bnd() : 0;
+    const int n_gpt_lw = switch_longwave  ? rad_lw->get_n_gpt() : 0;
+    const int n_bnd_sw = switch_shortwave ? rad_sw->get_n_bnd() : 0;
+    const int n_gpt_sw = switch_shortwave ? rad_sw->get_n_gpt() : 0;
 
-    if (switch_aerosol_optics)
+    // Spectral bins of the output fluxes, by default UV-B (280-315 nm), UV-A (315-400 nm),
+    // PAR (400-700 nm) and the 8-12 um atmospheric window.
+    Array<Float,2> sw_bin_lims_wvn;
+    Array<Float,2> lw_bin_lims_wvn;
+
+    if (switch_output_bin_fluxes)
     {
-        rh.set_dims({n_col, n_lay});
-        rh = std::move(input_nc.get_variable<Float>("rh", {n_lay, n_col_y, n_col_x}));
-
-        read_and_set_aer("aermr01", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr02", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr03", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr04", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr05", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr06", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr07", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr08", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr09", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr10", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
-        read_and_set_aer("aermr11", n_col_x, n_col_y, n_lay, input_nc, aerosol_concs);
+        sw_bin_lims_wvn = read_bin_lims(
+                "sw_bin_lims_wvn", "bin_sw", input_nc,
+                { Float(1.e7/315.), Float(1.e7/280.),
+                  Float(1.e7/400.), Float(1.e7/315.),
+                  Float(1.e7/700.), Float(1.e7/400.) });
+
+        lw_bin_lims_wvn = read_bin_lims(
+                "lw_bin_lims_wvn", "bin_lw", input_nc,
+                { Float(1.e4/12.), Float(1.e4/8.) });
     }
 
+    const int n_bin_lw = lw_bin_lims_wvn.size() / 2;
+    const int n_bin_sw = sw_bin_lims_wvn.size() / 2;
+
+    // The solar irradiance is given per column, as a scaling per time step, as a constant scaling, or not at all.
+    const bool has_tsi = input_nc.variable_exists("tsi");
+    const bool has_tsi_scaling = input_nc.variable_exists("tsi_scaling");
+    const bool has_tsi_scaling_time = input_has_time.at("tsi_scaling");
+    const Float tsi_scaling_in = (!has_tsi && has_tsi_scaling && !has_tsi_scaling_time) ? input_nc.get_variable<Float>("tsi_scaling") : Float(1.);
+    const Float tsi_ref = switch_shortwave ? rad_sw->get_tsi() : Float(1.);
+
 
     ////// CREATE THE OUTPUT FILE //////
-    // Create the general dimensions and arrays.
     Status::print_message("Preparing NetCDF output file.");
 
     Netcdf_file output_nc("rte_rrtmgp_output.nc", Netcdf_mode::Create);
@@ -304,312 +488,852 @@ void solve_radiation(int argc, char** argv)
     output_nc.add_dimension("lev", n_lev);
     output_nc.add_dimension("pair", 2);
 
-    auto nc_lay = output_nc.add_variable<Float>("p_lay", {"lay", "y", "x"});
-    auto nc_lev = output_nc.add_variable<Float>("p_lev", {"lev", "y", "x"});
+    if (switch_time_series)
+    {
+        output_nc.add_dimension("time", n_time);
 
-    nc_lay.insert(p_lay.v(), {0, 0, 0});
-    nc_lev.insert(p_lev.v(), {0, 0, 0});
+        if (input_nc.variable_exists("time"))
+        {
+            auto nc_time = output_nc.add_variable<Float>("time", {"time"});
+            nc_time.insert(input_nc.get_variable<Float>("time", {n_time}), {0});
+        }
+    }
 
-    ////// RUN THE LONGWAVE SOLVER //////
-    if (switch_longwave)
+    std::map<std::string, Tile_variable> tile_variables;
+
+    auto add_tile_variable = [&](
+            const std::string& name,
+            const std::vector<std::string>& dims_lead,
+            const std::vector<int>& count_lead)
     {
-        // Initialize the solver.
-        Status::print_message("Initializing the longwave solver.");
-        Radiation_solver_longwave rad_lw(gas_concs, "coefficients_lw.nc", "cloud_coefficients_lw.nc");
+        std::vector<std::string> dim_names(dims_lead);
+        dim_names.insert(dim_names.end(), {"y", "x"});
+        if (switch_time_series)
+            dim_names.insert(dim_names.begin(), "time");
+
+        // Chunks match the tiles, such that each chunk is compressed once.
+        Netcdf_storage storage;
+        if (switch_output_compression)
+        {
+            storage.chunk_sizes.assign(dim_names.size()-2, 1);
+            storage.chunk_sizes.insert(storage.chunk_sizes.end(), {n_y_tile, n_col_x});
+            storage.deflate_level = 1;
+            storage.shuffle = true;
+        }
 
-        // Read the boundary conditions.
-        const int n_bnd_lw = rad_lw.get_n_bnd();
-        const int n_gpt_lw = rad_lw.get_n_gpt();
+        tile_variables.emplace(name, Tile_variable{output_nc.add_variable<Float>(name, dim_names, storage), count_lead});
+    };
 
-        Array<Float,2> emis_sfc(input_nc.get_variable<Float>("emis_sfc", {n_col_y, n_col_x, n_bnd_lw}), {n_bnd_lw, n_col});
-        Array<Float,1> t_sfc(input_nc.get_variable<Float>("t_sfc", {n_col_y, n_col_x}), {n_col});
+    add_tile_variable("p_lay", {"lay"}, {n_lay});
+    add_tile_variable("p_lev", {"lev"}, {n_lev});
 
-        // Create output arrays.
-        Array<Float,3> lw_tau;
-        Array<Float,3> lay_source;
-        Array<Float,3> lev_source_inc;
-        Array<Float,3> lev_source_dec;
-        Array<Float,2> sfc_source;
+    if (switch_longwave)
+    {
+        output_nc.add_dimension("gpt_lw", n_gpt_lw);
+        output_nc.add_dimension("band_lw", n_bnd_lw);
+
+        auto nc_lw_band_lims_wvn = output_nc.add_variable<Float>("lw_band_lims_wvn", {"band_lw", "pair"});
+        nc_lw_band_lims_wvn.insert(rad_lw->get_band_lims_wavenumber().v(), {0, 0});
 
         if (switch_output_optical)
         {
-            lw_tau        .set_dims({n_col, n_lay, n_gpt_lw});
-            lay_source    .set_dims({n_col, n_lay, n_gpt_lw});
-            lev_source_inc.set_dims({n_col, n_lay, n_gpt_lw});
-            lev_source_dec.set_dims({n_col, n_lay, n_gpt_lw});
-            sfc_source    .set_dims({n_col, n_gpt_lw});
-        }
+            auto nc_lw_band_lims_gpt = output_nc.add_variable<int>("lw_band_lims_gpt", {"band_lw", "pair"});
+            nc_lw_band_lims_gpt.insert(rad_lw->get_band_lims_gpoint().v(), {0, 0});
 
-        Array<Float,2> lw_flux_up;
-        Array<Float,2> lw_flux_dn;
-        Array<Float,2> lw_flux_net;
+            add_tile_variable("lw_tau"        , {"gpt_lw", "lay"}, {n_gpt_lw, n_lay});
+            add_tile_variable("lay_source"    , {"gpt_lw", "lay"}, {n_gpt_lw, n_lay});
+            add_tile_variable("lev_source_inc", {"gpt_lw", "lay"}, {n_gpt_lw, n_lay});
+            add_tile_variable("lev_source_dec", {"gpt_lw", "lay"}, {n_gpt_lw, n_lay});
+            add_tile_variable("sfc_source"    , {"gpt_lw"}, {n_gpt_lw});
+        }
 
         if (switch_fluxes)
         {
-            lw_flux_up .set_dims({n_col, n_lev});
-            lw_flux_dn .set_dims({n_col, n_lev});
-            lw_flux_net.set_dims({n_col, n_lev});
+            add_tile_variable("lw_flux_up" , {"lev"}, {n_lev});
+            add_tile_variable("lw_flux_dn" , {"lev"}, {n_lev});
+            add_tile_variable("lw_flux_net", {"lev"}, {n_lev});
+
+            if (switch_lw_jacobians)
+                add_tile_variable("lw_flux_up_jac", {"lev"}, {n_lev});
+
+            if (switch_output_bnd_fluxes)
+            {
+                add_tile_variable("lw_bnd_flux_up" , {"band_lw", "lev"}, {n_bnd_lw, n_lev});
+                add_tile_variable("lw_bnd_flux_dn" , {"band_lw", "lev"}, {n_bnd_lw, n_lev});
+                add_tile_variable("lw_bnd_flux_net", {"band_lw", "lev"}, {n_bnd_lw, n_lev});
+            }
+
+            if (switch_heating_rates)
+            {
+                add_tile_variable("lw_heating_rate", {"lay"}, {n_lay});
+                if (switch_output_bnd_fluxes)
+                    add_tile_variable("lw_bnd_heating_rate", {"band_lw", "lay"}, {n_bnd_lw, n_lay});
+            }
+
+            if (switch_output_bin_fluxes)
+            {
+                output_nc.add_dimension("bin_lw", n_bin_lw);
+
+                auto nc_lw_bin_lims_wvn = output_nc.add_variable<Float>("lw_bin_lims_wvn", {"bin_lw", "pair"});
+                nc_lw_bin_lims_wvn.insert(lw_bin_lims_wvn.v(), {0, 0});
+
+                add_tile_variable("lw_bin_flux_up" , {"bin_lw", "lev"}, {n_bin_lw, n_lev});
+                add_tile_variable("lw_bin_flux_dn" , {"bin_lw", "lev"}, {n_bin_lw, n_lev});
+                add_tile_variable("lw_bin_flux_net", {"bin_lw", "lev"}, {n_bin_lw, n_lev});
+            }
         }
+    }
 
-        Array<Float,3> lw_bnd_flux_up;
-        Array<Float,3> lw_bnd_flux_dn;
-        Array<Float,3> lw_bnd_flux_net;
+    if (switch_shortwave)
+    {
+        output_nc.add_dimension("gpt_sw", n_gpt_sw);
+        output_nc.add_dimension("band_sw", n_bnd_sw);
 
-        if (switch_output_bnd_fluxes)
+        auto nc_sw_band_lims_wvn = output_nc.add_variable<Float>("sw_band_lims_wvn", {"band_sw", "pair"});
+        nc_sw_band_lims_wvn.insert(rad_sw->get_band_lims_wavenumber().v(), {0, 0});
+
+        if (switch_output_optical)
         {
-            lw_bnd_flux_up .set_dims({n_col, n_lev, n_bnd_lw});
-            lw_bnd_flux_dn .set_dims({n_col, n_lev, n_bnd_lw});
-            lw_bnd_flux_net.set_dims({n_col, n_lev, n_bnd_lw});
+            auto nc_sw_band_lims_gpt = output_nc.add_variable<int>("sw_band_lims_gpt", {"band_sw", "pair"});
+            nc_sw_band_lims_gpt.insert(rad_sw->get_band_lims_gpoint().v(), {0, 0});
+
+            add_tile_variable("sw_tau"    , {"gpt_sw", "lay"}, {n_gpt_sw, n_lay});
+            add_tile_variable("ssa"       , {"gpt_sw", "lay"}, {n_gpt_sw, n_lay});
+            add_tile_variable("g"         , {"gpt_sw", "lay"}, {n_gpt_sw, n_lay});
+            add_tile_variable("toa_source", {"gpt_sw"}, {n_gpt_sw});
         }
 
+        if (switch_fluxes)
+        {
+            add_tile_variable("sw_flux_up"    , {"lev"}, {n_lev});
+            add_tile_variable("sw_flux_dn"    , {"lev"}, {n_lev});
+            add_tile_variable("sw_flux_dn_dir", {"lev"}, {n_lev});
+            add_tile_variable("sw_flux_net"   , {"lev"}, {n_lev});
 
-        // Solve the radiation.
-        Status::print_message("Solving the longwave radiation.");
+            if (switch_output_bnd_fluxes)
+            {
+                add_tile_variable("sw_bnd_flux_up"    , {"band_sw", "lev"}, {n_bnd_sw, n_lev});
+                add_tile_variable("sw_bnd_flux_dn"    , {"band_sw", "lev"}, {n_bnd_sw, n_lev});
+                add_tile_variable("sw_bnd_flux_dn_dir", {"band_sw", "lev"}, {n_bnd_sw, n_lev});
+                add_tile_variable("sw_bnd_flux_net"   , {"band_sw", "lev"}, {n_bnd_sw, n_lev});
+            }
 
-        auto time_start = std::chrono::high_resolution_clock::now();
+            if (switch_heating_rates)
+            {
+                add_tile_variable("sw_heating_rate", {"lay"}, {n_lay});
+                if (switch_output_bnd_fluxes)
+                    add_tile_variable("sw_bnd_heating_rate", {"band_sw", "lay"}, {n_bnd_sw, n_lay});
+            }
+
+            if (switch_output_bin_fluxes)
+            {
+                output_nc.add_dimension("bin_sw", n_bin_sw);
 
-        rad_lw.solve(
-                switch_fluxes,
-                switch_cloud_optics,
-                switch_output_optical,
-                switch_output_bnd_fluxes,
-                gas_concs,
-                p_lay, p_lev,
-                t_lay, t_lev,
-                col_dry,
-                t_sfc, emis_sfc,
-                lwp, iwp,
-                rel, rei,
-                lw_tau, lay_source, lev_source_inc, lev_source_dec, sfc_source,
-                lw_flux_up, lw_flux_dn, lw_flux_net,
-                lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net);
+                auto nc_sw_bin_lims_wvn = output_nc.add_variable<Float>("sw_bin_lims_wvn", {"bin_sw", "pair"});
+                nc_sw_bin_lims_wvn.insert(sw_bin_lims_wvn.v(), {0, 0});
 
-        auto time_end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration<double, std::milli>(time_end-time_start).count();
+                add_tile_variable("sw_bin_flux_up"    , {"bin_sw", "lev"}, {n_bin_sw, n_lev});
+                add_tile_variable("sw_bin_flux_dn"    , {"bin_sw", "lev"}, {n_bin_sw, n_lev});
+                add_tile_variable("sw_bin_flux_dn_dir", {"bin_sw", "lev"}, {n_bin_sw, n_lev});
+                add_tile_variable("sw_bin_flux_net"   , {"bin_sw", "lev"}, {n_bin_sw, n_lev});
+            }
+        }
+    }
 
-        Status::print_message("Duration longwave solver: " + std::to_string(duration) + " (ms)");
 
 
-        // Store the output.
-        Status::print_message("Storing the longwave output.");
+    ////// STAGES OF THE PIPELINE //////
+    // Input storage of the solved tiles by variable name, into which the reads of later tiles go.
+    std::map<std::string, Array<Float,2>> spare_fields;
+    std::map<std::string, Array<Float,1>> spare_surface_fields;
 
-        output_nc.add_dimension("gpt_lw", n_gpt_lw);
-        output_nc.add_dimension("band_lw", n_bnd_lw);
+    // Queue the reads of a tile, the fields are read in the order in which they are collected.
+    // This does not call the NetCDF library, such that it never waits for the writes of the output.
+    auto prefetch_tile = [&](const int i_time, const int j_start, const int n_y)
+    {
+        Tile_reads reads;
+        reads.i_time = i_time;
+        reads.j_start = j_start;
+        reads.n_y = n_y;
 
-        auto nc_lw_band_lims_wvn = output_nc.add_variable<Float>("lw_band_lims_wvn", {"band_lw", "pair"});
-        nc_lw_band_lims_wvn.insert(rad_lw.get_band_lims_wavenumber().v(), {0, 0});
+        const int n_col = n_col_x * n_y;
 
-        if (switch_output_optical)
+        auto prefetch_field = [&](const std::string& name, const int n_z)
         {
-            auto nc_lw_band_lims_gpt = output_nc.add_variable<int>("lw_band_lims_gpt", {"band_lw", "pair"});
-            nc_lw_band_lims_gpt.insert(rad_lw.get_band_lims_gpoint().v(), {0, 0});
+            reads.fields.emplace(name, prefetch_tile_field(
+                    name, n_col_x, n_z, i_time, j_start, n_y, input_has_time, batch_nc, std::move(spare_fields[name])));
+        };
 
-            auto nc_lw_tau = output_nc.add_variable<Float>("lw_tau", {"gpt_lw", "lay", "y", "x"});
-            nc_lw_tau.insert(lw_tau.v(), {0, 0, 0, 0});
+        // Surface fields are (y, x) or (y, x, band) variables.
+        auto prefetch_surface = [&](const std::string& name, const int n_bnd)
+        {
+            reads.fields.emplace(name, prefetch_slab<2>(
+                    name, {n_bnd, n_col}, i_time, {j_start, 0, 0}, {n_y, n_col_x, n_bnd}, input_has_time, batch_nc,
+                    std::move(spare_fields[name])));
+        };
 
-            auto nc_lay_source     = output_nc.add_variable<Float>("lay_source"    , {"gpt_lw", "lay", "y", "x"});
-            auto nc_lev_source_inc = output_nc.add_variable<Float>("lev_source_inc", {"gpt_lw", "lay", "y", "x"});
-            auto nc_lev_source_dec = output_nc.add_variable<Float>("lev_source_dec", {"gpt_lw", "lay", "y", "x"});
+        auto prefetch_surface_1d = [&](const std::string& name)
+        {
+            reads.surface_fields.emplace(name, prefetch_slab<1>(
+                    name, {n_col}, i_time, {j_start, 0}, {n_y, n_col_x}, input_has_time, batch_nc,
+                    std::move(spare_surface_fields[name])));
+        };
 
-            auto nc_sfc_source = output_nc.add_variable<Float>("sfc_source", {"gpt_lw", "y", "x"});
+        prefetch_field("p_lay", n_lay);
+        prefetch_field("t_lay", n_lay);
+        prefetch_field("p_lev", n_lev);
+        prefetch_field("t_lev", n_lev);
 
-            nc_lay_source.insert    (lay_source.v()    , {0, 0, 0, 0});
-            nc_lev_source_inc.insert(lev_source_inc.v(), {0, 0, 0, 0});
-            nc_lev_source_dec.insert(lev_source_dec.v(), {0, 0, 0, 0});
+        if (has_col_dry)
+            prefetch_field("col_dry", n_lay);
 
-            nc_sfc_source.insert(sfc_source.v(), {0, 0, 0});
-        }
+        for (const std::string& gas_name : gas_names_field)
+            prefetch_field("vmr_" + gas_name, n_lay);
 
-        if (switch_fluxes)
+        if (switch_cloud_optics)
         {
-            auto nc_lw_flux_up  = output_nc.add_variable<Float>("lw_flux_up" , {"lev", "y", "x"});
-            auto nc_lw_flux_dn  = output_nc.add_variable<Float>("lw_flux_dn" , {"lev", "y", "x"});
-            auto nc_lw_flux_net = output_nc.add_variable<Float>("lw_flux_net", {"lev", "y", "x"});
+            prefetch_field("lwp", n_lay);
+            prefetch_field("iwp", n_lay);
+            prefetch_field("rel", n_lay);
+            prefetch_field("rei", n_lay);
+        }
 
-            nc_lw_flux_up .insert(lw_flux_up .v(), {0, 0, 0});
-            nc_lw_flux_dn .insert(lw_flux_dn .v(), {0, 0, 0});
-            nc_lw_flux_net.insert(lw_flux_net.v(), {0, 0, 0});
+        if (switch_aerosol_optics)
+        {
+            prefetch_field("rh", n_lay);
+            for (const std::string& aerosol_name : aerosol_names_field)
+                prefetch_field(aerosol_name, n_lay);
+        }
 
-            if (switch_output_bnd_fluxes)
-            {
-                auto nc_lw_bnd_flux_up  = output_nc.add_variable<Float>("lw_bnd_flux_up" , {"band_lw", "lev", "y", "x"});
-                auto nc_lw_bnd_flux_dn  = output_nc.add_variable<Float>("lw_bnd_flux_dn" , {"band_lw", "lev", "y", "x"});
-                auto nc_lw_bnd_flux_net = output_nc.add_variable<Float>("lw_bnd_flux_net", {"band_lw", "lev", "y", "x"});
+        if (switch_longwave)
+        {
+            prefetch_surface("emis_sfc", n_bnd_lw);
+            prefetch_surface_1d("t_sfc");
+        }
 
-                nc_lw_bnd_flux_up .insert(lw_bnd_flux_up .v(), {0, 0, 0, 0});
-                nc_lw_bnd_flux_dn .insert(lw_bnd_flux_dn .v(), {0, 0, 0, 0});
-                nc_lw_bnd_flux_net.insert(lw_bnd_flux_net.v(), {0, 0, 0, 0});
-            }
+        if (switch_shortwave)
+        {
+            prefetch_surface_1d("mu0");
+            prefetch_surface("sfc_alb_dir", n_bnd_sw);
+            prefetch_surface("sfc_alb_dif", n_bnd_sw);
+
+            if (has_tsi)
+                prefetch_surface_1d("tsi");
+            else if (has_tsi_scaling_time)
+                reads.surface_fields.emplace("tsi_scaling", prefetch_slab<1>(
+                        "tsi_scaling", {1}, i_time, {}, {}, input_has_time, batch_nc));
         }
-    }
 
+        return reads;
+    };
 
-    ////// RUN THE SHORTWAVE SOLVER //////
-    if (switch_shortwave)
+    // Wait for the queued reads of a tile, this rethrows the first read error.
+    auto collect_tile = [&](Tile_reads& reads)
     {
-        // Initialize the solver.
-        Status::print_message("Initializing the shortwave solver.");
+        std::unique_ptr<Tile_input> tile = std::make_unique<Tile_input>();
+        tile->i_time = reads.i_time;
+        tile->j_start = reads.j_start;
+        tile->n_y = reads.n_y;
+
+        const int n_col = n_col_x * reads.n_y;
 
-        Radiation_solver_shortwave rad_sw(gas_concs, switch_cloud_optics, switch_aerosol_optics, "coefficients_sw.nc", "cloud_coefficients_sw.nc", "aerosol_optics.nc");
+        auto get = [&](const std::string& name) { return reads.fields.at(name).get(); };
+        auto get_surface = [&](const std::string& name) { return reads.surface_fields.at(name).get(); };
 
-        // Read the boundary conditions.
-        const int n_bnd_sw = rad_sw.get_n_bnd();
-        const int n_gpt_sw = rad_sw.get_n_gpt();
+        tile->p_lay = get("p_lay");
+        tile->t_lay = get("t_lay");
+        tile->p_lev = get("p_lev");
+        tile->t_lev = get("t_lev");
 
-        Array<Float,1> mu0(input_nc.get_variable<Float>("mu0", {n_col_y, n_col_x}), {n_col});
-        Array<Float,2> sfc_alb_dir(input_nc.get_variable<Float>("sfc_alb_dir", {n_col_y, n_col_x, n_bnd_sw}), {n_bnd_sw, n_col});
-        Array<Float,2> sfc_alb_dif(input_nc.get_variable<Float>("sfc_alb_dif", {n_col_y, n_col_x, n_bnd_sw}), {n_bnd_sw, n_col});
+        if (reads.fields.count("col_dry"))
+            tile->col_dry = get("col_dry");
 
-        Array<Float,1> tsi_scaling({n_col});
-        if (input_nc.variable_exists("tsi"))
+        tile->gas_concs = gas_concs_fixed;
+        for (const std::string& gas_name : gas_names_field)
+            tile->gas_concs.set_vmr(gas_name, get("vmr_" + gas_name));
+
+        if (switch_cloud_optics)
         {
-            Array<Float,1> tsi(input_nc.get_variable<Float>("tsi", {n_col_y, n_col_x}), {n_col});
-            const Float tsi_ref = rad_sw.get_tsi();
-            for (int icol=1; icol<=n_col; ++icol)
-                tsi_scaling({icol}) = tsi({icol}) / tsi_ref;
+            tile->lwp = get("lwp");
+            tile->iwp = get("iwp");
+            tile->rel = get("rel");
+            tile->rei = get("rei");
         }
-        else if (input_nc.variable_exists("tsi_scaling"))
+
+        if (switch_aerosol_optics)
         {
-            Float tsi_scaling_in = input_nc.get_variable<Float>("tsi_scaling");
-            for (int icol=1; icol<=n_col; ++icol)
-                tsi_scaling({icol}) = tsi_scaling_in;
+            tile->rh = get("rh");
+
+            tile->aerosol_concs = aerosol_concs_fixed;
+            for (const std::string& aerosol_name : aerosol_names_field)
+                tile->aerosol_concs.set_vmr(aerosol_name, get(aerosol_name));
         }
-        else
+
+        if (switch_longwave)
         {
-            for (int icol=1; icol<=n_col; ++icol)
-                tsi_scaling({icol}) = Float(1.);
+            tile->emis_sfc = get("emis_sfc");
+            tile->t_sfc = get_surface("t_sfc");
         }
 
-        // Create output arrays.
-        Array<Float,3> sw_tau;
-        Array<Float,3> ssa;
-        Array<Float,3> g;
-        Array<Float,2> toa_source;
-
-        if (switch_output_optical)
+        if (switch_shortwave)
         {
-            sw_tau    .set_dims({n_col, n_lay, n_gpt_sw});
-            ssa       .set_dims({n_col, n_lay, n_gpt_sw});
-            g         .set_dims({n_col, n_lay, n_gpt_sw});
-            toa_source.set_dims({n_col, n_gpt_sw});
+            tile->mu0 = get_surface("mu0");
+            tile->sfc_alb_dir = get("sfc_alb_dir");
+            tile->sfc_alb_dif = get("sfc_alb_dif");
+
+            tile->tsi_scaling.set_dims({n_col});
+            if (has_tsi)
+            {
+                Array<Float,1> tsi = get_surface("tsi");
+                for (int icol=1; icol<=n_col; ++icol)
+                    tile->tsi_scaling({icol}) = tsi({icol}) / tsi_ref;
+                spare_surface_fields["tsi"] = std::move(tsi);
+            }
+            else if (has_tsi_scaling_time)
+                tile->tsi_scaling.fill(get_surface("tsi_scaling")({1}));
+            else
+                tile->tsi_scaling.fill(tsi_scaling_in);
         }
 
-        Array<Float,2> sw_flux_up;
-        Array<Float,2> sw_flux_dn;
-        Array<Float,2> sw_flux_dn_dir;
-        Array<Float,2> sw_flux_net;
+        return tile;
+    };
 
-        if (switch_fluxes)
-        {
-            sw_flux_up    .set_dims({n_col, n_lev});
-            sw_flux_dn    .set_dims({n_col, n_lev});
-            sw_flux_dn_dir.set_dims({n_col, n_lev});
-            sw_flux_net   .set_dims({n_col, n_lev});
-        }
+    // Hand the input storage of a solved tile to the reads of a later tile.
+    auto recycle_tile = [&](Tile_input& tile)
+    {
+        for (auto& field : std::map<std::string, Array<Float,2>*>{
+                {"p_lay", &tile.p_lay}, {"t_lay", &tile.t_lay}, {"p_lev", &tile.p_lev}, {"t_lev", &tile.t_lev},
+                {"col_dry", &tile.col_dry}, {"lwp", &tile.lwp}, {"iwp", &tile.iwp}, {"rel", &tile.rel},
+                {"rei", &tile.rei}, {"rh", &tile.rh}, {"emis_sfc", &tile.emis_sfc},
+                {"sfc_alb_dir", &tile.sfc_alb_dir}, {"sfc_alb_dif", &tile.sfc_alb_dif}})
+            spare_fields[field.first] = std::move(*field.second);
 
-        Array<Float,3> sw_bnd_flux_up;
-        Array<Float,3> sw_bnd_flux_dn;
-        Array<Float,3> sw_bnd_flux_dn_dir;
-        Array<Float,3> sw_bnd_flux_net;
+        spare_surface_fields["t_sfc"] = std::move(tile.t_sfc);
+        spare_surface_fields["mu0"] = std::move(tile.mu0);
 
-        if (switch_output_bnd_fluxes)
-        {
-            sw_bnd_flux_up    .set_dims({n_col, n_lev, n_bnd_sw});
-            sw_bnd_flux_dn    .set_dims({n_col, n_lev, n_bnd_sw});
-            sw_bnd_flux_dn_dir.set_dims({n_col, n_lev, n_bnd_sw});
-            sw_bnd_flux_net   .set_dims({n_col, n_lev, n_bnd_sw});
-        }
+        for (const std::string& gas_name : gas_names_field)
+            spare_fields["vmr_" + gas_name] = tile.gas_concs.take_vmr(gas_name);
 
+        if (switch_aerosol_optics)
+            for (const std::string& aerosol_name : aerosol_names_field)
+                spare_fields[aerosol_name] = tile.aerosol_concs.take_vmr(aerosol_name);
+    };
 
-        // Solve the radiation.
-        Status::print_message("Solving the shortwave radiation.");
-
-        auto time_start = std::chrono::high_resolution_clock::now();
-
-        rad_sw.solve(
-                switch_fluxes,
-                switch_cloud_optics,
-                switch_aerosol_optics,
-                switch_output_optical,
-                switch_output_bnd_fluxes,
-                switch_delta_cloud,
-                switch_delta_aerosol,
-                gas_concs,
-                p_lay, p_lev,
-                t_lay, t_lev,
-                col_dry,
-                sfc_alb_dir, sfc_alb_dif,
-                tsi_scaling, mu0,
-                lwp, iwp,
-                rel, rei,
-                rh,
-                aerosol_concs,
-                sw_tau, ssa, g,
-                toa_source,
-                sw_flux_up, sw_flux_dn,
-                sw_flux_dn_dir, sw_flux_net,
-                sw_bnd_flux_up, sw_bnd_flux_dn,
-                sw_bnd_flux_dn_dir, sw_bnd_flux_net);
-
-        auto time_end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration<double, std::milli>(time_end-time_start).count();
-
-        Status::print_message("Duration shortwave solver: " + std::to_string(duration) + " (ms)");
-
-
-        // Store the output.
-        Status::print_message("Storing the shortwave output.");
+    double duration_lw = 0.;
+    double duration_sw = 0.;
 
-        output_nc.add_dimension("gpt_sw", n_gpt_sw);
-        output_nc.add_dimension("band_sw", n_bnd_sw);
+    // The tiles are solved one at a time on this thread, thus they can share the workspaces.
+    Radiation_solver_longwave::Workspace lw_workspace;
+    Radiation_solver_shortwave::Workspace sw_workspace;
 
-        auto nc_sw_band_lims_wvn = output_nc.add_variable<Float>("sw_band_lims_wvn", {"band_sw", "pair"});
-        nc_sw_band_lims_wvn.insert(rad_sw.get_band_lims_wavenumber().v(), {0, 0});
+    auto solve_tile = [&](Tile_input& tile)
+    {
+        std::unique_ptr<Tile_output> out = std::make_unique<Tile_output>();
+        out->i_time = tile.i_time;
+        out->j_start = tile.j_start;
+        out->n_y = tile.n_y;
 
-        if (switch_output_optical)
+        const int n_col = n_col_x * tile.n_y;
+
+        auto add_field = [&](const std::string& name, auto& array)
         {
-            auto nc_sw_band_lims_gpt = output_nc.add_variable<int>("sw_band_lims_gpt", {"band_sw", "pair"});
-            nc_sw_band_lims_gpt.insert(rad_sw.get_band_lims_gpoint().v(), {0, 0});
+            out->fields.emplace_back(name, array.take_v());
+        };
 
-            auto nc_sw_tau = output_nc.add_variable<Float>("sw_tau", {"gpt_sw", "lay", "y", "x"});
-            auto nc_ssa    = output_nc.add_variable<Float>("ssa"   , {"gpt_sw", "lay", "y", "x"});
-            auto nc_g      = output_nc.add_variable<Float>("g"     , {"gpt_sw", "lay", "y", "x"});
+        if (switch_longwave)
+        {
+            Array_accounting::Tag accounting_tag("longwave");
 
-            nc_sw_tau.insert(sw_tau.v(), {0, 0, 0, 0});
-            nc_ssa   .insert(ssa   .v(), {0, 0, 0, 0});
-            nc_g     .insert(g     .v(), {0, 0, 0, 0});
+            Array<Float,3> lw_tau;
+            Array<Float,3> lay_source;
+            Array<Float,3> lev_source_inc;
+            Array<Float,3> lev_source_dec;
+            Array<Float,2> sfc_source;
 
-            auto nc_toa_source = output_nc.add_variable<Float>("toa_source", {"gpt_sw", "y", "x"});
-            nc_toa_source.insert(toa_source.v(), {0, 0, 0});
+            if (switch_output_optical)
+            {
+                lw_tau        .set_dims({n_col, n_lay, n_gpt_lw});
+                lay_source    .set_dims({n_col, n_lay, n_gpt_lw});
+                lev_source_inc.set_dims({n_col, n_lay, n_gpt_lw});
+                lev_source_dec.set_dims({n_col, n_lay, n_gpt_lw});
+                sfc_source    .set_dims({n_col, n_gpt_lw});
+            }
+
+            Array<Float,2> lw_flux_up;
+            Array<Float,2> lw_flux_dn;
+            Array<Float,2> lw_flux_net;
+
+            if (switch_fluxes)
+            {
+                lw_flux_up .set_dims({n_col, n_lev});
+                lw_flux_dn .set_dims({n_col, n_lev});
+                lw_flux_net.set_dims({n_col, n_lev});
+            }
+
+            Array<Float,3> lw_bnd_flux_up;
+            Array<Float,3> lw_bnd_flux_dn;
+            Array<Float,3> lw_bnd_flux_net;
+
+            if (switch_output_bnd_fluxes)
+            {
+                lw_bnd_flux_up .set_dims({n_col, n_lev, n_bnd_lw});
+                lw_bnd_flux_dn .set_dims({n_col, n_lev, n_bnd_lw});
+                lw_bnd_flux_net.set_dims({n_col, n_lev, n_bnd_lw});
+            }
+
+            Array<Float,2> lw_flux_up_jac;
+
+            if (switch_fluxes && switch_lw_jacobians)
+                lw_flux_up_jac.set_dims({n_col, n_lev});
+
+            Array<Float,3> lw_bin_flux_up;
+            Array<Float,3> lw_bin_flux_dn;
+            Array<Float,3> lw_bin_flux_net;
+
+            if (switch_fluxes && switch_output_bin_fluxes)
+            {
+                lw_bin_flux_up .set_dims({n_col, n_lev, n_bin_lw});
+                lw_bin_flux_dn .set_dims({n_col, n_lev, n_bin_lw});
+                lw_bin_flux_net.set_dims({n_col, n_lev, n_bin_lw});
+            }
+
+            Array<Float,2> lw_heating_rate;
+            Array<Float,3> lw_bnd_heating_rate;
+
+            if (switch_fluxes && switch_heating_rates)
+            {
+                lw_heating_rate.set_dims({n_col, n_lay});
+                if (switch_output_bnd_fluxes)
+                    lw_bnd_heating_rate.set_dims({n_col, n_lay, n_bnd_lw});
+            }
+
+            auto time_start = std::chrono::high_resolution_clock::now();
+
+            Timer::Region region("longwave");
+            rad_lw->solve(
+                    switch_fluxes,
+                    switch_cloud_optics,
+                    switch_output_optical,
+                    switch_output_bnd_fluxes,
+                    switch_lw_rescaling,
+                    switch_lw_two_stream,
+                    switch_fluxes && switch_lw_jacobians,
+                    switch_fluxes && switch_heating_rates,
+                    switch_fluxes && switch_output_bin_fluxes,
+                    tile.gas_concs,
+                    tile.p_lay, tile.p_lev,
+                    tile.t_lay, tile.t_lev,
+                    tile.col_dry,
+                    tile.t_sfc, tile.emis_sfc,
+                    tile.lwp, tile.iwp,
+                    tile.rel, tile.rei,
+                    lw_bin_lims_wvn,
+                    lw_tau, lay_source, lev_source_inc, lev_source_dec, sfc_source,
+                    lw_flux_up, lw_flux_dn, lw_flux_net,
+                    lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net,
+                    lw_flux_up_jac,
+                    lw_heating_rate, lw_bnd_heating_rate,
+                    lw_bin_flux_up, lw_bin_flux_dn, lw_bin_flux_net,
+                    &lw_workspace);
+            region.stop();
+
+            auto time_end = std::chrono::high_resolution_clock::now();
+            duration_lw += std::chrono::duration<double, std::milli>(time_end-time_start).count();
+
+            if (switch_output_optical)
+            {
+                add_field("lw_tau"        , lw_tau);
+                add_field("lay_source"    , lay_source);
+                add_field("lev_source_inc", lev_source_inc);
+                add_field("lev_source_dec", lev_source_dec);
+                add_field("sfc_source"    , sfc_source);
+            }
+
+            if (switch_fluxes)
+            {
+                add_field("lw_flux_up" , lw_flux_up);
+                add_field("lw_flux_dn" , lw_flux_dn);
+                add_field("lw_flux_net", lw_flux_net);
+
+                if (switch_lw_jacobians)
+                    add_field("lw_flux_up_jac", lw_flux_up_jac);
+
+                if (switch_output_bnd_fluxes)
+                {
+                    add_field("lw_bnd_flux_up" , lw_bnd_flux_up);
+                    add_field("lw_bnd_flux_dn" , lw_bnd_flux_dn);
+                    add_field("lw_bnd_flux_net", lw_bnd_flux_net);
+                }
+
+                if (switch_heating_rates)
+                {
+                    add_field("lw_heating_rate", lw_heating_rate);
+                    if (switch_output_bnd_fluxes)
+                        add_field("lw_bnd_heating_rate", lw_bnd_heating_rate);
+                }
+
+                if (switch_output_bin_fluxes)
+                {
+                    add_field("lw_bin_flux_up" , lw_bin_flux_up);
+                    add_field("lw_bin_flux_dn" , lw_bin_flux_dn);
+                    add_field("lw_bin_flux_net", lw_bin_flux_net);
+                }
+            }
         }
 
-        if (switch_fluxes)
+        if (switch_shortwave)
         {
-            auto nc_sw_flux_up     = output_nc.add_variable<Float>("sw_flux_up"    , {"lev", "y", "x"});
-            auto nc_sw_flux_dn     = output_nc.add_variable<Float>("sw_flux_dn"    , {"lev", "y", "x"});
-            auto nc_sw_flux_dn_dir = output_nc.add_variable<Float>("sw_flux_dn_dir", {"lev", "y", "x"});
-            auto nc_sw_flux_net    = output_nc.add_variable<Float>("sw_flux_net"   , {"lev", "y", "x"});
+            Array_accounting::Tag accounting_tag("shortwave");
 
-            nc_sw_flux_up    .insert(sw_flux_up    .v(), {0, 0, 0});
-            nc_sw_flux_dn    .insert(sw_flux_dn    .v(), {0, 0, 0});
-            nc_sw_flux_dn_dir.insert(sw_flux_dn_dir.v(), {0, 0, 0});
-            nc_sw_flux_net   .insert(sw_flux_net   .v(), {0, 0, 0});
+            Array<Float,3> sw_tau;
+            Array<Float,3> ssa;
+            Array<Float,3> g;
+            Array<Float,2> toa_source;
+
+            if (switch_output_optical)
+            {
+                sw_tau    .set_dims({n_col, n_lay, n_gpt_sw});
+                ssa       .set_dims({n_col, n_lay, n_gpt_sw});
+                g         .set_dims({n_col, n_lay, n_gpt_sw});
+                toa_source.set_dims({n_col, n_gpt_sw});
+            }
+
+            Array<Float,2> sw_flux_up;
+            Array<Float,2> sw_flux_dn;
+            Array<Float,2> sw_flux_dn_dir;
+            Array<Float,2> sw_flux_net;
+
+            if (switch_fluxes)
+            {
+                sw_flux_up    .set_dims({n_col, n_lev});
+                sw_flux_dn    .set_dims({n_col, n_lev});
+                sw_flux_dn_dir.set_dims({n_col, n_lev});
+                sw_flux_net   .set_dims({n_col, n_lev});
+            }
+
+            Array<Float,3> sw_bnd_flux_up;
+            Array<Float,3> sw_bnd_flux_dn;
+            Array<Float,3> sw_bnd_flux_dn_dir;
+            Array<Float,3> sw_bnd_flux_net;
 
             if (switch_output_bnd_fluxes)
             {
-                auto nc_sw_bnd_flux_up     = output_nc.add_variable<Float>("sw_bnd_flux_up"    , {"band_sw", "lev", "y", "x"});
-                auto nc_sw_bnd_flux_dn     = output_nc.add_variable<Float>("sw_bnd_flux_dn"    , {"band_sw", "lev", "y", "x"});
-                auto nc_sw_bnd_flux_dn_dir = output_nc.add_variable<Float>("sw_bnd_flux_dn_dir", {"band_sw", "lev", "y", "x"});
-                auto nc_sw_bnd_flux_net    = output_nc.add_variable<Float>("sw_bnd_flux_net"   , {"band_sw", "lev", "y", "x"});
-
-                nc_sw_bnd_flux_up    .insert(sw_bnd_flux_up    .v(), {0, 0, 0, 0});
-                nc_sw_bnd_flux_dn    .insert(sw_bnd_flux_dn    .v(), {0, 0, 0, 0});
-                nc_sw_bnd_flux_dn_dir.insert(sw_bnd_flux_dn_dir.v(), {0, 0, 0, 0});
-                nc_sw_bnd_flux_net   .insert(sw_bnd_flux_net   .v(), {0, 0, 0, 0});
+                sw_bnd_flux_up    .set_dims({n_col, n_lev, n_bnd_sw});
+                sw_bnd_flux_dn    .set_dims({n_col, n_lev, n_bnd_sw});
+                sw_bnd_flux_dn_dir.set_dims({n_col, n_lev, n_bnd_sw});
+                sw_bnd_flux_net   .set_dims({n_col, n_lev, n_bnd_sw});
+            }
+
+            Array<Float,3> sw_bin_flux_up;
+            Array<Float,3> sw_bin_flux_dn;
+            Array<Float,3> sw_bin_flux_dn_dir;
+            Array<Float,3> sw_bin_flux_net;
+
+            if (switch_fluxes && switch_output_bin_fluxes)
+            {
+                sw_bin_flux_up    .set_dims({n_col, n_lev, n_bin_sw});
+                sw_bin_flux_dn    .set_dims({n_col, n_lev, n_bin_sw});
+                sw_bin_flux_dn_dir.set_dims({n_col, n_lev, n_bin_sw});
+                sw_bin_flux_net   .set_dims({n_col, n_lev, n_bin_sw});
+            }
+
+            Array<Float,2> sw_heating_rate;
+            Array<Float,3> sw_bnd_heating_rate;
+
+            if (switch_fluxes && switch_heating_rates)
+            {
+                sw_heating_rate.set_dims({n_col, n_lay});
+                if (switch_output_bnd_fluxes)
+                    sw_bnd_heating_rate.set_dims({n_col, n_lay, n_bnd_sw});
+            }
+
+            auto time_start = std::chrono::high_resolution_clock::now();
+
+            Timer::Region region("shortwave");
+            rad_sw->solve(
+                    switch_fluxes,
+                    switch_cloud_optics,
+                    switch_aerosol_optics,
+                    switch_output_optical,
+                    switch_output_bnd_fluxes,
+                    switch_delta_cloud,
+                    switch_delta_aerosol,
+                    switch_combine_lazily,
+                    switch_sw_direct_only,
+                    switch_fluxes && switch_heating_rates,
+                    switch_fluxes && switch_output_bin_fluxes,
+                    tile.gas_concs,
+                    tile.p_lay, tile.p_lev,
+                    tile.t_lay, tile.t_lev,
+                    tile.col_dry,
+                    tile.sfc_alb_dir, tile.sfc_alb_dif,
+                    tile.tsi_scaling, tile.mu0,
+                    tile.lwp, tile.iwp,
+                    tile.rel, tile.rei,
+                    tile.rh,
+                    tile.aerosol_concs,
+                    sw_bin_lims_wvn,
+                    sw_tau, ssa, g,
+                    toa_source,
+                    sw_flux_up, sw_flux_dn,
+                    sw_flux_dn_dir, sw_flux_net,
+                    sw_bnd_flux_up, sw_bnd_flux_dn,
+                    sw_bnd_flux_dn_dir, sw_bnd_flux_net,
+                    sw_heating_rate, sw_bnd_heating_rate,
+                    sw_bin_flux_up, sw_bin_flux_dn,
+                    sw_bin_flux_dn_dir, sw_bin_flux_net,
+                    &sw_workspace);
+            region.stop();
+
+            auto time_end = std::chrono::high_resolution_clock::now();
+            duration_sw += std::chrono::duration<double, std::milli>(time_end-time_start).count();
+
+            if (switch_output_optical)
+            {
+                add_field("sw_tau"    , sw_tau);
+                add_field("ssa"       , ssa);
+                add_field("g"         , g);
+                add_field("toa_source", toa_source);
+            }
+
+            if (switch_fluxes)
+            {
+                add_field("sw_flux_up"    , sw_flux_up);
+                add_field("sw_flux_dn"    , sw_flux_dn);
+                add_field("sw_flux_dn_dir", sw_flux_dn_dir);
+                add_field("sw_flux_net"   , sw_flux_net);
+
+                if (switch_output_bnd_fluxes)
+                {
+                    add_field("sw_bnd_flux_up"    , sw_bnd_flux_up);
+                    add_field("sw_bnd_flux_dn"    , sw_bnd_flux_dn);
+                    add_field("sw_bnd_flux_dn_dir", sw_bnd_flux_dn_dir);
+                    add_field("sw_bnd_flux_net"   , sw_bnd_flux_net);
+                }
+
+                if (switch_heating_rates)
+                {
+                    add_field("sw_heating_rate", sw_heating_rate);
+                    if (switch_output_bnd_fluxes)
+                        add_field("sw_bnd_heating_rate", sw_bnd_heating_rate);
+                }
+
+                if (switch_output_bin_fluxes)
+                {
+                    add_field("sw_bin_flux_up"    , sw_bin_flux_up);
+                    add_field("sw_bin_flux_dn"    , sw_bin_flux_dn);
+                    add_field("sw_bin_flux_dn_dir", sw_bin_flux_dn_dir);
+                    add_field("sw_bin_flux_net"   , sw_bin_flux_net);
+                }
             }
         }
+
+        // The input pressures are written along with the output, as a copy such that their storage is recycled.
+        out->fields.emplace_back("p_lay", tile.p_lay.v());
+        out->fields.emplace_back("p_lev", tile.p_lev.v());
+
+        return out;
+    };
+
+    // The output is queued to a background thread, that writes while the next tile is solved.
+    // The variables, and thus the output file, outlive the writer.
+    Netcdf_async_writer output_writer;
+
+    auto write_tile = [&](Tile_output& out)
+    {
+        for (auto& field : out.fields)
+        {
+            const Tile_variable& var = tile_variables.at(field.first);
+
+            std::vector<int> i_start(var.count_lead.size(), 0);
+            std::vector<int> i_count(var.count_lead);
+
+            i_start.insert(i_start.end(), {out.j_start, 0});
+            i_count.insert(i_count.end(), {out.n_y, n_col_x});
+
+            if (switch_time_series)
+            {
+                i_start.insert(i_start.begin(), out.i_time);
+                i_count.insert(i_count.begin(), 1);
+            }
+
+            output_writer.insert(var.nc_var, std::move(field.second), i_start, i_count);
+        }
+    };
+
+
+    auto time_end_init = std::chrono::high_resolution_clock::now();
+    auto duration_init = std::chrono::duration<double, std::milli>(time_end_init-time_start_init).count();
+
+    Status::print_message("Duration initialization: " + std::to_string(duration_init) + " (ms)");
+
+
+    ////// RUN THE PIPELINE //////
+    Status::print_message("Solving the radiation through the read, solve and write pipeline.");
+
+    // Tiles are ordered by time step, and within a time step by row.
+    const int n_tiles_total = n_time * n_tiles;
+
+    auto prefetch_tile_index = [&](const int itile_total)
+    {
+        const int itime = itile_total / n_tiles;
+        const int j_start = (itile_total % n_tiles) * n_y_tile;
+        const int n_y = std::min(n_y_tile, n_col_y - j_start);
+
+        return prefetch_tile(itime, j_start, n_y);
+    };
+
+    double duration_read = 0.;
+    double duration_solve = 0.;
+    double duration_write = 0.;
+
+    std::vector<double> duration_solve_step(n_time, 0.);
+
+    auto time_start = std::chrono::high_resolution_clock::now();
+
+    Tile_reads reads = prefetch_tile_index(0);
+
+    for (int itile_total=0; itile_total<n_tiles_total; ++itile_total)
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<Tile_input> tile = collect_tile(reads);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        duration_read += std::chrono::duration<double, std::milli>(t1-t0).count();
+
+        // The next tile is read while this one is solved.
+        if (itile_total+1 < n_tiles_total)
+            reads = prefetch_tile_index(itile_total+1);
+
+        std::unique_ptr<Tile_output> out = solve_tile(*tile);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        duration_solve += std::chrono::duration<double, std::milli>(t2-t1).count();
+        duration_solve_step[tile->i_time] += std::chrono::duration<double, std::milli>(t2-t1).count();
+
+        recycle_tile(*tile);
+        tile.reset();
+
+        // Wait for the writes of the previous tile, such that at most one tile of output is queued.
+        output_writer.finish();
+        auto t3 = std::chrono::high_resolution_clock::now();
+        duration_write += std::chrono::duration<double, std::milli>(t3-t2).count();
+
+        write_tile(*out);
+    }
+
+    Status::print_message("Waiting for the output to be written.");
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    output_writer.finish();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    duration_write += std::chrono::duration<double, std::milli>(t1-t0).count();
+
+    auto time_end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration<double, std::milli>(time_end-time_start).count();
+
+    // Per-step timings exclude the initialization; the first step shows any warm-up effects.
+    if (switch_time_series)
+    {
+        for (int itime=0; itime<n_time; ++itime)
+            Status::print_message(
+                    "Duration solving step " + std::to_string(itime) + ": "
+                    + std::to_string(duration_solve_step[itime]) + " (ms)");
+
+        if (n_time > 1)
+        {
+            const double duration_steady = std::accumulate(duration_solve_step.begin()+1, duration_solve_step.end(), 0.) / (n_time-1);
+            Status::print_message("Duration solving per step after the first: " + std::to_string(duration_steady) + " (ms)");
+        }
+    }
+
+    if (switch_longwave)
+        Status::print_message("Duration longwave solver: " + std::to_string(duration_lw) + " (ms)");
+    if (switch_shortwave)
+        Status::print_message("Duration shortwave solver: " + std::to_string(duration_sw) + " (ms)");
+
+    // The read and write durations are the time that the solver waited for them.
+    Status::print_message("Duration waiting for input: " + std::to_string(duration_read) + " (ms)");
+    Status::print_message("Duration solving: " + std::to_string(duration_solve) + " (ms)");
+    Status::print_message("Duration waiting for output: " + std::to_string(duration_write) + " (ms)");
+    Status::print_message("Duration pipeline: " + std::to_string(duration) + " (ms)");
+}
+
+
+// Write the report of the region timers, if these are enabled.
+void write_timings()
+{
+    if (!Timer::is_enabled())
+        return;
+
+    Timer::write_json("rte_rrtmgp_timings.json");
+    Timer::write_csv("rte_rrtmgp_timings.csv");
+
+    Status::print_message("Timings written to rte_rrtmgp_timings.json and rte_rrtmgp_timings.csv.");
+}
+
+
+// Write the report of the array storage, if the accounting is compiled in.
+void write_memory_report()
+{
+    if (!Array_accounting::is_compiled())
+        return;
+
+    std::ostringstream report;
+    Array_accounting::write_report(report);
+    Status::print_message(report);
+
+    Array_accounting::write_csv("rte_rrtmgp_memory.csv");
+    Status::print_message("Array storage written to rte_rrtmgp_memory.csv.");
+}
+
+
+void solve_radiation(int argc, char** argv)
+{
+    Status::print_message("###### Starting RTE+RRTMGP solver ######");
+
+    ////// FLOW CONTROL SWITCHES //////
+    // Parse the command line options.
+    std::map<std::string, std::pair<bool, std::string>> command_line_options {
+        {"shortwave"        , { true,  "Enable computation of shortwave radiation."}},
+        {"longwave"         , { true,  "Enable computation of longwave radiation." }},
+        {"fluxes"           , { true,  "Enable computation of fluxes."             }},
+        {"cloud-optics"     , { false, "Enable cloud optics."                      }},
+        {"aerosol-optics"   , { false, "Enable aerosol optics."                    }},
+        {"output-optical"   , { false, "Enable output of optical properties."      }},
+        {"output-bnd-fluxes", { false, "Enable output of band fluxes."             }},
+        {"delta-cloud"      , { true,  "delta-scaling of cloud optical properties"   }},
+        {"delta-aerosol"    , { false, "delta-scaling of aerosol optical properties" }},
+        {"combine-lazily"   , { false, "Combine gas and particle optical properties per g-point in the solver." }},
+        {"lw-rescaling"     , { false, "Longwave scattering with the rescaling approximation." }},
+        {"lw-two-stream"    , { false, "Longwave scattering with the two-stream solver."        }},
+        {"lw-jacobians"     , { false, "Longwave surface temperature Jacobian of the upward flux." }},
+        {"sw-direct-only"   , { false, "Only compute the direct-beam shortwave flux, without scattering." }},
+        {"heating-rates"    , { false, "Enable output of heating rates, per band if band fluxes are enabled." }},
+        {"output-bin-fluxes", { false, "Enable output of fluxes in spectral bins (default: UV-B, UV-A, PAR and 8-12 um window)." }},
+        {"output-compression", { false, "Chunk the output per tile and horizontal slice and deflate it (NetCDF-4)." }},
+        {"time-series"      , { false, "Solve every step of the time dimension of the input through the tile pipeline, loading the coefficients once." }},
+        {"streaming"        , { false, "Stream tiles of rows through a pipelined read, solve and write, for domains larger than memory." }},
+        {"timings"          , { false, "Time the stages of the solvers and write them to rte_rrtmgp_timings.json and .csv." }},
+        {"hw-counters"      , { false, "Add hardware counters to the timings (Linux perf_event_open), raw FP event in RTE_RRTMGP_PERF_FP_EVENT." }}};
+
+    if (parse_command_line_options(command_line_options, argc, argv))
+        return;
+
+    // Print the options to the screen.
+    print_command_line_options(command_line_options);
+
+    Timer::set_enabled(command_line_options.at("timings").first || command_line_options.at("hw-counters").first);
+
+    // The floating point events are model specific, e.g. 0x10c7 for the packed double AVX2 operations on Intel.
+    if (command_line_options.at("hw-counters").first)
+    {
+        const char* fp_event = std::getenv("RTE_RRTMGP_PERF_FP_EVENT");
+        Timer::set_hardware_counters(true, fp_event ? std::stoull(fp_event, nullptr, 0) : 0);
     }
 
+    solve_radiation_tiles(command_line_options);
+
+    write_timings();
+
     Status::print_message("###### Finished RTE+RRTMGP solver ######");
 }
 
@@ -619,6 +1343,9 @@ int main(int argc, char** argv)
     try
     {
         solve_radiation(argc, argv);
+
+        // All arrays are released here, what is still live has leaked.
+        write_memory_report();
     }
 
     // Catch any exceptions and return 1.
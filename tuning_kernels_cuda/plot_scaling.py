@@ -0,0 +1,83 @@
+import matplotlib.pyplot as pl
+import numpy as np
+
+def read_scaling(csv_file):
+
+    return np.genfromtxt(csv_file, delimiter=',', names=True, dtype=None, encoding='utf-8')
+
+
+def plot_scaling(csv_file, n_lay=None):
+
+    cf = read_scaling(csv_file)
+
+    if n_lay is None:
+        n_lay = cf['n_lay'].max()
+    cf = cf[cf['n_lay'] == n_lay]
+
+    # Efficiency against the number of threads, a line per block size and case.
+    pl.figure(figsize=(10,7))
+
+    for i, band in enumerate(['lw', 'sw']):
+        for j, scaling in enumerate(['strong', 'weak']):
+            ax = pl.subplot(2, 2, 2*i+j+1)
+            pl.title('{}, {} scaling, n_lay = {}'.format(band, scaling, n_lay), loc='left')
+
+            sel = cf[(cf['band'] == band) & (cf['scaling'] == scaling)]
+            cases = sorted(set(zip(sel['n_col_block'], sel['clouds'], sel['aerosols'])))
+
+            for n_col_block, clouds, aerosols in cases:
+                c = sel[(sel['n_col_block'] == n_col_block) & (sel['clouds'] == clouds) & (sel['aerosols'] == aerosols)]
+                label = 'block = {}{}{}'.format(
+                        n_col_block, ', clouds' if clouds else '', ', aerosols' if aerosols else '')
+                pl.plot(c['n_thread'], c['efficiency'], 'o-', label=label)
+
+            pl.axhline(1., color='k', linestyle=':')
+            ax.set_xscale('log', base=2)
+            pl.ylim(0, 1.1)
+            pl.xlabel('Number of threads')
+            pl.ylabel('Efficiency')
+            pl.legend(fontsize=7)
+
+    pl.tight_layout()
+    pl.savefig(csv_file[:-4] + "_efficiency.png", dpi=150, format="png")
+
+    # Throughput per core and memory against the block size, for a single thread.
+    pl.figure(figsize=(10,4))
+
+    sel = cf[(cf['scaling'] == 'strong') & (cf['n_thread'] == cf['n_thread'].min())]
+
+    for band in ['lw', 'sw']:
+        b = sel[sel['band'] == band]
+        cases = sorted(set(zip(b['clouds'], b['aerosols'])))
+
+        for clouds, aerosols in cases:
+            c = b[(b['clouds'] == clouds) & (b['aerosols'] == aerosols)]
+            label = '{}{}{}'.format(band, ', clouds' if clouds else '', ', aerosols' if aerosols else '')
+
+            ax = pl.subplot(121)
+            pl.plot(c['n_col_block'], c['columns_per_s_per_core'], 'o-', label=label)
+
+            pl.subplot(122)
+            pl.plot(c['n_col_block'], c['memory_solve_mb'], 'o-', label=label)
+
+    ax = pl.subplot(121)
+    pl.title('n_lay = {}'.format(n_lay), loc='left')
+    ax.set_xscale('log')
+    pl.xlabel('n_col_block')
+    pl.ylabel('Columns / s / core')
+    pl.legend(fontsize=7)
+
+    ax = pl.subplot(122)
+    ax.set_xscale('log')
+    pl.xlabel('n_col_block')
+    pl.ylabel('Memory of the solve (MB)')
+    pl.legend(fontsize=7)
+
+    pl.tight_layout()
+    pl.savefig(csv_file[:-4] + "_blocks.png", dpi=150, format="png")
+
+    pl.show()
+
+
+if __name__ == '__main__':
+    plot_scaling('rte_rrtmgp_scaling.csv')